@@ -49,6 +49,88 @@ static bool clear_folder(const char* parent, Nob_File_Paths* file_paths)
     return true;
 }
 
+// The tools only need the emulator core, they don't link SDL or cimgui and are always optimized
+static bool build_core_tool(Nob_Cmd* cmd, int build_msvc, int build_profile, const char* source, const char* output)
+{
+    nob_log(NOB_INFO, "Compiling %s...", output);
+
+    if (build_msvc) {
+        nob_cmd_append(cmd, "cl.exe", "/O2", "/W3");
+        if (build_profile) {
+            nob_cmd_append(cmd, "/DNES_PROFILE");
+        }
+        nob_cmd_append(cmd, source);
+        nob_cmd_append(cmd, "/link");
+        nob_cmd_append(cmd, nob_temp_sprintf("/OUT:%s", output), "/SUBSYSTEM:CONSOLE");
+    } else {
+        nob_cmd_append(cmd, "gcc", "-O2");
+        nob_cmd_append(cmd, "-Wall", "-Wno-narrowing", "-Wno-missing-braces", "--pedantic");
+        if (build_profile) {
+            nob_cmd_append(cmd, "-DNES_PROFILE");
+        }
+        nob_cmd_append(cmd, source);
+        nob_cmd_append(cmd, "-o", output);
+    }
+
+    if (!nob_cmd_run_sync(*cmd)) {
+        return false;
+    }
+
+    nob_log(NOB_INFO, "Built %s", output);
+    return true;
+}
+
+// libnes as a static library (build/libnes.a or .lib) and as a DLL exporting the libnes.h API
+static bool build_libnes(Nob_Cmd* cmd, int build_msvc, int build_profile)
+{
+    nob_log(NOB_INFO, "Compiling libnes...");
+
+    if (build_msvc) {
+        nob_cmd_append(cmd, "cl.exe", "/O2", "/W3", "/c");
+        if (build_profile) {
+            nob_cmd_append(cmd, "/DNES_PROFILE");
+        }
+        nob_cmd_append(cmd, "src/libnes.c", "/Fo:build/libnes.obj");
+        if (!nob_cmd_run_sync(*cmd)) return false;
+
+        cmd->count = 0;
+        nob_cmd_append(cmd, "lib.exe", "/OUT:build/libnes.lib", "build/libnes.obj");
+        if (!nob_cmd_run_sync(*cmd)) return false;
+
+        cmd->count = 0;
+        nob_cmd_append(cmd, "cl.exe", "/O2", "/W3", "/LD", "/DLIBNES_SHARED");
+        if (build_profile) {
+            nob_cmd_append(cmd, "/DNES_PROFILE");
+        }
+        nob_cmd_append(cmd, "src/libnes.c", "/Fo:build/libnes_shared.obj", "/link", "/OUT:build/libnes.dll");
+        if (!nob_cmd_run_sync(*cmd)) return false;
+    } else {
+        nob_cmd_append(cmd, "gcc", "-O2", "-c");
+        nob_cmd_append(cmd, "-Wall", "-Wno-narrowing", "-Wno-missing-braces", "--pedantic");
+        if (build_profile) {
+            nob_cmd_append(cmd, "-DNES_PROFILE");
+        }
+        nob_cmd_append(cmd, "src/libnes.c", "-o", "build/libnes.o");
+        if (!nob_cmd_run_sync(*cmd)) return false;
+
+        cmd->count = 0;
+        nob_cmd_append(cmd, "ar", "rcs", "build/libnes.a", "build/libnes.o");
+        if (!nob_cmd_run_sync(*cmd)) return false;
+
+        cmd->count = 0;
+        nob_cmd_append(cmd, "gcc", "-O2", "-shared", "-DLIBNES_SHARED");
+        nob_cmd_append(cmd, "-Wall", "-Wno-narrowing", "-Wno-missing-braces", "--pedantic");
+        if (build_profile) {
+            nob_cmd_append(cmd, "-DNES_PROFILE");
+        }
+        nob_cmd_append(cmd, "src/libnes.c", "-o", "build/libnes.dll", "-Wl,--out-implib,build/libnes.dll.a");
+        if (!nob_cmd_run_sync(*cmd)) return false;
+    }
+
+    nob_log(NOB_INFO, "Built build/libnes.a and build/libnes.dll");
+    return true;
+}
+
 int main(int argc, char** argv)
 {
     NOB_GO_REBUILD_URSELF(argc, argv);
@@ -63,6 +145,11 @@ int main(int argc, char** argv)
 
     int build_release = 0;
     int build_msvc = 0;
+    int build_bench = 0;
+    int build_tracedecode = 0;
+    int build_cputest = 0;
+    int build_lib = 0;
+    int build_profile = 0;
 
     if (argc > 1) {
         // Shift the first argument (the executable path) so
@@ -109,6 +196,16 @@ int main(int argc, char** argv)
                         nob_log(NOB_ERROR, "unknown compiler: %s. Valid options are 'gcc' or 'msvc'.", compiler_value);
                         return 1;
                     }
+                } else if (strcmp(arg, "bench") == 0) {
+                    build_bench = 1;
+                } else if (strcmp(arg, "tracedecode") == 0) {
+                    build_tracedecode = 1;
+                } else if (strcmp(arg, "cputest") == 0) {
+                    build_cputest = 1;
+                } else if (strcmp(arg, "libnes") == 0) {
+                    build_lib = 1;
+                } else if (strcmp(arg, "profile") == 0) {
+                    build_profile = 1;
                 } else {
                     nob_log(NOB_WARNING, "ignoring unknown argument: %s", arg);
                 }
@@ -116,6 +213,28 @@ int main(int argc, char** argv)
         }
     }
 
+    if (build_bench || build_tracedecode || build_cputest || build_lib) {
+        if (build_bench && !build_core_tool(&cmd, build_msvc, build_profile, "src/bench.c", "build/bench.exe")) {
+            return 1;
+        }
+        cmd.count = 0;
+        if (build_tracedecode &&
+            !build_core_tool(&cmd, build_msvc, build_profile, "src/trace_decode.c", "build/tracedecode.exe")) {
+            return 1;
+        }
+        cmd.count = 0;
+        if (build_cputest &&
+            !build_core_tool(&cmd, build_msvc, build_profile, "src/cpu_test.c", "build/cputest.exe")) {
+            return 1;
+        }
+        cmd.count = 0;
+        if (build_lib && !build_libnes(&cmd, build_msvc, build_profile)) {
+            return 1;
+        }
+
+        return 0;
+    }
+
     const char* cimgui_src_files[] = {
         "external/cimgui/cimgui.cpp",
         "external/cimgui/cimgui_impl.cpp",
@@ -210,6 +329,9 @@ int main(int argc, char** argv)
         nob_cmd_append(&cmd, "/Iexternal/cimgui");
         nob_cmd_append(&cmd, "/DCIMGUI_USE_SDL2", "/DCIMGUI_USE_OPENGL3");
         nob_cmd_append(&cmd, "/DIMGUI_IMPL_API=extern __declspec(dllimport)", "/DCIMGUI_NO_EXPORT");
+        if (build_profile) {
+            nob_cmd_append(&cmd, "/DNES_PROFILE");
+        }
         nob_cmd_append(&cmd, "src/main.c");
         nob_cmd_append(&cmd, "/link");
         nob_cmd_append(&cmd, "/LIBPATH:external/cimgui/build", "cimgui.lib");
@@ -236,6 +358,9 @@ int main(int argc, char** argv)
         nob_cmd_append(&cmd, "-Iexternal/cimgui");
         nob_cmd_append(&cmd, "-DCIMGUI_USE_SDL2", "-DCIMGUI_USE_OPENGL3");
         nob_cmd_append(&cmd, "-DIMGUI_IMPL_API=extern __declspec(dllimport)", "-DCIMGUI_NO_EXPORT");
+        if (build_profile) {
+            nob_cmd_append(&cmd, "-DNES_PROFILE");
+        }
         nob_cmd_append(&cmd, "src/main.c");
         nob_cmd_append(&cmd, "-Lexternal/cimgui/build", "-lcimgui");
         nob_cmd_append(&cmd, "-Lexternal/SDL2/lib/mingw32", "-lSDL2");
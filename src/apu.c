@@ -427,7 +427,7 @@ internal f32 LowPassFilter(AudioFilter* filter, f32 sampleValue)
     return newSampleValue;
 }
 
-internal void SetOutput(APU* apu)
+internal void SetOutput(APU* apu, APUOutput* output, NESDebug* debug)
 {
     u8 p1 = GetPulseOutput(&apu->pulse1);
     u8 p2 = GetPulseOutput(&apu->pulse2);
@@ -435,20 +435,16 @@ internal void SetOutput(APU* apu)
     u8 n = GetNoiseOutput(&apu->noise);
     u8 d = GetDMCOutput(&apu->dmc);
 
-    apu->pulse1.buffer[apu->pulse1.bufferIndex] = (s16)(pulseTable[p1] * APU_AMPLIFIER_VALUE);
-    apu->pulse1.bufferIndex = (apu->pulse1.bufferIndex + 1) % APU_BUFFER_LENGTH;
-
-    apu->pulse2.buffer[apu->pulse2.bufferIndex] = (s16)(pulseTable[p2] * APU_AMPLIFIER_VALUE);
-    apu->pulse2.bufferIndex = (apu->pulse2.bufferIndex + 1) % APU_BUFFER_LENGTH;
-
-    apu->triangle.buffer[apu->triangle.bufferIndex] = (s16)(tndTable[3 * t] * APU_AMPLIFIER_VALUE);
-    apu->triangle.bufferIndex = (apu->triangle.bufferIndex + 1) % APU_BUFFER_LENGTH;
-
-    apu->noise.buffer[apu->noise.bufferIndex] = (s16)(tndTable[2 * n] * APU_AMPLIFIER_VALUE);
-    apu->noise.bufferIndex = (apu->noise.bufferIndex + 1) % APU_BUFFER_LENGTH;
-
-    apu->dmc.buffer[apu->dmc.bufferIndex] = (s16)(tndTable[d] * APU_AMPLIFIER_VALUE);
-    apu->dmc.bufferIndex = (apu->dmc.bufferIndex + 1) % APU_BUFFER_LENGTH;
+    // per-channel waveforms are only captured for the debugger
+    if (debug) {
+        s32 index = debug->channelBufferIndex;
+        debug->channelBuffers[APU_CHANNEL_PULSE1][index] = (s16)(pulseTable[p1] * APU_AMPLIFIER_VALUE);
+        debug->channelBuffers[APU_CHANNEL_PULSE2][index] = (s16)(pulseTable[p2] * APU_AMPLIFIER_VALUE);
+        debug->channelBuffers[APU_CHANNEL_TRIANGLE][index] = (s16)(tndTable[3 * t] * APU_AMPLIFIER_VALUE);
+        debug->channelBuffers[APU_CHANNEL_NOISE][index] = (s16)(tndTable[2 * n] * APU_AMPLIFIER_VALUE);
+        debug->channelBuffers[APU_CHANNEL_DMC][index] = (s16)(tndTable[d] * APU_AMPLIFIER_VALUE);
+        debug->channelBufferIndex = (index + 1) % APU_BUFFER_LENGTH;
+    }
 
     f32 pulseOut = pulseTable[p1 + p2];
     f32 tndOut = tndTable[3 * t + 2 * n + d];
@@ -463,8 +459,8 @@ internal void SetOutput(APU* apu)
     out = HighPassFilter(&apu->hpFilter2, out);
     out = LowPassFilter(&apu->lpFilter, out);
 
-    apu->buffer[apu->bufferIndex] = (s16)(out * APU_AMPLIFIER_VALUE);
-    apu->bufferIndex = (apu->bufferIndex + 1) % APU_BUFFER_LENGTH;
+    output->buffer[output->bufferIndex] = (s16)(out * APU_AMPLIFIER_VALUE);
+    output->bufferIndex = (output->bufferIndex + 1) % APU_BUFFER_LENGTH;
 }
 
 void StepAPU(NES* nes)
@@ -490,7 +486,9 @@ void StepAPU(NES* nes)
     apu->sampleCounter += APU_SAMPLES_PER_SECOND; // += 48000
 
     if (apu->sampleCounter >= CPU_FREQ) { // >= 1789773
-        SetOutput(apu);
+        PROFILE_BEGIN(PROFILE_APU_OUTPUT);
+        SetOutput(apu, nes->apuOutput, nes->debug);
+        PROFILE_END(PROFILE_APU_OUTPUT);
         apu->sampleCounter -= CPU_FREQ; // keep remainder, do NOT zero
     }
 }
@@ -565,8 +563,8 @@ void ResetAPU(NES* nes)
     apu->lpFilter.lastInputSample = 0;
     apu->lpFilter.lastOutputSample = 0;
 
-    apu->bufferIndex = 0;
-    memset(apu->buffer, 0, sizeof(apu->buffer));
+    nes->apuOutput->bufferIndex = 0;
+    memset(nes->apuOutput->buffer, 0, sizeof(nes->apuOutput->buffer));
 
     WriteAPUFrameCounter(nes, 0);
 }
@@ -576,25 +574,42 @@ void PowerAPU(NES* nes)
     ResetAPU(nes);
 }
 
-void InitAPU(NES* nes)
+// The mixer tables are shared by every instance and instances can be created from several threads.
+global Mutex mixerTablesLock = MUTEX_INIT;
+global bool mixerTablesReady = false;
+
+internal void InitMixerTables(void)
 {
-    // from: http://wiki.nesdev.com/w/index.php/APU_Mixer
-    //
-    // pulse_table[n] = 95.52 / (8128.0 / n + 100)
-    // tnd_table[n] = 163.67 / (24329.0 / n + 100)
-    //
-    // output = pulse_out + tnd_out
-    // pulse_out = pulse_table[pulse1 + pulse2]
-    // tnd_out = tnd_table[3 * triangle + 2 * noise + dmc]
+    LockMutex(&mixerTablesLock);
 
-    for (s32 i = 0; i < 31; ++i) {
-        pulseTable[i] = 95.52f / (8128.0f / (f32)i + 100.0f);
-    }
+    if (!mixerTablesReady) {
+        // from: http://wiki.nesdev.com/w/index.php/APU_Mixer
+        //
+        // pulse_table[n] = 95.52 / (8128.0 / n + 100)
+        // tnd_table[n] = 163.67 / (24329.0 / n + 100)
+        //
+        // output = pulse_out + tnd_out
+        // pulse_out = pulse_table[pulse1 + pulse2]
+        // tnd_out = tnd_table[3 * triangle + 2 * noise + dmc]
 
-    for (s32 i = 0; i < 203; ++i) {
-        tndTable[i] = 163.67f / (24329.0f / (f32)i + 100.0f);
+        for (s32 i = 0; i < 31; ++i) {
+            pulseTable[i] = 95.52f / (8128.0f / (f32)i + 100.0f);
+        }
+
+        for (s32 i = 0; i < 203; ++i) {
+            tndTable[i] = 163.67f / (24329.0f / (f32)i + 100.0f);
+        }
+
+        mixerTablesReady = true;
     }
 
+    UnlockMutex(&mixerTablesLock);
+}
+
+void InitAPU(NES* nes)
+{
+    InitMixerTables();
+
     APU* apu = &nes->apu;
     apu->pulse1.channel = 1;
     apu->pulse2.channel = 2;
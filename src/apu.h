@@ -2,6 +2,7 @@
 #define APU_H
 
 #include "types.h"
+#include "profile.h"
 
 void CPUSetIRQSource(NES* nes, u32 sourceMask, bool asserted);
 
@@ -263,9 +264,11 @@ void WriteAPUFrameCounter(NES* nes, u8 value);
 
 static inline void StepAPUCycles(NES* nes, s32 cycles)
 {
+    PROFILE_BEGIN(PROFILE_APU);
     for (s32 i = 0; i < cycles; ++i) {
         StepAPU(nes);
     }
+    PROFILE_END(PROFILE_APU);
 }
 
 #endif // APU_H
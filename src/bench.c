@@ -0,0 +1,578 @@
+/*
+ * Benchmark: runs fixed workloads without SDL for a fixed number of frames and reports
+ * emulated cycles/sec, frames/sec and the time spent in each subsystem as JSON.
+ *
+ * The built-in workloads are small generated NROM programs:
+ *   cpu    rendering off, a loop mixing most addressing modes, subroutine calls and branches
+ *   scroll rendering on, the scroll and sprite positions change every frame, OAM DMA on every NMI
+ *   dmc    every audio channel on with a looping DMC sample at the fastest rate, stealing CPU cycles
+ * ROM files given on the command line are run as extra workloads.
+ *
+ * The subsystem split is measured by running the PPU and the APU on their own, from the same
+ * starting state, for the number of cycles the whole workload took. The CPU gets the rest.
+ *
+ * usage: bench [--frames N] [--output results.json] [--baseline baseline.json] [--threshold percent] [roms...]
+ */
+
+#include "core.c"
+
+#define BENCH_DEFAULT_FRAMES 600
+#define BENCH_WARMUP_FRAMES 30
+#define BENCH_DEFAULT_THRESHOLD 5.0
+#define BENCH_MAX_WORKLOADS 32
+
+#define BENCH_PRG_ORIGIN 0xC000
+#define BENCH_DMC_SAMPLES 0xD000
+
+typedef struct BenchProgram {
+    u8 rom[HEADER_SIZE + CPU_PRG_BANK_SIZE + CHR_BANK_SIZE];
+    u16 pc;
+} BenchProgram;
+
+typedef struct BenchResult {
+    const char* name;
+    bool valid;
+    u64 frames;
+    u64 cycles;
+    f64 wallSeconds;
+    f64 cpuSeconds;
+    f64 ppuSeconds;
+    f64 apuSeconds;
+    u64 frameHash;
+} BenchResult;
+
+// 6502 opcodes used by the generated programs
+#define OP_ORA_IMM 0x09
+#define OP_ASL_ZP 0x06
+#define OP_CLC 0x18
+#define OP_ORA_ABSX 0x1D
+#define OP_JSR 0x20
+#define OP_AND_IMM 0x29
+#define OP_BIT_ABS 0x2C
+#define OP_RTI 0x40
+#define OP_PHA 0x48
+#define OP_EOR_IMM 0x49
+#define OP_EOR_ZP 0x45
+#define OP_JMP_ABS 0x4C
+#define OP_RTS 0x60
+#define OP_ADC_ZP 0x65
+#define OP_ROR_ZP 0x66
+#define OP_PLA 0x68
+#define OP_ADC_IMM 0x69
+#define OP_SEI 0x78
+#define OP_STA_ZP 0x85
+#define OP_STA_ABS 0x8D
+#define OP_TXA 0x8A
+#define OP_BCC 0x90
+#define OP_STA_INDY 0x91
+#define OP_TXS 0x9A
+#define OP_STA_ABSX 0x9D
+#define OP_LDX_IMM 0xA2
+#define OP_LDA_ZP 0xA5
+#define OP_LDA_IMM 0xA9
+#define OP_LDY_IMM 0xA0
+#define OP_LDA_INDY 0xB1
+#define OP_LDA_ABSX 0xBD
+#define OP_INY 0xC8
+#define OP_CMP_IMM 0xC9
+#define OP_DEY 0x88
+#define OP_BNE 0xD0
+#define OP_CLD 0xD8
+#define OP_CPX_IMM 0xE0
+#define OP_INX 0xE8
+#define OP_INC_ZP 0xE6
+#define OP_SBC_IMM 0xE9
+#define OP_INC_ABSX 0xFE
+#define OP_BPL 0x10
+
+internal void Emit(BenchProgram* program, u8 value)
+{
+    program->rom[HEADER_SIZE + program->pc - BENCH_PRG_ORIGIN] = value;
+    program->pc++;
+}
+
+internal void Emit8(BenchProgram* program, u8 opcode, u8 value)
+{
+    Emit(program, opcode);
+    Emit(program, value);
+}
+
+internal void Emit16(BenchProgram* program, u8 opcode, u16 address)
+{
+    Emit(program, opcode);
+    Emit(program, address & 0xFF);
+    Emit(program, address >> 8);
+}
+
+internal void EmitBranch(BenchProgram* program, u8 opcode, u16 target)
+{
+    Emit8(program, opcode, (u8)(target - (program->pc + 2)));
+}
+
+internal void EmitStore(BenchProgram* program, u16 address, u8 value)
+{
+    Emit8(program, OP_LDA_IMM, value);
+    Emit16(program, OP_STA_ABS, address);
+}
+
+internal void SetVector(BenchProgram* program, u16 vector, u16 address)
+{
+    program->rom[HEADER_SIZE + vector - BENCH_PRG_ORIGIN] = address & 0xFF;
+    program->rom[HEADER_SIZE + vector - BENCH_PRG_ORIGIN + 1] = address >> 8;
+}
+
+internal u32 NextRandom(u32* state)
+{
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// Header, NOPs everywhere, random CHR and the usual reset: interrupts off, rendering off, two vblanks.
+internal void BeginProgram(BenchProgram* program)
+{
+    memset(program->rom, 0xEA, sizeof(program->rom));
+
+    u8 header[HEADER_SIZE] = {'N', 'E', 'S', 0x1A, 1, 1, 0x01};
+    memcpy(program->rom, header, HEADER_SIZE);
+
+    u32 seed = 0x2545F491;
+    u8* chr = program->rom + HEADER_SIZE + CPU_PRG_BANK_SIZE;
+    for (s32 i = 0; i < CHR_BANK_SIZE; ++i) {
+        chr[i] = (u8)NextRandom(&seed);
+    }
+
+    program->pc = BENCH_PRG_ORIGIN;
+
+    Emit(program, OP_RTI);
+    SetVector(program, 0xFFFA, BENCH_PRG_ORIGIN);
+    SetVector(program, 0xFFFE, BENCH_PRG_ORIGIN);
+    SetVector(program, 0xFFFC, program->pc);
+
+    Emit(program, OP_SEI);
+    Emit(program, OP_CLD);
+    Emit8(program, OP_LDX_IMM, 0xFF);
+    Emit(program, OP_TXS);
+    EmitStore(program, 0x2000, 0x00);
+    EmitStore(program, 0x2001, 0x00);
+
+    for (s32 i = 0; i < 2; ++i) {
+        u16 wait = program->pc;
+        Emit16(program, OP_BIT_ABS, 0x2002);
+        EmitBranch(program, OP_BPL, wait);
+    }
+}
+
+internal void BuildCPUWorkload(BenchProgram* program)
+{
+    BeginProgram(program);
+
+    // ($20) points to $0500
+    EmitStore(program, 0x0020, 0x00);
+    EmitStore(program, 0x0021, 0x05);
+
+    u16 mainLoop = program->pc;
+    Emit8(program, OP_LDX_IMM, 0x00);
+    Emit8(program, OP_LDY_IMM, 0x00);
+
+    u16 loop = program->pc;
+    Emit16(program, OP_LDA_ABSX, 0x0300);
+    Emit8(program, OP_ADC_IMM, 0x37);
+    Emit16(program, OP_STA_ABSX, 0x0300);
+    Emit8(program, OP_EOR_ZP, 0x10);
+    Emit8(program, OP_STA_ZP, 0x10);
+    Emit8(program, OP_LDA_INDY, 0x20);
+    Emit8(program, OP_ADC_ZP, 0x10);
+    Emit8(program, OP_STA_INDY, 0x20);
+    Emit(program, OP_INY);
+    Emit8(program, OP_ASL_ZP, 0x11);
+    Emit8(program, OP_ROR_ZP, 0x12);
+    Emit16(program, OP_ORA_ABSX, 0x0400);
+    Emit8(program, OP_AND_IMM, 0x7F);
+    Emit8(program, OP_CMP_IMM, 0x40);
+    Emit8(program, OP_BCC, 0x02);
+    Emit8(program, OP_SBC_IMM, 0x10);
+    Emit16(program, OP_STA_ABSX, 0x0400);
+    u16 call = program->pc;
+    Emit16(program, OP_JSR, 0x0000);
+    Emit(program, OP_INX);
+    EmitBranch(program, OP_BNE, loop);
+    Emit16(program, OP_JMP_ABS, mainLoop);
+
+    u16 subroutine = program->pc;
+    Emit(program, OP_PHA);
+    Emit(program, OP_TXA);
+    Emit(program, OP_CLC);
+    Emit8(program, OP_ADC_ZP, 0x13);
+    Emit8(program, OP_STA_ZP, 0x13);
+    Emit(program, OP_PLA);
+    Emit(program, OP_RTS);
+
+    program->pc = call;
+    Emit16(program, OP_JSR, subroutine);
+}
+
+internal void BuildScrollWorkload(BenchProgram* program)
+{
+    BeginProgram(program);
+
+    // palette
+    EmitStore(program, 0x2006, 0x3F);
+    EmitStore(program, 0x2006, 0x00);
+    Emit8(program, OP_LDX_IMM, 0x00);
+    u16 palette = program->pc;
+    Emit(program, OP_TXA);
+    Emit16(program, OP_STA_ABS, 0x2007);
+    Emit(program, OP_INX);
+    Emit8(program, OP_CPX_IMM, 0x20);
+    EmitBranch(program, OP_BNE, palette);
+
+    // all four nametables, tiles and attributes
+    EmitStore(program, 0x2006, 0x20);
+    EmitStore(program, 0x2006, 0x00);
+    Emit8(program, OP_LDY_IMM, 0x10);
+    Emit8(program, OP_LDX_IMM, 0x00);
+    u16 nametable = program->pc;
+    Emit(program, OP_TXA);
+    Emit16(program, OP_STA_ABS, 0x2007);
+    Emit(program, OP_INX);
+    EmitBranch(program, OP_BNE, nametable);
+    Emit(program, OP_DEY);
+    EmitBranch(program, OP_BNE, nametable);
+
+    // sprites all over the screen
+    u16 sprites = program->pc;
+    Emit(program, OP_TXA);
+    Emit16(program, OP_STA_ABSX, 0x0200);
+    Emit(program, OP_INX);
+    EmitBranch(program, OP_BNE, sprites);
+
+    EmitStore(program, 0x2000, 0x80);
+    EmitStore(program, 0x2001, 0x1E);
+
+    // move every sprite one pixel to the right, forever
+    u16 mainLoop = program->pc;
+    Emit8(program, OP_LDX_IMM, 0x00);
+    u16 move = program->pc;
+    Emit16(program, OP_INC_ABSX, 0x0203);
+    Emit(program, OP_INX);
+    Emit(program, OP_INX);
+    Emit(program, OP_INX);
+    Emit(program, OP_INX);
+    EmitBranch(program, OP_BNE, move);
+    Emit16(program, OP_JMP_ABS, mainLoop);
+
+    // NMI: sprite DMA, scroll both axes and flip the nametable every frame
+    u16 nmi = program->pc;
+    Emit(program, OP_PHA);
+    EmitStore(program, 0x4014, 0x02);
+    Emit8(program, OP_INC_ZP, 0x30);
+    Emit8(program, OP_INC_ZP, 0x31);
+    Emit8(program, OP_INC_ZP, 0x31);
+    Emit8(program, OP_LDA_ZP, 0x30);
+    Emit16(program, OP_STA_ABS, 0x2005);
+    Emit8(program, OP_LDA_ZP, 0x31);
+    Emit16(program, OP_STA_ABS, 0x2005);
+    Emit8(program, OP_LDA_ZP, 0x30);
+    Emit8(program, OP_AND_IMM, 0x03);
+    Emit8(program, OP_ORA_IMM, 0x80);
+    Emit16(program, OP_STA_ABS, 0x2000);
+    Emit(program, OP_PLA);
+    Emit(program, OP_RTI);
+
+    SetVector(program, 0xFFFA, nmi);
+}
+
+internal void BuildDMCWorkload(BenchProgram* program)
+{
+    BeginProgram(program);
+
+    // looping sample at $D000, 4081 bytes, fastest rate
+    EmitStore(program, 0x4010, 0x4F);
+    EmitStore(program, 0x4012, (BENCH_DMC_SAMPLES - BENCH_PRG_ORIGIN) / 64);
+    EmitStore(program, 0x4013, 0xFF);
+
+    EmitStore(program, 0x4000, 0xBF);
+    EmitStore(program, 0x4002, 0xFF);
+    EmitStore(program, 0x4003, 0x00);
+    EmitStore(program, 0x4004, 0x9F);
+    EmitStore(program, 0x4005, 0x88);
+    EmitStore(program, 0x4006, 0x80);
+    EmitStore(program, 0x4007, 0x00);
+    EmitStore(program, 0x4008, 0xFF);
+    EmitStore(program, 0x400A, 0x40);
+    EmitStore(program, 0x400B, 0x00);
+    EmitStore(program, 0x400C, 0x3F);
+    EmitStore(program, 0x400E, 0x03);
+    EmitStore(program, 0x400F, 0x00);
+    EmitStore(program, 0x4015, 0x1F);
+
+    // keep retuning the pulse and triangle timers
+    u16 mainLoop = program->pc;
+    Emit8(program, OP_INC_ZP, 0x40);
+    Emit8(program, OP_LDA_ZP, 0x40);
+    Emit16(program, OP_STA_ABS, 0x4002);
+    Emit8(program, OP_EOR_IMM, 0xFF);
+    Emit16(program, OP_STA_ABS, 0x4006);
+    Emit16(program, OP_STA_ABS, 0x400A);
+    Emit16(program, OP_JMP_ABS, mainLoop);
+
+    u32 seed = 0x9E3779B9;
+    u8* samples = program->rom + HEADER_SIZE + (BENCH_DMC_SAMPLES - BENCH_PRG_ORIGIN);
+    for (s32 i = 0; i < 0x1000; ++i) {
+        samples[i] = (u8)NextRandom(&seed);
+    }
+}
+
+internal void RunFrames(NES* nes, u64 frames)
+{
+    u64 frameCount = nes->ppu.frameCount + frames;
+    while (nes->ppu.frameCount < frameCount) {
+        StepCPU(nes);
+    }
+}
+
+internal f64 SecondsSince(u64 startTicks)
+{
+    return (f64)(GetTimerTicks() - startTicks) / (f64)GetTimerFrequency();
+}
+
+internal void RunWorkload(const char* name, Cartridge cartridge, u64 frames, BenchResult* result)
+{
+    memset(result, 0, sizeof(BenchResult));
+    result->name = name;
+
+    NES* nes = CreateNES(cartridge);
+    if (!nes) {
+        fprintf(stderr, "Error: %s: unsupported mapper\n", name);
+        return;
+    }
+
+    RunFrames(nes, BENCH_WARMUP_FRAMES);
+
+    u8* snapshot = (u8*)Allocate(GetSnapshotSize(nes));
+    SnapshotNES(nes, snapshot);
+
+    u64 startCycles = nes->cpu.cycles;
+    u64 startTicks = GetTimerTicks();
+    RunFrames(nes, frames);
+    result->wallSeconds = SecondsSince(startTicks);
+    result->cycles = nes->cpu.cycles - startCycles;
+    result->frames = frames;
+    result->frameHash = HashFrame(nes);
+
+    // the same number of cycles again for the PPU and the APU on their own
+    const s32 chunk = 1 << 20;
+
+    RestoreNES(nes, snapshot);
+    startTicks = GetTimerTicks();
+    for (u64 cycles = 0; cycles < result->cycles; cycles += chunk) {
+        StepPPUCycles(nes, (s32)MIN((u64)chunk, result->cycles - cycles));
+    }
+    result->ppuSeconds = SecondsSince(startTicks);
+
+    RestoreNES(nes, snapshot);
+    startTicks = GetTimerTicks();
+    for (u64 cycles = 0; cycles < result->cycles; cycles += chunk) {
+        StepAPUCycles(nes, (s32)MIN((u64)chunk, result->cycles - cycles));
+        nes->apuOutput->bufferIndex = 0;
+    }
+    result->apuSeconds = SecondsSince(startTicks);
+
+    result->cpuSeconds = MAX(0.0, result->wallSeconds - result->ppuSeconds - result->apuSeconds);
+    result->valid = true;
+
+    Free(snapshot);
+    Destroy(nes);
+}
+
+internal void WriteBenchResults(FILE* file, BenchResult* results, s32 count)
+{
+    fprintf(file, "{\"workloads\":[");
+
+    for (s32 i = 0; i < count; ++i) {
+        BenchResult* result = &results[i];
+        f64 seconds = result->wallSeconds > 0 ? result->wallSeconds : 1e-9;
+
+        fprintf(file, "%s\n{\"name\":", i > 0 ? "," : "");
+        WriteJSONString(file, result->name);
+        fprintf(file, ",\"valid\":%s", result->valid ? "true" : "false");
+        fprintf(file, ",\"frames\":%llu", (unsigned long long)result->frames);
+        fprintf(file, ",\"cycles\":%llu", (unsigned long long)result->cycles);
+        fprintf(file, ",\"wall_time_s\":%.6f", result->wallSeconds);
+        fprintf(file, ",\"fps\":%.2f", (f64)result->frames / seconds);
+        fprintf(file, ",\"cycles_per_s\":%.0f", (f64)result->cycles / seconds);
+        fprintf(file, ",\"cpu_s\":%.6f,\"ppu_s\":%.6f,\"apu_s\":%.6f", result->cpuSeconds, result->ppuSeconds,
+                result->apuSeconds);
+        fprintf(file, ",\"frame_hash\":\"%016llx\"}", (unsigned long long)result->frameHash);
+    }
+
+    fprintf(file, "]}\n");
+}
+
+// Finds the fps of a workload in a results file written by WriteBenchResults.
+internal bool FindBaselineFPS(const char* json, const char* name, f64* fps)
+{
+    char key[MAX_PATH_LENGTH + 16];
+    snprintf(key, sizeof(key), "\"name\":\"%s\"", name);
+
+    const char* workload = strstr(json, key);
+    if (!workload) {
+        return false;
+    }
+
+    const char* value = strstr(workload, "\"fps\":");
+    const char* next = strstr(workload + 1, "\"name\":");
+    if (!value || (next && value > next)) {
+        return false;
+    }
+
+    *fps = strtod(value + strlen("\"fps\":"), NULL);
+    return true;
+}
+
+internal char* ReadTextFile(const char* filePath)
+{
+    FILE* file = fopen(filePath, "rb");
+    if (!file) {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char* text = (char*)Allocate(length + 1);
+    if (text) {
+        length = (long)fread(text, 1, length, file);
+        text[length] = 0;
+    }
+
+    fclose(file);
+    return text;
+}
+
+// Returns the number of workloads slower than the baseline by more than threshold percent.
+internal s32 CompareWithBaseline(const char* baselinePath, f64 threshold, BenchResult* results, s32 count)
+{
+    char* baseline = ReadTextFile(baselinePath);
+    if (!baseline) {
+        fprintf(stderr, "Error: Could not read baseline: %s\n", baselinePath);
+        return 1;
+    }
+
+    s32 regressions = 0;
+    for (s32 i = 0; i < count; ++i) {
+        f64 baselineFPS;
+        if (!results[i].valid || !FindBaselineFPS(baseline, results[i].name, &baselineFPS) || baselineFPS <= 0) {
+            fprintf(stderr, "%-12s no baseline\n", results[i].name);
+            continue;
+        }
+
+        f64 fps = (f64)results[i].frames / MAX(results[i].wallSeconds, 1e-9);
+        f64 change = (fps - baselineFPS) * 100.0 / baselineFPS;
+        bool regressed = change < -threshold;
+        if (regressed) {
+            regressions++;
+        }
+
+        fprintf(stderr, "%-12s %10.2f fps, baseline %10.2f fps, %+6.2f%%%s\n", results[i].name, fps, baselineFPS,
+                change, regressed ? "  REGRESSION" : "");
+    }
+
+    Free(baseline);
+    return regressions;
+}
+
+#define shift_args(argc, argv) (ASSERT(*(argc) > 0), (*(argc))--, *(*(argv))++)
+
+int main(int argc, char** argv)
+{
+    u64 frames = BENCH_DEFAULT_FRAMES;
+    const char* outputPath = NULL;
+    const char* baselinePath = NULL;
+    f64 threshold = BENCH_DEFAULT_THRESHOLD;
+    const char* romPaths[BENCH_MAX_WORKLOADS];
+    s32 romCount = 0;
+
+    const char* program = shift_args(&argc, &argv);
+    (void)program;
+
+    while (argc > 0) {
+        const char* flag = shift_args(&argc, &argv);
+        if (strcmp(flag, "--frames") == 0 && argc > 0) {
+            frames = strtoull(shift_args(&argc, &argv), NULL, 0);
+        } else if (strcmp(flag, "--output") == 0 && argc > 0) {
+            outputPath = shift_args(&argc, &argv);
+        } else if (strcmp(flag, "--baseline") == 0 && argc > 0) {
+            baselinePath = shift_args(&argc, &argv);
+        } else if (strcmp(flag, "--threshold") == 0 && argc > 0) {
+            threshold = strtod(shift_args(&argc, &argv), NULL);
+        } else if (flag[0] != '-' && romCount < BENCH_MAX_WORKLOADS - 3) {
+            romPaths[romCount++] = flag;
+        } else {
+            fprintf(stderr, "usage: bench [--frames N] [--output results.json] [--baseline baseline.json] "
+                            "[--threshold percent] [roms...]\n");
+            return 1;
+        }
+    }
+
+    BenchResult results[BENCH_MAX_WORKLOADS];
+    s32 count = 0;
+
+    struct {
+        const char* name;
+        void (*build)(BenchProgram* program);
+    } workloads[] = {
+        {"cpu", BuildCPUWorkload},
+        {"scroll", BuildScrollWorkload},
+        {"dmc", BuildDMCWorkload},
+    };
+
+    for (s32 i = 0; i < (s32)(sizeof(workloads) / sizeof(workloads[0])); ++i) {
+        BenchProgram program;
+        workloads[i].build(&program);
+
+        Cartridge cartridge = {0};
+        if (!LoadNesRomFromMemory(program.rom, sizeof(program.rom), &cartridge)) {
+            fprintf(stderr, "Error: Could not load the %s workload\n", workloads[i].name);
+            return 1;
+        }
+
+        RunWorkload(workloads[i].name, cartridge, frames, &results[count++]);
+    }
+
+    for (s32 i = 0; i < romCount; ++i) {
+        Cartridge cartridge = {0};
+        if (!LoadNesRom((char*)romPaths[i], &cartridge)) {
+            fprintf(stderr, "Error: Could not load ROM: %s\n", romPaths[i]);
+            continue;
+        }
+
+        RunWorkload(romPaths[i], cartridge, frames, &results[count++]);
+    }
+
+    FILE* output = stdout;
+    if (outputPath) {
+        output = fopen(outputPath, "w");
+        if (!output) {
+            fprintf(stderr, "Error: Could not open output file: %s\n", outputPath);
+            return 1;
+        }
+    }
+
+    WriteBenchResults(output, results, count);
+
+    if (output != stdout) {
+        fclose(output);
+    }
+
+    if (baselinePath && CompareWithBaseline(baselinePath, threshold, results, count) > 0) {
+        return 1;
+    }
+
+    return 0;
+}
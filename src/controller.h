@@ -2,6 +2,7 @@
 #define CONTROLLER_H
 
 #include "types.h"
+#include "movie.h"
 
 typedef enum Buttons {
     BUTTON_A = 0,
@@ -63,6 +64,17 @@ static inline void WriteControllerU8(NES* nes, s32 index, u8 value)
     controller->strobe = value & 0x01;
     if (controller->strobe) {
         controller->index = 0;
+
+        // the game latches the pads here, the host input is read now rather than when the frame
+        // started, up to a frame later
+        if (nes->liveInput) {
+            controller->state = (u8)(AtomicLoadU32(nes->liveInput) >> (index * 8));
+        }
+
+        // movies record or replace the state at this point
+        if (nes->movie) {
+            LatchMovieInput(nes, index);
+        }
     }
 }
 
@@ -0,0 +1,85 @@
+/*
+ * Unity build of the emulator core, everything that doesn't depend on SDL, OpenGL or ImGui.
+ * main.c includes it below the frontend, the SDL-free programs (bench) include it on its own.
+ */
+
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L // for platform.c
+#endif
+#if defined(__APPLE__) && !defined(_DARWIN_C_SOURCE)
+#define _DARWIN_C_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "utils.h"
+#include "types.h"
+#include "platform.h"
+#include "profile.h"
+#include "hash.h"
+#include "rom_cache.h"
+#include "image.h"
+#include "media.h"
+#include "movie.h"
+#include "thread_pool.h"
+#include "cartridge.h"
+#include "nes.h"
+#include "cpu.h"
+#include "cpu_debug.h"
+#include "cpu_trace.h"
+#include "cpu_profile.h"
+#include "ppu.h"
+#include "ppu_debug.h"
+#include "apu.h"
+#include "controller.h"
+#include "gui.h"
+#include "mapper.h"
+#include "mapper0.h"
+#include "mapper1.h"
+#include "mapper2.h"
+#include "mapper3.h"
+#include "mapper66.h"
+#include "memory.h"
+#include "oam.h"
+#include "headless.h"
+#include "test_runner.h"
+#include "nes_batch.h"
+#include "emu_thread.h"
+
+#include "platform.c"
+#include "profile.c"
+#include "hash.c"
+#include "rom_cache.c"
+#include "image.c"
+#include "media.c"
+#include "movie.c"
+#include "thread_pool.c"
+#include "nes.c"
+#include "cpu.c"
+#include "cpu_io.c"
+#include "cpu_debug.c"
+#include "cpu_trace.c"
+#include "cpu_profile.c"
+#include "ppu.c"
+#include "ppu_debug.c"
+#include "apu.c"
+#include "apu_tables.c"
+#include "controller.c"
+#include "gui.c"
+#include "mapper0.c"
+#include "mapper1.c"
+#include "mapper2.c"
+#include "mapper3.c"
+#include "mapper66.c"
+#include "headless.c"
+#include "test_runner.c"
+#include "nes_batch.c"
+#include "emu_thread.c"
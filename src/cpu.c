@@ -1,4 +1,5 @@
 #include "cpu.h"
+#include "cpu_profile.h"
 
 typedef struct CPUOperand {
     u16 address;
@@ -12,8 +13,15 @@ internal inline void CPUAdvanceOneCycle(NES* nes)
 {
     CPU* cpu = &nes->cpu;
 
+#ifdef CPU_FLAT_BUS
+    if (!nes->flatBus) {
+        StepPPUCycles(nes, 1);
+        StepAPUCycles(nes, 1);
+    }
+#else
     StepPPUCycles(nes, 1);
     StepAPUCycles(nes, 1);
+#endif
 
     if (!cpu->prevNmiLine && cpu->nmiLine) {
         cpu->nmiPending = true;
@@ -1668,12 +1676,13 @@ void ResetCPU(NES* nes)
     CPURequestReset(nes);
 }
 
-// Allocates CPU RAM on first use.
+// Binds CPU RAM and cartridge SRAM.
 void InitCPU(NES* nes)
 {
-    if (!nes->cpuMemory.created) {
-        CreateMemory(&nes->cpuMemory, CPU_RAM_TOTAL_SIZE);
-        ZeroMemoryBytes(&nes->cpuMemory);
+    InitMemory(&nes->cpuMemory, nes->cpuRAM, CPU_RAM_SIZE);
+
+    if (!nes->batteryFile.data) {
+        InitMemory(&nes->sramMemory, nes->sramRAM, CPU_SRAM_SIZE);
     }
 }
 
@@ -2079,6 +2088,8 @@ void CPUSetIRQSource(NES* nes, u32 sourceMask, bool asserted)
 // Executes one CPU instruction or stall cycle.
 CPUStep StepCPU(NES* nes)
 {
+    PROFILE_BEGIN(PROFILE_CPU);
+
     CPUStep step = {0};
 
     CPU* cpu = &nes->cpu;
@@ -2087,8 +2098,13 @@ CPUStep StepCPU(NES* nes)
     if (cpu->waitCycles) {
         CPUStallCycle(nes);
 
+        if (nes->cpuProfile) {
+            nes->cpuProfile->stallCycles++;
+        }
+
         step.cycles = 1;
         step.instruction = NULL;
+        PROFILE_END(PROFILE_CPU);
         return step;
     }
 
@@ -2099,14 +2115,30 @@ CPUStep StepCPU(NES* nes)
 
         step.cycles = cpu->cycles - startCpuCycles;
         step.instruction = NULL;
+
+        if (nes->cpuProfile) {
+            nes->cpuProfile->interruptCycles += step.cycles;
+        }
+
+        PROFILE_END(PROFILE_CPU);
         return step;
     }
 
+    // the index is taken before executing, the instruction itself may switch banks
+    CPUProfile* profile = nes->cpuProfile;
+    u16 pc = cpu->pc;
+    u32 profileIndex = profile ? GetCPUProfileIndex(nes, pc) : 0;
+
     u8 opcode = CPUFetchPC(nes);
     CPUInstruction* instruction = &cpuInstructions[opcode];
     ExecuteInstruction(nes, instruction);
 
     step.cycles = cpu->cycles - startCpuCycles;
     step.instruction = instruction;
+
+    if (profile) {
+        RecordCPUProfile(profile, profileIndex, pc, step.cycles);
+    }
+    PROFILE_END(PROFILE_CPU);
     return step;
 }
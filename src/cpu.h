@@ -9,12 +9,55 @@
 #include "controller.h"
 #include "cpu_debug.h"
 
-#define CPU_RAM_TOTAL_SIZE KILOBYTES(64)
-
 #define CPU_RESET_ADDRESS 0xFFFC
 #define CPU_IRQ_ADDRESS 0xFFFE
 #define CPU_NMI_ADDRESS 0xFFFA
 
+#ifdef CPU_FLAT_BUS
+#define CPU_FLAT_BUS_MAX_CYCLES 32
+
+/*
+ * CPU test builds (cputest) define CPU_FLAT_BUS. When nes->flatBus is set the CPU sees a flat 64 KB
+ * memory instead of the memory map, every bus cycle is recorded and the PPU and the APU aren't clocked,
+ * so single instructions can be checked cycle by cycle against recorded bus activity.
+ */
+typedef struct CPUBusCycle {
+    u16 address;
+    u8 value;
+    bool write;
+} CPUBusCycle;
+
+typedef struct CPUFlatBus {
+    u8 memory[0x10000];
+    CPUBusCycle cycles[CPU_FLAT_BUS_MAX_CYCLES];
+    s32 cycleCount; // keeps counting past CPU_FLAT_BUS_MAX_CYCLES
+} CPUFlatBus;
+
+static inline void RecordFlatBusCycle(CPUFlatBus* bus, u16 address, u8 value, bool write)
+{
+    if (bus->cycleCount < CPU_FLAT_BUS_MAX_CYCLES) {
+        CPUBusCycle* cycle = &bus->cycles[bus->cycleCount];
+        cycle->address = address;
+        cycle->value = value;
+        cycle->write = write;
+    }
+    bus->cycleCount++;
+}
+
+static inline u8 ReadFlatBus(CPUFlatBus* bus, u16 address)
+{
+    u8 value = bus->memory[address];
+    RecordFlatBusCycle(bus, address, value, false);
+    return value;
+}
+
+static inline void WriteFlatBus(CPUFlatBus* bus, u16 address, u8 value)
+{
+    bus->memory[address] = value;
+    RecordFlatBusCycle(bus, address, value, true);
+}
+#endif
+
 #define CPU_STATUS_INITIAL_VALUE 0x24
 #define CPU_STACK_PTR_INITIAL_VALUE 0xFF
 
@@ -23,7 +66,6 @@
 #define CPU_PRG_BANK_SIZE KILOBYTES(16)
 
 #define CPU_RAM_OFFSET 0x0000
-#define CPU_RAM_SIZE 0x0800
 
 #define CPU_RAM_MIRROR_OFFSET 0x0800
 #define CPU_RAM_MIRROR_SIZE 0x1800
@@ -64,7 +106,6 @@
 #define CPU_GAMEPAD_1_ADDRESS 0x4017
 
 #define CPU_SRAM_OFFSET 0x6000
-#define CPU_SRAM_SIZE 0x2000
 
 #define CARRY_FLAG 0
 #define ZERO_FLAG 1
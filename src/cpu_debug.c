@@ -286,3 +286,39 @@ inline const char* GetRegisterStr(CPURegister reg)
 {
     return reg <= CPU_SP ? registerStrs[reg] : "UK";
 }
+
+s32 DisassembleInstruction(const u8* bytes, u16 pc, char* buffer, size bufferSize)
+{
+    CPUInstruction* instruction = &cpuInstructions[bytes[0]];
+    const char* mnemonic = GetInstructionStr(instruction->mnemonic);
+    u16 operand = instruction->bytesCount == 3 ? (bytes[2] << 8) | bytes[1] : bytes[1];
+
+    switch (instruction->addressingMode) {
+        case AM_IMM:
+            return snprintf(buffer, bufferSize, "%s #$%02X", mnemonic, operand);
+        case AM_ABS:
+            return snprintf(buffer, bufferSize, "%s $%04X", mnemonic, operand);
+        case AM_ABX:
+            return snprintf(buffer, bufferSize, "%s $%04X,X", mnemonic, operand);
+        case AM_ABY:
+            return snprintf(buffer, bufferSize, "%s $%04X,Y", mnemonic, operand);
+        case AM_ZPA:
+            return snprintf(buffer, bufferSize, "%s $%02X", mnemonic, operand);
+        case AM_ZPX:
+            return snprintf(buffer, bufferSize, "%s $%02X,X", mnemonic, operand);
+        case AM_ZPY:
+            return snprintf(buffer, bufferSize, "%s $%02X,Y", mnemonic, operand);
+        case AM_IND:
+            return snprintf(buffer, bufferSize, "%s ($%04X)", mnemonic, operand);
+        case AM_IZX:
+            return snprintf(buffer, bufferSize, "%s ($%02X,X)", mnemonic, operand);
+        case AM_IZY:
+            return snprintf(buffer, bufferSize, "%s ($%02X),Y", mnemonic, operand);
+        case AM_ACC:
+            return snprintf(buffer, bufferSize, "%s A", mnemonic);
+        case AM_REL:
+            return snprintf(buffer, bufferSize, "%s $%04X", mnemonic, (u16)(pc + 2 + (s8)bytes[1]));
+        default:
+            return snprintf(buffer, bufferSize, "%s", mnemonic);
+    }
+}
@@ -9,4 +9,8 @@ extern CPUInstruction cpuInstructions[CPU_INSTRUCTIONS_COUNT];
 const char* GetInstructionStr(CPUInstructionMnemonic instruction);
 const char* GetRegisterStr(CPURegister cpuRegister);
 
+// Formats the instruction in bytes (as many as its bytesCount) at address pc, like "LDA $0200,X".
+// Only the operand bytes are decoded, no effective addresses, so it doesn't need the registers or the bus.
+s32 DisassembleInstruction(const u8* bytes, u16 pc, char* buffer, size bufferSize);
+
 #endif
@@ -2,6 +2,12 @@
 
 u8 ReadCPUU8(NES* nes, u16 address)
 {
+#ifdef CPU_FLAT_BUS
+    if (nes->flatBus) {
+        return ReadFlatBus(nes->flatBus, address);
+    }
+#endif
+
     if (ISBETWEEN(address, 0x00, 0x2000)) {
         // Memory locations $0000-$07FF are mirrored three times at $0800-$1FFF.
         // This means that, for example, any data written to $0000 will also be written to $0800, $1000 and $1800.
@@ -70,11 +76,14 @@ u8 ReadCPUU8(NES* nes, u16 address)
     }
 
     if (ISBETWEEN(address, 0x6000, 0x8000)) {
-        return ReadU8(&nes->cpuMemory, address);
+        return ReadU8(&nes->sramMemory, address - CPU_SRAM_OFFSET);
     }
 
     if (ISBETWEEN(address, 0x8000, 0x10000)) {
-        return nes->mapperReadU8(nes, address);
+        PROFILE_BEGIN(PROFILE_MAPPER);
+        u8 value = nes->mapperReadU8(nes, address);
+        PROFILE_END(PROFILE_MAPPER);
+        return value;
     }
 
     // it should no get here
@@ -83,6 +92,12 @@ u8 ReadCPUU8(NES* nes, u16 address)
 
 u8 PeekCPUU8(NES* nes, u16 address)
 {
+#ifdef CPU_FLAT_BUS
+    if (nes->flatBus) {
+        return nes->flatBus->memory[address];
+    }
+#endif
+
     if (ISBETWEEN(address, 0x00, 0x2000)) {
         address = (address % 0x800);
         return ReadU8(&nes->cpuMemory, address);
@@ -93,7 +108,7 @@ u8 PeekCPUU8(NES* nes, u16 address)
     }
 
     if (ISBETWEEN(address, 0x6000, 0x8000)) {
-        return ReadU8(&nes->cpuMemory, address);
+        return ReadU8(&nes->sramMemory, address - CPU_SRAM_OFFSET);
     }
 
     if (ISBETWEEN(address, 0x8000, 0x10000)) {
@@ -105,6 +120,13 @@ u8 PeekCPUU8(NES* nes, u16 address)
 
 void WriteCPUU8(NES* nes, u16 address, u8 value)
 {
+#ifdef CPU_FLAT_BUS
+    if (nes->flatBus) {
+        WriteFlatBus(nes->flatBus, address, value);
+        return;
+    }
+#endif
+
     if (ISBETWEEN(address, 0x00, 0x2000)) {
         // Memory locations $0000-$07FF are mirrored three times at $0800-$1FFF.
         // This means that, for example, any data written to $0000 will also be written to $0800, $1000 and $1800.
@@ -289,12 +311,19 @@ void WriteCPUU8(NES* nes, u16 address, u8 value)
     }
 
     if (ISBETWEEN(address, 0x6000, 0x8000)) {
-        WriteU8(&nes->cpuMemory, address, value);
+        WriteU8(&nes->sramMemory, address - CPU_SRAM_OFFSET, value);
+        nes->batteryDirty = true;
+
+        if (nes->watchTestStatus && address == CPU_SRAM_OFFSET) {
+            nes->testStatusWritten = true;
+        }
         return;
     }
 
     if (ISBETWEEN(address, 0x8000, 0x10000)) {
+        PROFILE_BEGIN(PROFILE_MAPPER);
         nes->mapperWriteU8(nes, address, value);
+        PROFILE_END(PROFILE_MAPPER);
         return;
     }
 }
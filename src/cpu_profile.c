@@ -0,0 +1,128 @@
+#include "cpu_profile.h"
+#include "cpu.h"
+#include "cpu_debug.h"
+
+typedef struct CPUProfileRank {
+    u32 index;
+    u64 cycles;
+} CPUProfileRank;
+
+CPUProfile* CreateCPUProfile(NES* nes)
+{
+    CPUProfile* profile = (CPUProfile*)Allocate(sizeof(CPUProfile));
+    if (!profile) {
+        return NULL;
+    }
+
+    memset(profile, 0, sizeof(CPUProfile));
+    profile->entryCount = CPU_PROFILE_ROM_INDEX + nes->cartridge.prgSizeInBytes;
+    profile->entries = (CPUProfileEntry*)Allocate(sizeof(CPUProfileEntry) * profile->entryCount);
+    if (!profile->entries) {
+        Free(profile);
+        return NULL;
+    }
+
+    memset(profile->entries, 0, sizeof(CPUProfileEntry) * profile->entryCount);
+
+    return profile;
+}
+
+void DestroyCPUProfile(CPUProfile* profile)
+{
+    if (profile) {
+        Free(profile->entries);
+        Free(profile);
+    }
+}
+
+internal int CompareCPUProfileRanks(const void* a, const void* b)
+{
+    u64 cyclesA = ((const CPUProfileRank*)a)->cycles;
+    u64 cyclesB = ((const CPUProfileRank*)b)->cycles;
+    return cyclesA < cyclesB ? 1 : (cyclesA > cyclesB ? -1 : 0);
+}
+
+// ROM entries are decoded from the bank they were counted in, RAM entries from what RAM holds now.
+internal void ReadCPUProfileBytes(NES* nes, u32 index, u16 address, u8 bytes[3])
+{
+    for (s32 i = 0; i < 3; i++) {
+        if (index >= CPU_PROFILE_ROM_INDEX) {
+            u32 offset = index - CPU_PROFILE_ROM_INDEX + i;
+            bytes[i] = offset < nes->cartridge.prgSizeInBytes ? nes->cartridge.prg[offset] : 0;
+        } else {
+            bytes[i] = PeekCPUU8(nes, address + i);
+        }
+    }
+}
+
+void WriteCPUProfileReport(FILE* file, NES* nes, CPUProfile* profile, s32 maxEntries)
+{
+    u64 instructions = 0;
+    u64 instructionCycles = 0;
+    u32 rankCount = 0;
+    for (u32 i = 0; i < profile->entryCount; i++) {
+        if (profile->entries[i].instructions) {
+            instructions += profile->entries[i].instructions;
+            instructionCycles += profile->entries[i].cycles;
+            rankCount++;
+        }
+    }
+
+    CPUProfileRank* ranks = (CPUProfileRank*)Allocate(sizeof(CPUProfileRank) * (rankCount ? rankCount : 1));
+    if (!ranks) {
+        return;
+    }
+
+    rankCount = 0;
+    for (u32 i = 0; i < profile->entryCount; i++) {
+        if (profile->entries[i].instructions) {
+            ranks[rankCount].index = i;
+            ranks[rankCount].cycles = profile->entries[i].cycles;
+            rankCount++;
+        }
+    }
+
+    qsort(ranks, rankCount, sizeof(CPUProfileRank), CompareCPUProfileRanks);
+
+    u64 totalCycles = instructionCycles + profile->interruptCycles + profile->stallCycles;
+    f64 percentScale = totalCycles > 0 ? 100.0 / (f64)totalCycles : 0;
+
+    fprintf(file, "# %llu instructions at %u addresses, %llu cycles", (unsigned long long)instructions, rankCount,
+            (unsigned long long)totalCycles);
+    fprintf(file, " (instructions %llu, interrupts %llu, stalls %llu)\n",
+            (unsigned long long)instructionCycles, (unsigned long long)profile->interruptCycles,
+            (unsigned long long)profile->stallCycles);
+    fprintf(file, "#       cycles       %%  instructions  cyc/ins  bank  addr   bytes     disassembly\n");
+
+    for (u32 i = 0; i < rankCount && (maxEntries <= 0 || i < (u32)maxEntries); i++) {
+        u32 index = ranks[i].index;
+        CPUProfileEntry* entry = &profile->entries[index];
+
+        u8 bytes[3];
+        ReadCPUProfileBytes(nes, index, entry->address, bytes);
+        u8 bytesCount = cpuInstructions[bytes[0]].bytesCount;
+
+        char hexBytes[10];
+        if (bytesCount == 3) {
+            snprintf(hexBytes, sizeof(hexBytes), "%02X %02X %02X", bytes[0], bytes[1], bytes[2]);
+        } else if (bytesCount == 2) {
+            snprintf(hexBytes, sizeof(hexBytes), "%02X %02X", bytes[0], bytes[1]);
+        } else {
+            snprintf(hexBytes, sizeof(hexBytes), "%02X", bytes[0]);
+        }
+
+        char disassembly[32];
+        DisassembleInstruction(bytes, entry->address, disassembly, sizeof(disassembly));
+
+        char bank[8] = "--";
+        if (index >= CPU_PROFILE_ROM_INDEX) {
+            snprintf(bank, sizeof(bank), "%02X", (index - CPU_PROFILE_ROM_INDEX) / MAPPER_PRG_WINDOW_SIZE);
+        }
+
+        fprintf(file, "%14llu  %6.2f  %12llu  %7.2f  %4s  $%04X  %-8s  %s\n", (unsigned long long)entry->cycles,
+                (f64)entry->cycles * percentScale, (unsigned long long)entry->instructions,
+                (f64)entry->cycles / (f64)entry->instructions, bank, entry->address, hexBytes, disassembly);
+    }
+
+    Free(ranks);
+}
@@ -0,0 +1,57 @@
+#ifndef CPU_PROFILE_H
+#define CPU_PROFILE_H
+
+#include "types.h"
+#include "mapper.h"
+
+/*
+ * Per instruction address profile: how many times each instruction ran and how many CPU cycles it
+ * took, including the PPU/APU work and DMA stalls it triggered. Entries live in a flat array indexed
+ * by where the code is, the CPU address below $8000 (RAM, SRAM) and the offset in the PRG rom above,
+ * so the same address in two banks is counted separately. StepCPU only touches it when nes->cpuProfile
+ * is set.
+ */
+
+#define CPU_PROFILE_ROM_INDEX 0x8000
+#define CPU_PROFILE_REPORT_LENGTH 100
+
+typedef struct CPUProfileEntry {
+    u64 instructions;
+    u64 cycles;
+    u16 address; // last CPU address the entry ran at
+} CPUProfileEntry;
+
+typedef struct CPUProfile {
+    u32 entryCount;
+    CPUProfileEntry* entries;
+
+    // cycles not spent in instructions
+    u64 interruptCycles;
+    u64 stallCycles;
+} CPUProfile;
+
+CPUProfile* CreateCPUProfile(NES* nes);
+void DestroyCPUProfile(CPUProfile* profile);
+
+static inline u32 GetCPUProfileIndex(NES* nes, u16 address)
+{
+    if (address < CPU_PROFILE_ROM_INDEX) {
+        return address;
+    }
+
+    u32 window = (address >> 14) & 1;
+    return CPU_PROFILE_ROM_INDEX + nes->prgBankOffsets[window] + (address & (MAPPER_PRG_WINDOW_SIZE - 1));
+}
+
+static inline void RecordCPUProfile(CPUProfile* profile, u32 index, u16 address, u64 cycles)
+{
+    CPUProfileEntry* entry = &profile->entries[index];
+    entry->instructions++;
+    entry->cycles += cycles;
+    entry->address = address;
+}
+
+// Writes the entries that took the most cycles, hottest first, with their disassembly.
+void WriteCPUProfileReport(FILE* file, NES* nes, CPUProfile* profile, s32 maxEntries);
+
+#endif // CPU_PROFILE_H
@@ -0,0 +1,596 @@
+/*
+ * CPU test runner: runs single instruction tests in the SingleStepTests/ProcessorTests JSON format
+ * (one file per opcode, thousands of cases each) against the CPU on a flat 64 KB bus, comparing the
+ * registers, the memory and every bus cycle. Files are memory mapped and parsed as they are run, one
+ * file per job on the thread pool, so the whole suite doesn't have to fit in memory.
+ *
+ * Each case looks like:
+ *   {"name": "a9 10 3c", "initial": {"pc": 1000, "s": 253, "a": 0, "x": 0, "y": 0, "p": 36,
+ *    "ram": [[1000, 169], [1001, 16]]}, "final": {...}, "cycles": [[1000, 169, "read"], ...]}
+ * Unknown keys are ignored. Arguments ending in .json are test files, anything else is a text file
+ * listing one test file per line. Cases for the KIL opcodes are skipped, they halt the CPU.
+ *
+ * usage: cputest [--jobs N] [--verbose] tests.json... | list.txt
+ */
+
+#define CPU_FLAT_BUS
+#include "core.c"
+
+#define CPU_TEST_MAX_RAM 64
+#define CPU_TEST_MAX_FILES 1024
+#define CPU_TEST_NAME_LENGTH 64
+#define CPU_TEST_MESSAGE_LENGTH 256
+
+#define shift_args(argc, argv) (ASSERT(*(argc) > 0), (*(argc))--, *(*(argv))++)
+
+typedef struct CPUTestMemory {
+    u16 address;
+    u8 value;
+} CPUTestMemory;
+
+typedef struct CPUTestState {
+    u16 pc;
+    u8 s, a, x, y, p;
+    s32 ramCount;
+    CPUTestMemory ram[CPU_TEST_MAX_RAM];
+} CPUTestState;
+
+typedef struct CPUTestCase {
+    char name[CPU_TEST_NAME_LENGTH];
+    CPUTestState initial;
+    CPUTestState final;
+    s32 cycleCount;
+    CPUBusCycle cycles[CPU_FLAT_BUS_MAX_CYCLES];
+} CPUTestCase;
+
+typedef struct CPUTestFile {
+    const char* path;
+    u64 passed;
+    u64 failed;
+    u64 skipped;
+    bool error;
+    char message[CPU_TEST_MESSAGE_LENGTH]; // first failure
+} CPUTestFile;
+
+typedef struct CPUTestWorker {
+    NES* nes;
+    CPUFlatBus* bus;
+} CPUTestWorker;
+
+typedef struct CPUTestSuite {
+    CPUTestFile* files;
+    CPUTestWorker* workers;
+} CPUTestSuite;
+
+// Just enough JSON for the test files: objects, arrays, numbers and strings without unicode escapes.
+typedef struct JSONReader {
+    const char* at;
+    const char* end;
+    bool failed;
+} JSONReader;
+
+internal void SkipJSONWhitespace(JSONReader* reader)
+{
+    while (reader->at < reader->end &&
+           (*reader->at == ' ' || *reader->at == '\t' || *reader->at == '\n' || *reader->at == '\r')) {
+        reader->at++;
+    }
+}
+
+// Consumes c if it's the next character.
+internal bool ConsumeJSON(JSONReader* reader, char c)
+{
+    SkipJSONWhitespace(reader);
+    if (reader->at < reader->end && *reader->at == c) {
+        reader->at++;
+        return true;
+    }
+    return false;
+}
+
+internal void ExpectJSON(JSONReader* reader, char c)
+{
+    if (!ConsumeJSON(reader, c)) {
+        reader->failed = true;
+    }
+}
+
+internal s64 ReadJSONNumber(JSONReader* reader)
+{
+    SkipJSONWhitespace(reader);
+
+    bool negative = reader->at < reader->end && *reader->at == '-';
+    if (negative) {
+        reader->at++;
+    }
+
+    const char* start = reader->at;
+    s64 value = 0;
+    while (reader->at < reader->end && *reader->at >= '0' && *reader->at <= '9') {
+        value = value * 10 + (*reader->at - '0');
+        reader->at++;
+    }
+
+    if (reader->at == start) {
+        reader->failed = true;
+    }
+    return negative ? -value : value;
+}
+
+// Copies the string into buffer, truncated to bufferSize, escapes are kept as they are.
+internal void ReadJSONString(JSONReader* reader, char* buffer, size bufferSize)
+{
+    if (!ConsumeJSON(reader, '"')) {
+        reader->failed = true;
+        return;
+    }
+
+    size length = 0;
+    while (reader->at < reader->end && *reader->at != '"') {
+        if (*reader->at == '\\' && reader->at + 1 < reader->end) {
+            if (length + 1 < bufferSize) {
+                buffer[length++] = *reader->at;
+            }
+            reader->at++;
+        }
+        if (length + 1 < bufferSize) {
+            buffer[length++] = *reader->at;
+        }
+        reader->at++;
+    }
+
+    if (bufferSize > 0) {
+        buffer[length] = 0;
+    }
+
+    if (reader->at >= reader->end) {
+        reader->failed = true;
+        return;
+    }
+    reader->at++;
+}
+
+internal void SkipJSONValue(JSONReader* reader)
+{
+    SkipJSONWhitespace(reader);
+    if (reader->at >= reader->end) {
+        reader->failed = true;
+        return;
+    }
+
+    char c = *reader->at;
+    if (c == '"') {
+        char ignored[1];
+        ReadJSONString(reader, ignored, sizeof(ignored));
+    } else if (c == '{' || c == '[') {
+        char close = c == '{' ? '}' : ']';
+        reader->at++;
+        if (ConsumeJSON(reader, close)) {
+            return;
+        }
+
+        do {
+            if (c == '{') {
+                char ignored[1];
+                ReadJSONString(reader, ignored, sizeof(ignored));
+                ExpectJSON(reader, ':');
+            }
+            SkipJSONValue(reader);
+        } while (!reader->failed && ConsumeJSON(reader, ','));
+
+        ExpectJSON(reader, close);
+    } else {
+        // numbers, true, false and null
+        while (reader->at < reader->end && *reader->at != ',' && *reader->at != '}' && *reader->at != ']' &&
+               *reader->at != ' ' && *reader->at != '\n' && *reader->at != '\r' && *reader->at != '\t') {
+            reader->at++;
+        }
+    }
+}
+
+internal void ReadCPUTestRAM(JSONReader* reader, CPUTestState* state)
+{
+    state->ramCount = 0;
+
+    ExpectJSON(reader, '[');
+    if (ConsumeJSON(reader, ']')) {
+        return;
+    }
+
+    do {
+        ExpectJSON(reader, '[');
+        s64 address = ReadJSONNumber(reader);
+        ExpectJSON(reader, ',');
+        s64 value = ReadJSONNumber(reader);
+        ExpectJSON(reader, ']');
+
+        if (state->ramCount == CPU_TEST_MAX_RAM) {
+            reader->failed = true;
+            return;
+        }
+
+        state->ram[state->ramCount].address = (u16)address;
+        state->ram[state->ramCount].value = (u8)value;
+        state->ramCount++;
+    } while (!reader->failed && ConsumeJSON(reader, ','));
+
+    ExpectJSON(reader, ']');
+}
+
+internal void ReadCPUTestState(JSONReader* reader, CPUTestState* state)
+{
+    memset(state, 0, sizeof(CPUTestState));
+
+    ExpectJSON(reader, '{');
+    if (ConsumeJSON(reader, '}')) {
+        return;
+    }
+
+    do {
+        char key[8];
+        ReadJSONString(reader, key, sizeof(key));
+        ExpectJSON(reader, ':');
+
+        if (strcmp(key, "pc") == 0) {
+            state->pc = (u16)ReadJSONNumber(reader);
+        } else if (strcmp(key, "s") == 0) {
+            state->s = (u8)ReadJSONNumber(reader);
+        } else if (strcmp(key, "a") == 0) {
+            state->a = (u8)ReadJSONNumber(reader);
+        } else if (strcmp(key, "x") == 0) {
+            state->x = (u8)ReadJSONNumber(reader);
+        } else if (strcmp(key, "y") == 0) {
+            state->y = (u8)ReadJSONNumber(reader);
+        } else if (strcmp(key, "p") == 0) {
+            state->p = (u8)ReadJSONNumber(reader);
+        } else if (strcmp(key, "ram") == 0) {
+            ReadCPUTestRAM(reader, state);
+        } else {
+            SkipJSONValue(reader);
+        }
+    } while (!reader->failed && ConsumeJSON(reader, ','));
+
+    ExpectJSON(reader, '}');
+}
+
+internal void ReadCPUTestCycles(JSONReader* reader, CPUTestCase* test)
+{
+    test->cycleCount = 0;
+
+    ExpectJSON(reader, '[');
+    if (ConsumeJSON(reader, ']')) {
+        return;
+    }
+
+    do {
+        ExpectJSON(reader, '[');
+        s64 address = ReadJSONNumber(reader);
+        ExpectJSON(reader, ',');
+        s64 value = ReadJSONNumber(reader);
+        ExpectJSON(reader, ',');
+        char type[8];
+        ReadJSONString(reader, type, sizeof(type));
+        ExpectJSON(reader, ']');
+
+        if (test->cycleCount == CPU_FLAT_BUS_MAX_CYCLES) {
+            reader->failed = true;
+            return;
+        }
+
+        CPUBusCycle* cycle = &test->cycles[test->cycleCount++];
+        cycle->address = (u16)address;
+        cycle->value = (u8)value;
+        cycle->write = strcmp(type, "write") == 0;
+    } while (!reader->failed && ConsumeJSON(reader, ','));
+
+    ExpectJSON(reader, ']');
+}
+
+// Reads the next case of the top level array, returns false at the end of it or on an error.
+internal bool ReadCPUTestCase(JSONReader* reader, CPUTestCase* test, bool first)
+{
+    if (ConsumeJSON(reader, ']')) {
+        return false;
+    }
+
+    if (!first) {
+        ExpectJSON(reader, ',');
+    }
+
+    memset(test->name, 0, sizeof(test->name));
+    test->cycleCount = 0;
+
+    ExpectJSON(reader, '{');
+    if (!ConsumeJSON(reader, '}')) {
+        do {
+            char key[16];
+            ReadJSONString(reader, key, sizeof(key));
+            ExpectJSON(reader, ':');
+
+            if (strcmp(key, "name") == 0) {
+                ReadJSONString(reader, test->name, sizeof(test->name));
+            } else if (strcmp(key, "initial") == 0) {
+                ReadCPUTestState(reader, &test->initial);
+            } else if (strcmp(key, "final") == 0) {
+                ReadCPUTestState(reader, &test->final);
+            } else if (strcmp(key, "cycles") == 0) {
+                ReadCPUTestCycles(reader, test);
+            } else {
+                SkipJSONValue(reader);
+            }
+        } while (!reader->failed && ConsumeJSON(reader, ','));
+
+        ExpectJSON(reader, '}');
+    }
+
+    return !reader->failed;
+}
+
+internal bool CompareCPUTestRegister(const char* name, u32 expected, u32 actual, char* message)
+{
+    if (expected != actual) {
+        snprintf(message, CPU_TEST_MESSAGE_LENGTH, "%s: expected $%02X, got $%02X", name, expected, actual);
+        return false;
+    }
+    return true;
+}
+
+// Runs one case and leaves the memory it touched cleared for the next one.
+internal bool RunCPUTestCase(CPUTestWorker* worker, CPUTestCase* test, char* message)
+{
+    NES* nes = worker->nes;
+    CPUFlatBus* bus = worker->bus;
+    CPU* cpu = &nes->cpu;
+
+    for (s32 i = 0; i < test->initial.ramCount; i++) {
+        bus->memory[test->initial.ram[i].address] = test->initial.ram[i].value;
+    }
+
+    cpu->pc = test->initial.pc;
+    cpu->sp = test->initial.s;
+    cpu->a = test->initial.a;
+    cpu->x = test->initial.x;
+    cpu->y = test->initial.y;
+    cpu->p = test->initial.p;
+    cpu->cycles = 0;
+    cpu->waitCycles = 0;
+    cpu->pendingService = CPU_INTERRUPT_NON;
+    cpu->nmiLine = false;
+    cpu->prevNmiLine = false;
+    cpu->nmiPending = false;
+    cpu->irqSources = 0;
+    cpu->irqPollIOverrideValid = false;
+    cpu->irqPollIOverride = false;
+    bus->cycleCount = 0;
+
+    StepCPU(nes);
+
+    bool passed = CompareCPUTestRegister("pc", test->final.pc, cpu->pc, message) &&
+                  CompareCPUTestRegister("s", test->final.s, cpu->sp, message) &&
+                  CompareCPUTestRegister("a", test->final.a, cpu->a, message) &&
+                  CompareCPUTestRegister("x", test->final.x, cpu->x, message) &&
+                  CompareCPUTestRegister("y", test->final.y, cpu->y, message) &&
+                  CompareCPUTestRegister("p", test->final.p, cpu->p, message);
+
+    for (s32 i = 0; passed && i < test->final.ramCount; i++) {
+        CPUTestMemory* expected = &test->final.ram[i];
+        u8 actual = bus->memory[expected->address];
+        if (actual != expected->value) {
+            snprintf(message, CPU_TEST_MESSAGE_LENGTH, "ram $%04X: expected $%02X, got $%02X", expected->address,
+                     expected->value, actual);
+            passed = false;
+        }
+    }
+
+    if (passed && bus->cycleCount != test->cycleCount) {
+        snprintf(message, CPU_TEST_MESSAGE_LENGTH, "expected %d bus cycles, got %d", test->cycleCount,
+                 bus->cycleCount);
+        passed = false;
+    }
+
+    for (s32 i = 0; passed && i < test->cycleCount; i++) {
+        CPUBusCycle* expected = &test->cycles[i];
+        CPUBusCycle* actual = &bus->cycles[i];
+        if (actual->address != expected->address || actual->value != expected->value ||
+            actual->write != expected->write) {
+            snprintf(message, CPU_TEST_MESSAGE_LENGTH, "cycle %d: expected %s $%04X $%02X, got %s $%04X $%02X", i + 1,
+                     expected->write ? "write" : "read", expected->address, expected->value,
+                     actual->write ? "write" : "read", actual->address, actual->value);
+            passed = false;
+        }
+    }
+
+    // everything a case writes shows up in its bus cycles
+    for (s32 i = 0; i < test->initial.ramCount; i++) {
+        bus->memory[test->initial.ram[i].address] = 0;
+    }
+    for (s32 i = 0; i < bus->cycleCount && i < CPU_FLAT_BUS_MAX_CYCLES; i++) {
+        bus->memory[bus->cycles[i].address] = 0;
+    }
+
+    return passed;
+}
+
+internal void RunCPUTestFile(void* data, s32 job, s32 worker)
+{
+    CPUTestSuite* suite = (CPUTestSuite*)data;
+    CPUTestFile* file = &suite->files[job];
+
+    MappedFile mappedFile;
+    if (!MapFile(&mappedFile, file->path, 0, false)) {
+        snprintf(file->message, CPU_TEST_MESSAGE_LENGTH, "could not open the file");
+        file->error = true;
+        return;
+    }
+
+    JSONReader reader = {(const char*)mappedFile.data, (const char*)mappedFile.data + mappedFile.size, false};
+    ExpectJSON(&reader, '[');
+
+    CPUTestCase test;
+    char message[CPU_TEST_MESSAGE_LENGTH];
+
+    for (bool first = true; ReadCPUTestCase(&reader, &test, first); first = false) {
+        u8 opcode = 0;
+        for (s32 i = 0; i < test.initial.ramCount; i++) {
+            if (test.initial.ram[i].address == test.initial.pc) {
+                opcode = test.initial.ram[i].value;
+            }
+        }
+
+        if (cpuInstructions[opcode].mnemonic == CPU_KIL) {
+            file->skipped++;
+            continue;
+        }
+
+        if (RunCPUTestCase(&suite->workers[worker], &test, message)) {
+            file->passed++;
+        } else {
+            if (!file->failed) {
+                snprintf(file->message, CPU_TEST_MESSAGE_LENGTH, "%.63s: %.180s", test.name, message);
+            }
+            file->failed++;
+        }
+    }
+
+    if (reader.failed) {
+        size offset = (size)(reader.at - (const char*)mappedFile.data);
+        snprintf(file->message, CPU_TEST_MESSAGE_LENGTH, "malformed test file near offset %llu",
+                 (unsigned long long)offset);
+        file->error = true;
+    }
+
+    UnmapFile(&mappedFile);
+}
+
+internal bool IsJSONFile(const char* path)
+{
+    size length = strlen(path);
+    return length >= 5 && strcmp(path + length - 5, ".json") == 0;
+}
+
+// The smallest cartridge CreateNES takes, the flat bus replaces its memory anyway.
+internal NES* CreateCPUTestNES(void)
+{
+    local u8 rom[HEADER_SIZE + CPU_PRG_BANK_SIZE + CHR_BANK_SIZE] = {'N', 'E', 'S', 0x1A, 1, 1};
+
+    Cartridge cartridge = {0};
+    if (!LoadNesRomFromMemory(rom, sizeof(rom), &cartridge)) {
+        return NULL;
+    }
+
+    return CreateNES(cartridge);
+}
+
+int main(int argc, char** argv)
+{
+    s32 jobCount = 0;
+    bool verbose = false;
+    s32 fileCount = 0;
+    char** paths = (char**)Allocate(sizeof(char*) * CPU_TEST_MAX_FILES);
+
+    const char* program = shift_args(&argc, &argv);
+    (void)program;
+
+    while (argc > 0) {
+        char* flag = shift_args(&argc, &argv);
+        if (strcmp(flag, "--jobs") == 0 && argc > 0) {
+            jobCount = atoi(shift_args(&argc, &argv));
+        } else if (strcmp(flag, "--verbose") == 0) {
+            verbose = true;
+        } else if (IsJSONFile(flag)) {
+            if (fileCount == CPU_TEST_MAX_FILES) {
+                fprintf(stderr, "Error: More than %d test files\n", CPU_TEST_MAX_FILES);
+                return 1;
+            }
+            paths[fileCount++] = flag;
+        } else if (flag[0] != '-') {
+            char** listPaths = NULL;
+            s32 listCount = ReadPathList(flag, &listPaths);
+            if (listCount < 0) {
+                fprintf(stderr, "Error: Could not read the test list: %s\n", flag);
+                return 1;
+            }
+            if (listCount > CPU_TEST_MAX_FILES - fileCount) {
+                fprintf(stderr, "Error: More than %d test files\n", CPU_TEST_MAX_FILES);
+                FreePathList(listPaths, listCount);
+                return 1;
+            }
+
+            // the paths now own the entries, only the list itself goes
+            for (s32 i = 0; i < listCount; i++) {
+                paths[fileCount++] = listPaths[i];
+            }
+            Free(listPaths);
+        } else {
+            fileCount = 0;
+            break;
+        }
+    }
+
+    if (fileCount == 0) {
+        fprintf(stderr, "usage: cputest [--jobs N] [--verbose] tests.json... | list.txt\n");
+        return 1;
+    }
+
+    ThreadPool* pool = CreateThreadPool(jobCount);
+    if (!pool) {
+        fprintf(stderr, "Error: Could not start the worker threads\n");
+        return 1;
+    }
+
+    CPUTestSuite suite;
+    suite.files = (CPUTestFile*)Allocate(sizeof(CPUTestFile) * fileCount);
+    suite.workers = (CPUTestWorker*)Allocate(sizeof(CPUTestWorker) * pool->workerCount);
+    memset(suite.files, 0, sizeof(CPUTestFile) * fileCount);
+
+    for (s32 i = 0; i < fileCount; i++) {
+        suite.files[i].path = paths[i];
+    }
+
+    for (s32 i = 0; i < pool->workerCount; i++) {
+        CPUTestWorker* worker = &suite.workers[i];
+        worker->nes = CreateCPUTestNES();
+        worker->bus = (CPUFlatBus*)Allocate(sizeof(CPUFlatBus));
+        if (!worker->nes || !worker->bus) {
+            fprintf(stderr, "Error: Could not create the test CPUs\n");
+            return 1;
+        }
+
+        memset(worker->bus, 0, sizeof(CPUFlatBus));
+        worker->nes->flatBus = worker->bus;
+    }
+
+    u64 startTicks = GetTimerTicks();
+    RunJobs(pool, RunCPUTestFile, &suite, fileCount);
+    f64 wallSeconds = (f64)(GetTimerTicks() - startTicks) / (f64)GetTimerFrequency();
+
+    u64 passed = 0;
+    u64 failed = 0;
+    u64 skipped = 0;
+    s32 errors = 0;
+
+    for (s32 i = 0; i < fileCount; i++) {
+        CPUTestFile* file = &suite.files[i];
+        passed += file->passed;
+        failed += file->failed;
+        skipped += file->skipped;
+        errors += file->error ? 1 : 0;
+
+        if (file->error) {
+            printf("%s: error, %s\n", file->path, file->message);
+        } else if (file->failed) {
+            printf("%s: %llu of %llu failed, first %s\n", file->path, (unsigned long long)file->failed,
+                   (unsigned long long)(file->passed + file->failed), file->message);
+        } else if (verbose) {
+            printf("%s: %llu passed\n", file->path, (unsigned long long)file->passed);
+        }
+    }
+
+    u64 total = passed + failed;
+    printf("%llu of %llu cases passed, %llu skipped, %d files with errors, %.2f s (%.0f cases/s, %d workers)\n",
+           (unsigned long long)passed, (unsigned long long)total, (unsigned long long)skipped, errors, wallSeconds,
+           wallSeconds > 0 ? (f64)total / wallSeconds : 0, pool->workerCount);
+
+    DestroyThreadPool(pool);
+    return failed == 0 && errors == 0 ? 0 : 1;
+}
@@ -12,41 +12,99 @@ internal inline bool IsUnofficialOpcode(u8 opcode)
     return false;
 }
 
-void LogCPUState(NES* nes, FILE* logFile)
+void CaptureCPUTraceRecord(NES* nes, CPUTraceRecord* record)
 {
     CPU* cpu = &nes->cpu;
     u16 pc = cpu->pc;
+
+    record->cycle = cpu->cycles;
+    record->pc = pc;
+    record->scanline = (s16)nes->ppu.scanline;
+    record->dot = (u16)nes->ppu.cycle;
+    record->a = cpu->a;
+    record->x = cpu->x;
+    record->y = cpu->y;
+    record->p = cpu->p;
+    record->sp = cpu->sp;
+    record->indirect = 0;
+    record->value = 0;
+
     u8 opcode = PeekCPUU8(nes, pc);
     CPUInstruction* inst = &cpuInstructions[opcode];
+    record->bytes[0] = opcode;
+    record->bytes[1] = inst->bytesCount >= 2 ? PeekCPUU8(nes, pc + 1) : 0;
+    record->bytes[2] = inst->bytesCount >= 3 ? PeekCPUU8(nes, pc + 2) : 0;
+
+    u8 op1 = record->bytes[1];
+    u16 address = (record->bytes[2] << 8) | op1;
+    switch (inst->addressingMode) {
+        case AM_ZPA:
+            record->value = PeekCPUU8(nes, op1);
+            break;
+        case AM_ZPX:
+            record->value = PeekCPUU8(nes, (u8)(op1 + cpu->x));
+            break;
+        case AM_ZPY:
+            record->value = PeekCPUU8(nes, (u8)(op1 + cpu->y));
+            break;
+        case AM_ABS:
+            if (inst->mnemonic != CPU_JMP && inst->mnemonic != CPU_JSR) {
+                record->value = PeekCPUU8(nes, address);
+            }
+            break;
+        case AM_ABX:
+            record->value = PeekCPUU8(nes, (u16)(address + cpu->x));
+            break;
+        case AM_ABY:
+            record->value = PeekCPUU8(nes, (u16)(address + cpu->y));
+            break;
+        case AM_IND:
+            // the pointer doesn't cross pages, JMP ($xxFF) reads the high byte from $xx00
+            if (op1 == 0xFF) {
+                record->indirect = (PeekCPUU8(nes, address & 0xFF00) << 8) | PeekCPUU8(nes, address);
+            } else {
+                record->indirect = (PeekCPUU8(nes, address + 1) << 8) | PeekCPUU8(nes, address);
+            }
+            break;
+        case AM_IZX: {
+            u8 ptrX = (u8)(op1 + cpu->x);
+            record->indirect = (PeekCPUU8(nes, (u8)(ptrX + 1)) << 8) | PeekCPUU8(nes, ptrX);
+            record->value = PeekCPUU8(nes, record->indirect);
+            break;
+        }
+        case AM_IZY:
+            record->indirect = (PeekCPUU8(nes, (u8)(op1 + 1)) << 8) | PeekCPUU8(nes, op1);
+            record->value = PeekCPUU8(nes, (u16)(record->indirect + cpu->y));
+            break;
+        default:
+            break;
+    }
+}
+
+s32 FormatCPUTraceRecord(CPUTraceRecord* record, char* buffer, size bufferSize)
+{
+    u16 pc = record->pc;
+    u8 opcode = record->bytes[0];
+    CPUInstruction* inst = &cpuInstructions[opcode];
 
     char hexBytes[10] = {0};
     if (inst->bytesCount == 1) {
         snprintf(hexBytes, sizeof(hexBytes), "%02X      ", opcode);
     } else if (inst->bytesCount == 2) {
-        u8 op1 = PeekCPUU8(nes, pc + 1);
-        snprintf(hexBytes, sizeof(hexBytes), "%02X %02X   ", opcode, op1);
+        snprintf(hexBytes, sizeof(hexBytes), "%02X %02X   ", opcode, record->bytes[1]);
     } else if (inst->bytesCount == 3) {
-        u8 op1 = PeekCPUU8(nes, pc + 1);
-        u8 op2 = PeekCPUU8(nes, pc + 2);
-        snprintf(hexBytes, sizeof(hexBytes), "%02X %02X %02X", opcode, op1, op2);
+        snprintf(hexBytes, sizeof(hexBytes), "%02X %02X %02X", opcode, record->bytes[1], record->bytes[2]);
     } else {
         snprintf(hexBytes, sizeof(hexBytes), "%02X      ", opcode);
     }
 
     const char* mnemonic = GetInstructionStr(inst->mnemonic);
-    char prefix[2] = {0};
-    if (IsUnofficialOpcode(opcode)) {
-        prefix[0] = '*';
-        prefix[1] = '\0';
-    } else {
-        prefix[0] = ' ';
-        prefix[1] = '\0';
-    }
+    const char* prefix = IsUnofficialOpcode(opcode) ? "*" : " ";
 
     char asmStr[32] = {0};
-    u16 address;
-    u8 op1, op2;
-    u8 val1;
+    u8 op1 = record->bytes[1];
+    u8 val1 = record->value;
+    u16 address = (record->bytes[2] << 8) | op1;
     switch (inst->addressingMode) {
         case AM_IMP:
         case AM_NON:
@@ -56,83 +114,47 @@ void LogCPUState(NES* nes, FILE* logFile)
             snprintf(asmStr, sizeof(asmStr), "%s%s A", prefix, mnemonic);
             break;
         case AM_IMM:
-            op1 = PeekCPUU8(nes, pc + 1);
             snprintf(asmStr, sizeof(asmStr), "%s%s #$%02X", prefix, mnemonic, op1);
             break;
         case AM_ZPA:
-            op1 = PeekCPUU8(nes, pc + 1);
-            val1 = PeekCPUU8(nes, op1);
             snprintf(asmStr, sizeof(asmStr), "%s%s $%02X = %02X", prefix, mnemonic, op1, val1);
             break;
         case AM_ZPX:
-            op1 = PeekCPUU8(nes, pc + 1);
-            address = (u8)(op1 + cpu->x);
-            val1 = PeekCPUU8(nes, address);
-            snprintf(asmStr, sizeof(asmStr), "%s%s $%02X,X @ %02X = %02X", prefix, mnemonic, op1, address, val1);
+            snprintf(asmStr, sizeof(asmStr), "%s%s $%02X,X @ %02X = %02X", prefix, mnemonic, op1,
+                     (u8)(op1 + record->x), val1);
             break;
         case AM_ZPY:
-            op1 = PeekCPUU8(nes, pc + 1);
-            address = (u8)(op1 + cpu->y);
-            val1 = PeekCPUU8(nes, address);
-            snprintf(asmStr, sizeof(asmStr), "%s%s $%02X,Y @ %02X = %02X", prefix, mnemonic, op1, address, val1);
+            snprintf(asmStr, sizeof(asmStr), "%s%s $%02X,Y @ %02X = %02X", prefix, mnemonic, op1,
+                     (u8)(op1 + record->y), val1);
             break;
         case AM_ABS:
-            op1 = PeekCPUU8(nes, pc + 1);
-            op2 = PeekCPUU8(nes, pc + 2);
-            address = (op2 << 8) | op1;
             if (inst->mnemonic == CPU_JMP || inst->mnemonic == CPU_JSR) {
                 snprintf(asmStr, sizeof(asmStr), "%s%s $%04X", prefix, mnemonic, address);
             } else {
-                val1 = PeekCPUU8(nes, address);
                 snprintf(asmStr, sizeof(asmStr), "%s%s $%04X = %02X", prefix, mnemonic, address, val1);
             }
             break;
         case AM_ABX:
-            op1 = PeekCPUU8(nes, pc + 1);
-            op2 = PeekCPUU8(nes, pc + 2);
-            address = (op2 << 8) | op1;
-            u16 resolvedX = address + cpu->x;
-            val1 = PeekCPUU8(nes, resolvedX);
-            snprintf(asmStr, sizeof(asmStr), "%s%s $%04X,X @ %04X = %02X", prefix, mnemonic, address, resolvedX, val1);
+            snprintf(asmStr, sizeof(asmStr), "%s%s $%04X,X @ %04X = %02X", prefix, mnemonic, address,
+                     (u16)(address + record->x), val1);
             break;
         case AM_ABY:
-            op1 = PeekCPUU8(nes, pc + 1);
-            op2 = PeekCPUU8(nes, pc + 2);
-            address = (op2 << 8) | op1;
-            u16 resolvedY = address + cpu->y;
-            val1 = PeekCPUU8(nes, resolvedY);
-            snprintf(asmStr, sizeof(asmStr), "%s%s $%04X,Y @ %04X = %02X", prefix, mnemonic, address, resolvedY, val1);
+            snprintf(asmStr, sizeof(asmStr), "%s%s $%04X,Y @ %04X = %02X", prefix, mnemonic, address,
+                     (u16)(address + record->y), val1);
             break;
         case AM_IND:
-            op1 = PeekCPUU8(nes, pc + 1);
-            op2 = PeekCPUU8(nes, pc + 2);
-            address = (op2 << 8) | op1;
-            u16 jmpAddr;
-            if (op1 == 0xFF) {
-                jmpAddr = (PeekCPUU8(nes, address & 0xFF00) << 8) | PeekCPUU8(nes, address);
-            } else {
-                jmpAddr = (PeekCPUU8(nes, address + 1) << 8) | PeekCPUU8(nes, address);
-            }
-            snprintf(asmStr, sizeof(asmStr), "%s%s ($%04X) = %04X", prefix, mnemonic, address, jmpAddr);
+            snprintf(asmStr, sizeof(asmStr), "%s%s ($%04X) = %04X", prefix, mnemonic, address, record->indirect);
             break;
         case AM_IZX:
-            op1 = PeekCPUU8(nes, pc + 1);
-            u8 ptrX = (u8)(op1 + cpu->x);
-            address = (PeekCPUU8(nes, (u8)(ptrX + 1)) << 8) | PeekCPUU8(nes, ptrX);
-            val1 = PeekCPUU8(nes, address);
-            snprintf(asmStr, sizeof(asmStr), "%s%s ($%02X,X) @ %02X = %04X = %02X", prefix, mnemonic, op1, ptrX, address, val1);
+            snprintf(asmStr, sizeof(asmStr), "%s%s ($%02X,X) @ %02X = %04X = %02X", prefix, mnemonic, op1,
+                     (u8)(op1 + record->x), record->indirect, val1);
             break;
         case AM_IZY:
-            op1 = PeekCPUU8(nes, pc + 1);
-            u16 ptrY = (PeekCPUU8(nes, (u8)(op1 + 1)) << 8) | PeekCPUU8(nes, op1);
-            address = ptrY + cpu->y;
-            val1 = PeekCPUU8(nes, address);
-            snprintf(asmStr, sizeof(asmStr), "%s%s ($%02X),Y = %04X @ %04X = %02X", prefix, mnemonic, op1, ptrY, address, val1);
+            snprintf(asmStr, sizeof(asmStr), "%s%s ($%02X),Y = %04X @ %04X = %02X", prefix, mnemonic, op1,
+                     record->indirect, (u16)(record->indirect + record->y), val1);
             break;
         case AM_REL:
-            op1 = PeekCPUU8(nes, pc + 1);
-            address = pc + 2 + (s8)op1;
-            snprintf(asmStr, sizeof(asmStr), "%s%s $%04X", prefix, mnemonic, address);
+            snprintf(asmStr, sizeof(asmStr), "%s%s $%04X", prefix, mnemonic, (u16)(pc + 2 + (s8)op1));
             break;
         default:
             snprintf(asmStr, sizeof(asmStr), "%s%s", prefix, mnemonic);
@@ -142,6 +164,352 @@ void LogCPUState(NES* nes, FILE* logFile)
     char leftSide[64];
     snprintf(leftSide, sizeof(leftSide), "%04X  %s %s", pc, hexBytes, asmStr);
 
-    fprintf(logFile, "%-47s A:%02X X:%02X Y:%02X P:%02X SP:%02X PPU:%3d,%3d CYC:%llu\n", leftSide, cpu->a, cpu->x,
-            cpu->y, cpu->p, cpu->sp, nes->ppu.scanline, nes->ppu.cycle, cpu->cycles);
+    return snprintf(buffer, bufferSize, "%-47s A:%02X X:%02X Y:%02X P:%02X SP:%02X PPU:%3d,%3d CYC:%llu\n", leftSide,
+                    record->a, record->x, record->y, record->p, record->sp, record->scanline, record->dot,
+                    (unsigned long long)record->cycle);
+}
+
+void LogCPUState(NES* nes, FILE* logFile)
+{
+    CPUTraceRecord record;
+    CaptureCPUTraceRecord(nes, &record);
+
+    char line[CPU_TRACE_LINE_LENGTH];
+    FormatCPUTraceRecord(&record, line, sizeof(line));
+    fputs(line, logFile);
+}
+
+internal bool WriteCPUTraceHeader(FILE* file)
+{
+    CPUTraceFileHeader header = {0};
+    header.magic = CPU_TRACE_MAGIC;
+    header.version = CPU_TRACE_VERSION;
+    header.recordSize = sizeof(CPUTraceRecord);
+    return fwrite(&header, sizeof(header), 1, file) == 1;
+}
+
+// Writes count records starting at the absolute record index first, the ring wraps at most once.
+internal void WriteCPUTraceRecords(CPUTrace* trace, FILE* file, u64 first, u64 count)
+{
+    u32 start = (u32)(first & (trace->capacity - 1));
+    u32 head = (u32)MIN((u64)(trace->capacity - start), count);
+    fwrite(trace->records + start, sizeof(CPUTraceRecord), head, file);
+    fwrite(trace->records, sizeof(CPUTraceRecord), (size)(count - head), file);
+}
+
+internal u32 RoundCPUTraceCapacity(u32 capacity)
+{
+    u32 roundedCapacity = 1;
+    while (roundedCapacity < capacity) {
+        roundedCapacity <<= 1;
+    }
+    return roundedCapacity;
+}
+
+CPUTrace* CreateCPUTrace(u32 capacity, const char* path)
+{
+    u32 roundedCapacity = RoundCPUTraceCapacity(capacity);
+
+    CPUTrace* trace = (CPUTrace*)Allocate(sizeof(CPUTrace));
+    if (!trace) {
+        return NULL;
+    }
+
+    memset(trace, 0, sizeof(CPUTrace));
+    trace->capacity = roundedCapacity;
+    trace->records = (CPUTraceRecord*)AllocateAligned(sizeof(CPUTraceRecord) * roundedCapacity, CACHE_LINE_SIZE);
+    if (!trace->records) {
+        Free(trace);
+        return NULL;
+    }
+
+    if (path) {
+        trace->file = fopen(path, "wb");
+        if (!trace->file || !WriteCPUTraceHeader(trace->file)) {
+            if (trace->file) fclose(trace->file);
+            FreeAligned(trace->records);
+            Free(trace);
+            return NULL;
+        }
+    }
+
+    return trace;
+}
+
+CPUTrace* CreateCPUTraceRing(u32 capacity, const char* path)
+{
+    u32 roundedCapacity = RoundCPUTraceCapacity(capacity);
+
+    CPUTrace* trace = (CPUTrace*)Allocate(sizeof(CPUTrace));
+    if (!trace) {
+        return NULL;
+    }
+
+    memset(trace, 0, sizeof(CPUTrace));
+    trace->capacity = roundedCapacity;
+
+    // truncate first, MapFile only grows the file and the ring is smaller than an old full trace
+    FILE* file = fopen(path, "wb");
+    if (file) {
+        fclose(file);
+    }
+
+    u64 fileSize = sizeof(CPUTraceFileHeader) + (u64)sizeof(CPUTraceRecord) * roundedCapacity;
+    if (!MapFile(&trace->mapping, path, fileSize, true)) {
+        Free(trace);
+        return NULL;
+    }
+
+    // the mapping is page aligned and the header is a record long, so the records stay aligned too
+    trace->header = (CPUTraceFileHeader*)trace->mapping.data;
+    memset(trace->header, 0, sizeof(CPUTraceFileHeader));
+    trace->header->magic = CPU_TRACE_MAGIC;
+    trace->header->version = CPU_TRACE_VERSION;
+    trace->header->recordSize = sizeof(CPUTraceRecord);
+    trace->header->ringCapacity = roundedCapacity;
+    trace->records = (CPUTraceRecord*)(trace->mapping.data + sizeof(CPUTraceFileHeader));
+
+    return trace;
+}
+
+void FlushCPUTrace(CPUTrace* trace)
+{
+    if (trace->file && trace->count > trace->flushed) {
+        WriteCPUTraceRecords(trace, trace->file, trace->flushed, trace->count - trace->flushed);
+        trace->flushed = trace->count;
+    }
+}
+
+void DestroyCPUTrace(CPUTrace* trace)
+{
+    if (!trace) {
+        return;
+    }
+
+    if (trace->file) {
+        FlushCPUTrace(trace);
+        fclose(trace->file);
+    }
+
+    if (trace->header) {
+        UnmapFile(&trace->mapping);
+    } else {
+        FreeAligned(trace->records);
+    }
+    Free(trace);
+}
+
+bool WriteCPUTrace(CPUTrace* trace, const char* path)
+{
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+
+    u64 count = MIN(trace->count, (u64)trace->capacity);
+    bool written = WriteCPUTraceHeader(file);
+    if (written) {
+        WriteCPUTraceRecords(trace, file, trace->count - count, count);
+    }
+
+    written = !ferror(file) && written;
+    fclose(file);
+    return written;
+}
+
+bool OpenCPUTraceReference(CPUTraceReference* reference, const char* path)
+{
+    memset(reference, 0, sizeof(CPUTraceReference));
+    if (!MapFile(&reference->file, path, 0, false)) {
+        return false;
+    }
+
+    reference->line = 1;
+    return true;
+}
+
+void CloseCPUTraceReference(CPUTraceReference* reference)
+{
+    UnmapFile(&reference->file);
+}
+
+internal u64 GetTraceLineLength(CPUTraceReference* reference, u64 offset)
+{
+    const char* data = (const char*)reference->file.data;
+    u64 end = offset;
+    while (end < reference->file.size && data[end] != '\n') {
+        end++;
+    }
+
+    u64 length = end - offset;
+    if (length > 0 && data[end - 1] == '\r') {
+        length--;
+    }
+    return length;
+}
+
+internal s32 GetTraceDigit(char c, s32 base)
+{
+    s32 digit = -1;
+    if (c >= '0' && c <= '9') digit = c - '0';
+    if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+    return digit < base ? digit : -1;
+}
+
+// Parses the number at *position, after any spaces, and moves the position past it.
+internal bool ParseTraceNumber(const char* line, u64 length, u64* position, s32 base, s64* value)
+{
+    u64 i = *position;
+    while (i < length && line[i] == ' ') {
+        i++;
+    }
+
+    bool negative = i < length && line[i] == '-';
+    if (negative) {
+        i++;
+    }
+
+    u64 start = i;
+    s64 result = 0;
+    while (i < length && GetTraceDigit(line[i], base) >= 0) {
+        result = result * base + GetTraceDigit(line[i], base);
+        i++;
+    }
+
+    if (i == start) {
+        return false;
+    }
+
+    *position = i;
+    *value = negative ? -result : result;
+    return true;
+}
+
+// Parses the number after the next occurrence of label, searching from *position. Fields come in
+// a fixed order, so on success the position moves past the number and the next search starts there.
+internal bool ParseTraceField(const char* line, u64 length, u64* position, const char* label, s32 base, s64* value)
+{
+    u64 labelLength = strlen(label);
+    for (u64 i = *position; i + labelLength <= length; i++) {
+        if (line[i] == label[0] && memcmp(line + i, label, labelLength) == 0) {
+            u64 next = i + labelLength;
+            if (ParseTraceNumber(line, length, &next, base, value)) {
+                *position = next;
+                return true;
+            }
+            return false;
+        }
+    }
+    return false;
+}
+
+internal void AppendTraceMismatch(char* mismatches, size mismatchesSize, const char* field)
+{
+    size used = strlen(mismatches);
+    snprintf(mismatches + used, mismatchesSize - used, " %s", field);
+}
+
+internal void CompareTraceField(const char* line, u64 length, u64* position, const char* label, s32 base, s64 actual,
+                                char* mismatches, size mismatchesSize, const char* field)
+{
+    s64 expected;
+    if (ParseTraceField(line, length, position, label, base, &expected) && expected != actual) {
+        AppendTraceMismatch(mismatches, mismatchesSize, field);
+    }
+}
+
+CPUTraceCompare CompareCPUTraceReference(CPUTraceReference* reference, NES* nes, FILE* report)
+{
+    const char* data = (const char*)reference->file.data;
+
+    // blank lines are skipped
+    u64 length = 0;
+    while (reference->cursor < reference->file.size) {
+        length = GetTraceLineLength(reference, reference->cursor);
+        if (length > 0) {
+            break;
+        }
+        while (reference->cursor < reference->file.size && data[reference->cursor] != '\n') {
+            reference->cursor++;
+        }
+        reference->cursor++;
+        reference->line++;
+    }
+
+    if (reference->cursor >= reference->file.size) {
+        return CPU_TRACE_END;
+    }
+
+    const char* line = data + reference->cursor;
+
+    CPUTraceRecord record;
+    CaptureCPUTraceRecord(nes, &record);
+
+    char mismatches[64] = {0};
+
+    u64 position = 0;
+    s64 pc;
+    if (!ParseTraceNumber(line, length, &position, 16, &pc) || pc != record.pc) {
+        AppendTraceMismatch(mismatches, sizeof(mismatches), "PC");
+    }
+
+    // instruction bytes, two spaces after the address: "C000  4C F5 C5  JMP $C5F5"
+    u8 bytesCount = MAX(cpuInstructions[record.bytes[0]].bytesCount, 1);
+    for (u64 i = 0, bytePosition = position + 2; i < bytesCount; i++, bytePosition += 3) {
+        s32 high = bytePosition + 1 < length ? GetTraceDigit(line[bytePosition], 16) : -1;
+        s32 low = bytePosition + 1 < length ? GetTraceDigit(line[bytePosition + 1], 16) : -1;
+        if (high < 0 || low < 0 || ((high << 4) | low) != record.bytes[i]) {
+            AppendTraceMismatch(mismatches, sizeof(mismatches), "BYTES");
+            break;
+        }
+    }
+
+    // the registers start after the disassembly, which never has a colon
+    position += 2 + 3 * bytesCount;
+    CompareTraceField(line, length, &position, " A:", 16, record.a, mismatches, sizeof(mismatches), "A");
+    CompareTraceField(line, length, &position, " X:", 16, record.x, mismatches, sizeof(mismatches), "X");
+    CompareTraceField(line, length, &position, " Y:", 16, record.y, mismatches, sizeof(mismatches), "Y");
+    CompareTraceField(line, length, &position, " P:", 16, record.p, mismatches, sizeof(mismatches), "P");
+    CompareTraceField(line, length, &position, " SP:", 16, record.sp, mismatches, sizeof(mismatches), "SP");
+
+    s64 scanline;
+    if (ParseTraceField(line, length, &position, " PPU:", 10, &scanline)) {
+        if (scanline != record.scanline) {
+            AppendTraceMismatch(mismatches, sizeof(mismatches), "SCANLINE");
+        }
+        CompareTraceField(line, length, &position, ",", 10, record.dot, mismatches, sizeof(mismatches), "DOT");
+    }
+
+    CompareTraceField(line, length, &position, " CYC:", 10, (s64)record.cycle, mismatches, sizeof(mismatches),
+                      "CYC");
+
+    if (mismatches[0]) {
+        fprintf(report, "Trace diverges from the reference at line %llu:\n", (unsigned long long)reference->line);
+
+        u64 first = reference->matched > CPU_TRACE_CONTEXT_LINES ? reference->matched - CPU_TRACE_CONTEXT_LINES : 0;
+        for (u64 i = first; i < reference->matched; i++) {
+            u64 offset = reference->history[i % CPU_TRACE_CONTEXT_LINES];
+            fprintf(report, "  %.*s\n", (int)GetTraceLineLength(reference, offset), data + offset);
+        }
+
+        char actual[CPU_TRACE_LINE_LENGTH];
+        FormatCPUTraceRecord(&record, actual, sizeof(actual));
+        fprintf(report, "- %.*s\n", (int)length, line);
+        fprintf(report, "+ %s", actual);
+        fprintf(report, "Mismatched:%s\n", mismatches);
+        return CPU_TRACE_DIVERGED;
+    }
+
+    reference->history[reference->matched % CPU_TRACE_CONTEXT_LINES] = reference->cursor;
+    reference->matched++;
+
+    reference->cursor += length;
+    while (reference->cursor < reference->file.size && data[reference->cursor] != '\n') {
+        reference->cursor++;
+    }
+    reference->cursor++;
+    reference->line++;
+
+    return CPU_TRACE_MATCH;
 }
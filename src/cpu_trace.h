@@ -2,8 +2,118 @@
 #define CPU_TRACE_H
 
 #include "types.h"
+#include "platform.h"
 #include <stdio.h>
 
+/*
+ * CPU traces. A record holds everything the nestest-style log line shows for an instruction
+ * (the registers, the PPU position, the instruction bytes and the memory it points at) in 32 bytes,
+ * so tracing costs a few bus peeks instead of formatting text. Records go to a ring buffer that
+ * either keeps the last N instructions or is appended to a file every time it fills up. A ring of
+ * the last N can live in a mapped file, so it's on disk even when the process crashes or asserts.
+ * FormatCPUTraceRecord turns a record back into the text LogCPUState writes.
+ */
+
+#define CPU_TRACE_MAGIC 0x4352544E // "NTRC"
+#define CPU_TRACE_VERSION 2
+#define CPU_TRACE_DEFAULT_CAPACITY 4096
+#define CPU_TRACE_LINE_LENGTH 128
+#define CPU_TRACE_CONTEXT_LINES 8
+
+typedef struct CPUTraceRecord {
+    u64 cycle;
+    u16 pc;
+    s16 scanline;
+    u16 dot;
+
+    // pointer the instruction goes through: the jump target of JMP (ind), the address read
+    // through ($zp,X) and the base pointer of ($zp),Y
+    u16 indirect;
+
+    u8 bytes[3];
+    u8 value; // byte at the effective address
+    u8 a, x, y, p, sp;
+    u8 reserved[7];
+} CPUTraceRecord;
+
+// Trace files are this header followed by the records, oldest first, or by a ring of ringCapacity
+// records where record i of the run is at i % ringCapacity.
+typedef struct CPUTraceFileHeader {
+    u32 magic;
+    u32 version;
+    u32 recordSize;
+    u32 ringCapacity; // 0 when the records are in order
+    u64 ringCount;    // records written to the ring
+    u64 reserved;
+} CPUTraceFileHeader;
+
+typedef struct CPUTrace {
+    CPUTraceRecord* records;
+    u32 capacity; // power of two
+    u64 count;    // records captured so far
+
+    // every record is appended here when set, otherwise only the last capacity records are kept
+    FILE* file;
+    u64 flushed;
+
+    // set when the records are a ring mapped onto a file, its count is updated with every record
+    MappedFile mapping;
+    CPUTraceFileHeader* header;
+} CPUTrace;
+
+// The capacity is rounded up to a power of two. With a path every record is written to it,
+// without one the trace only keeps the last records in memory.
+CPUTrace* CreateCPUTrace(u32 capacity, const char* path);
+// Keeps the last records (capacity rounded up to a power of two) in a ring mapped onto the file at
+// path. Nothing needs to be written when the run ends, the file is complete after every record.
+CPUTrace* CreateCPUTraceRing(u32 capacity, const char* path);
+// Writes the records that are still pending and closes the file.
+void DestroyCPUTrace(CPUTrace* trace);
+void FlushCPUTrace(CPUTrace* trace);
+// Writes the records held in memory, oldest first, as a trace file.
+bool WriteCPUTrace(CPUTrace* trace, const char* path);
+
+void CaptureCPUTraceRecord(NES* nes, CPUTraceRecord* record);
+s32 FormatCPUTraceRecord(CPUTraceRecord* record, char* buffer, size bufferSize);
+
+static inline void RecordCPUTrace(CPUTrace* trace, NES* nes)
+{
+    CaptureCPUTraceRecord(nes, &trace->records[trace->count & (trace->capacity - 1)]);
+    trace->count++;
+
+    if (trace->header) {
+        trace->header->ringCount = trace->count;
+    }
+
+    if (trace->file && trace->count - trace->flushed == trace->capacity) {
+        FlushCPUTrace(trace);
+    }
+}
+
 void LogCPUState(NES* nes, FILE* logFile);
 
+// A nestest-style text log mapped in memory, compared line by line against the running CPU.
+// Only the fields a line has are compared, so logs without the PPU position or the cycle work too.
+typedef struct CPUTraceReference {
+    MappedFile file;
+    u64 cursor;
+    u64 line; // 1-based line number of the cursor
+
+    // offsets of the last lines that matched, shown as context when the trace diverges
+    u64 matched;
+    u64 history[CPU_TRACE_CONTEXT_LINES];
+} CPUTraceReference;
+
+typedef enum CPUTraceCompare {
+    CPU_TRACE_MATCH,
+    CPU_TRACE_DIVERGED,
+    CPU_TRACE_END,
+} CPUTraceCompare;
+
+bool OpenCPUTraceReference(CPUTraceReference* reference, const char* path);
+void CloseCPUTraceReference(CPUTraceReference* reference);
+// Compares the state before the next instruction with the next reference line. On a divergence
+// the preceding lines, both versions of the line and the fields that differ are written to report.
+CPUTraceCompare CompareCPUTraceReference(CPUTraceReference* reference, NES* nes, FILE* report);
+
 #endif // CPU_TRACE_H
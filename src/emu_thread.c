@@ -0,0 +1,561 @@
+#include <string.h>
+
+#include "emu_thread.h"
+#include "nes.h"
+#include "cpu.h"
+#include "cpu_trace.h"
+#include "ppu.h"
+#include "apu.h"
+#include "movie.h"
+
+// True NTSC frame duration: 1 / (CPU_FREQ / (341 * 262 / 3))
+//   = (341 * 262) / (3 * CPU_FREQ)
+//   = 89342 / 5369319
+//   ≈ 0.016639 s  (16.639 ms, NOT 16.7 ms)
+//
+// Using 0.0167 s over-waits by ~0.061 ms per frame = ~3.7 ms/sec.
+// Combined with the APU over-sampling this worsened audio drift.
+// The exact expression avoids a magic number and stays in sync with
+// any future changes to CPU_FREQ or PPU constants.
+#define NES_FRAME_DURATION_S ((f64)(PPU_CYCLES_PER_SCANLINE * PPU_SCANLINES_PER_FRAME) / (3.0 * CPU_FREQ))
+
+// Recording covers one loaded game, it's written out when the game is replaced or the thread stops.
+internal void StartEmuMovieRecording(EmuThread* thread, bool fromSnapshot)
+{
+    const char* path = thread->config.moviePath;
+    if (path && path[0] && !RecordMovie(thread->game, fromSnapshot)) {
+        fprintf(stderr, "Warning: could not start recording the input movie\n");
+    }
+}
+
+internal void StopEmuMovieRecording(EmuThread* thread)
+{
+    NES* nes = thread->game;
+    if (nes && nes->movie) {
+        if (!SaveMovie(nes, thread->config.moviePath)) {
+            fprintf(stderr, "Warning: could not write input movie: %s\n", thread->config.moviePath);
+        }
+        DestroyMovie(nes->movie);
+        nes->movie = NULL;
+    }
+}
+
+// The settings live in the APU registers, they are applied again after every load and reset.
+internal void ApplyEmuAudioSettings(EmuThread* thread)
+{
+    if (!thread->game) {
+        return;
+    }
+
+    APU* apu = &thread->game->apu;
+    EmuAudioSettings* audio = &thread->audio;
+
+    apu->hpFilter1.enabled = audio->hpFilter1Enabled;
+    apu->hpFilter1.freq = audio->hpFilter1Freq;
+    apu->hpFilter2.enabled = audio->hpFilter2Enabled;
+    apu->hpFilter2.freq = audio->hpFilter2Freq;
+    apu->lpFilter.enabled = audio->lpFilterEnabled;
+    apu->lpFilter.freq = audio->lpFilterFreq;
+
+    apu->pulse1.globalEnabled = audio->channels[APU_CHANNEL_PULSE1];
+    apu->pulse2.globalEnabled = audio->channels[APU_CHANNEL_PULSE2];
+    apu->triangle.globalEnabled = audio->channels[APU_CHANNEL_TRIANGLE];
+    apu->noise.globalEnabled = audio->channels[APU_CHANNEL_NOISE];
+    apu->dmc.globalEnabled = audio->channels[APU_CHANNEL_DMC];
+}
+
+internal void ExecuteEmuCommand(EmuThread* thread, EmuCommand* command)
+{
+    EmuControlState* control = &thread->control;
+
+    switch (command->type) {
+        case EMU_COMMAND_LOAD: {
+            StopEmuMovieRecording(thread);
+            if (thread->game) Destroy(thread->game);
+            thread->game = command->game;
+            thread->game->liveInput = &thread->input;
+            thread->gameId = command->gameId;
+            ApplyEmuAudioSettings(thread);
+            StartEmuMovieRecording(thread, command->fromSnapshot);
+
+            // saves resume where they were, roms start in the debugger
+            if (!command->fromSnapshot) {
+                control->hitRun = false;
+                control->paused = true;
+                control->stepping = false;
+            }
+            break;
+        }
+
+        case EMU_COMMAND_RUN: {
+            if (thread->game) {
+                control->hitRun = true;
+                control->paused = false;
+                control->stepping = false;
+            }
+            break;
+        }
+
+        case EMU_COMMAND_PAUSE: {
+            control->paused = true;
+            control->stepping = false;
+            break;
+        }
+
+        case EMU_COMMAND_STEP: {
+            if (thread->game) control->stepping = true;
+            break;
+        }
+
+        case EMU_COMMAND_RESET: {
+            if (thread->game) {
+                ResetNES(thread->game);
+                ApplyEmuAudioSettings(thread);
+                control->paused = true;
+            }
+            break;
+        }
+
+        case EMU_COMMAND_SAVE: {
+            if (thread->game) {
+                control->paused = true;
+                control->stepping = false;
+                Save(thread->game, command->path);
+            }
+            break;
+        }
+
+        case EMU_COMMAND_SET_BREAKPOINT: {
+            control->breakpoint = command->address;
+            break;
+        }
+
+        case EMU_COMMAND_SET_ONE_CYCLE: {
+            control->oneCycleAtTime = command->enabled;
+            break;
+        }
+
+        case EMU_COMMAND_SET_AUDIO: {
+            thread->audio = command->audio;
+            ApplyEmuAudioSettings(thread);
+            break;
+        }
+
+        case EMU_COMMAND_SET_PACING: {
+            thread->pacing = command->pacing;
+            break;
+        }
+
+        case EMU_COMMAND_SET_FAST_FORWARD: {
+            control->fastForward = command->enabled;
+            break;
+        }
+    }
+}
+
+internal void ProcessEmuCommands(EmuThread* thread)
+{
+    while (true) {
+        EmuCommand command;
+
+        LockMutex(&thread->commandLock);
+        if (thread->commandCount == 0) {
+            UnlockMutex(&thread->commandLock);
+            break;
+        }
+        command = thread->commands[thread->commandStart];
+        thread->commandStart = (thread->commandStart + 1) % EMU_COMMAND_QUEUE_LENGTH;
+        thread->commandCount--;
+        UnlockMutex(&thread->commandLock);
+
+        ExecuteEmuCommand(thread, &command);
+    }
+}
+
+internal bool IsAudioQueueLow(EmuThread* thread)
+{
+    s32 queued = thread->config.audioQueuedProc(thread->config.audioData);
+    return queued < EMU_AUDIO_QUEUED_FRAMES * APU_SAMPLES_PER_SECOND * NES_FRAME_DURATION_S;
+}
+
+// The samples of the frame fade in and out so the cuts fast forward makes between the frames it
+// plays don't click.
+internal void FadeEmuAudio(APUOutput* output)
+{
+    s32 count = MIN(output->bufferIndex, APU_BUFFER_LENGTH);
+    s32 fade = MIN(EMU_AUDIO_FADE_SAMPLES, count / 2);
+
+    for (s32 i = 0; i < fade; i++) {
+        output->buffer[i] = (s16)(output->buffer[i] * i / fade);
+        output->buffer[count - 1 - i] = (s16)(output->buffer[count - 1 - i] * i / fade);
+    }
+}
+
+internal void RunEmuFrame(EmuThread* thread, bool fastForward)
+{
+    NES* nes = thread->game;
+    EmuControlState* control = &thread->control;
+
+    // Exact NTSC CPU cycles per frame derived from PPU geometry:
+    //   PPU cycles/frame = PPU_CYCLES_PER_SCANLINE * PPU_SCANLINES_PER_FRAME
+    //                    = 341 * 262 = 89342
+    //   CPU cycles/frame = 89342 / 3 = 29780.666...
+    //
+    // The old value was 0.0167 * CPU_FREQ = 29889 — 109 cycles/frame
+    // too many, making the emulator run at ~59.88 fps instead of the
+    // correct ~60.099 fps (NTSC).  Over-counted cycles also mean more
+    // audio samples are generated per wall-clock second, compounding
+    // the APU drift described in apu.h.
+    //
+    // cycleRemainder tracks the fractional cycles not yet assigned.
+    // 89342 mod 3 = 2, so the remainder grows by 2 per frame.
+    // When it accumulates to >= 3 we add one extra CPU cycle that frame
+    // and subtract 3 from the remainder.  This keeps the long-run
+    // average at exactly 29780.666... cycles/frame with no float math.
+    thread->cycleRemainder += (PPU_CYCLES_PER_SCANLINE * PPU_SCANLINES_PER_FRAME) % 3; // += 2
+    s64 cycles = (PPU_CYCLES_PER_SCANLINE * PPU_SCANLINES_PER_FRAME) / 3;              // 29780
+    if (thread->cycleRemainder >= 3) {
+        cycles++;
+        thread->cycleRemainder -= 3;
+    }
+
+    if (control->stepping || control->oneCycleAtTime) {
+        cycles = 1;
+    }
+
+    nes->apuOutput->bufferIndex = 0;
+    if (nes->debug) nes->debug->channelBufferIndex = 0;
+
+    while (cycles > 0) {
+        if (!control->paused) {
+            if (!control->hitRun) {
+                if (nes->cpu.pc == control->breakpoint) {
+                    control->paused = true;
+                    control->stepping = false;
+                }
+            } else {
+                control->hitRun = false;
+            }
+        }
+
+        if (control->paused && !control->stepping) break;
+
+        if (thread->config.logFile) {
+            LogCPUState(nes, thread->config.logFile);
+        }
+
+        CPUStep step = StepCPU(nes);
+        cycles -= step.cycles;
+
+        if (control->paused) control->stepping = false;
+    }
+
+    if (thread->config.audioProc) {
+        if (!fastForward) {
+            thread->config.audioProc(thread->config.audioData, nes->apuOutput);
+        } else if (thread->config.audioQueuedProc && thread->config.audioQueuedProc(thread->config.audioData) >= 0 &&
+                   IsAudioQueueLow(thread)) {
+            // only as many frames as the device plays in real time, the others are dropped whole
+            FadeEmuAudio(nes->apuOutput);
+            thread->config.audioProc(thread->config.audioData, nes->apuOutput);
+        }
+    }
+    FlushBatteryRAM(nes, false);
+}
+
+internal void PublishEmuFrame(EmuThread* thread)
+{
+    NES* nes = thread->game;
+    EmuFrame* frame = &thread->frames[thread->back];
+
+    frame->sequence = thread->sequence++;
+    frame->gameId = nes ? thread->gameId : 0;
+    frame->paused = thread->control.paused;
+    frame->speed = thread->speed;
+    frame->profile = thread->lastProfile;
+
+    if (nes) {
+        memcpy(frame->pixels, nes->gui.pixels, sizeof(frame->pixels));
+        SnapshotNES(nes, frame->state);
+        frame->sampleCount = MIN(nes->apuOutput->bufferIndex, APU_BUFFER_LENGTH);
+        memcpy(frame->samples, nes->apuOutput->buffer, frame->sampleCount * sizeof(s16));
+    }
+
+    u32 previous = AtomicExchangeU32(&thread->middle, thread->back | EMU_FRAME_FRESH);
+    thread->back = previous & ~EMU_FRAME_FRESH;
+
+    LockMutex(&thread->frameLock);
+    BroadcastCondition(&thread->framePublished);
+    UnlockMutex(&thread->frameLock);
+}
+
+// Sleeps until shortly before deadline and spins the rest.
+internal void WaitUntilTimer(u64 deadline)
+{
+    u64 spinTicks = (u64)(EMU_SPIN_SECONDS * (f64)GetTimerFrequency());
+    if (GetTimerTicks() + spinTicks < deadline) {
+        SleepUntilTimer(deadline - spinTicks);
+    }
+
+    while (GetTimerTicks() < deadline) {
+    }
+}
+
+// Short sleeps until ready tells the next frame can run, never for more than two frames so a
+// device or a UI that stopped doesn't stop emulation. Returns false when it gave up.
+internal bool PollEmuPacing(EmuThread* thread, bool (*ready)(EmuThread* thread))
+{
+    u64 pollTicks = (u64)(EMU_POLL_SECONDS * (f64)GetTimerFrequency());
+    u64 limit = GetTimerTicks() + 2 * thread->frameTicks;
+
+    while (!ready(thread)) {
+        u64 now = GetTimerTicks();
+        if (now >= limit) {
+            return false;
+        }
+        SleepUntilTimer(now + pollTicks);
+    }
+
+    return true;
+}
+
+internal bool HasUIPresented(EmuThread* thread)
+{
+    return AtomicLoadU32(&thread->presents) != thread->lastPresent;
+}
+
+// Waits until the next frame is due.
+internal void PaceEmuFrame(EmuThread* thread)
+{
+    EmuPacing pacing = thread->pacing;
+    EmuControlState* control = &thread->control;
+
+    // frames in the debugger or one instruction at a time make (almost) no sound, the queue would
+    // always be low
+    if (pacing == EMU_PACING_AUDIO && thread->game && !control->paused && !control->oneCycleAtTime &&
+        thread->config.audioQueuedProc && thread->config.audioQueuedProc(thread->config.audioData) >= 0) {
+        PollEmuPacing(thread, IsAudioQueueLow);
+        thread->deadline = GetTimerTicks();
+        return;
+    }
+
+    if (pacing == EMU_PACING_VSYNC) {
+        PollEmuPacing(thread, HasUIPresented);
+        thread->lastPresent = AtomicLoadU32(&thread->presents);
+        thread->deadline = GetTimerTicks();
+        return;
+    }
+
+    // deadlines advance by exactly one frame, a frame that started late is made up by the next
+    // ones unless emulation fell more than a frame behind (a load, a slow debugger step)
+    thread->deadline += thread->frameTicks;
+    u64 now = GetTimerTicks();
+    if (now > thread->deadline + thread->frameTicks) {
+        thread->deadline = now;
+    }
+
+    WaitUntilTimer(thread->deadline);
+}
+
+internal void MeasureEmuSpeed(EmuThread* thread, bool emulated)
+{
+    if (emulated) thread->speedFrames++;
+
+    u64 now = GetTimerTicks();
+    u64 elapsed = now - thread->speedStart;
+    if (elapsed >= (u64)(EMU_SPEED_SECONDS * (f64)GetTimerFrequency())) {
+        f64 seconds = (f64)elapsed / (f64)GetTimerFrequency();
+        thread->speed = (f32)(thread->speedFrames * NES_FRAME_DURATION_S / seconds);
+        thread->speedStart = now;
+        thread->speedFrames = 0;
+    }
+}
+
+internal s32 RunEmuThread(void* data)
+{
+    EmuThread* thread = (EmuThread*)data;
+
+    thread->frameTicks = (u64)(NES_FRAME_DURATION_S * (f64)GetTimerFrequency());
+    thread->deadline = GetTimerTicks();
+    thread->speedStart = thread->deadline;
+
+    ResetProfiler();
+
+    while (AtomicLoadU32(&thread->running)) {
+        ProcessEmuCommands(thread);
+
+        EmuControlState* control = &thread->control;
+        bool emulated = thread->game && (!control->paused || control->stepping);
+        bool fastForward = emulated && control->fastForward && !control->oneCycleAtTime;
+
+        // fast forward renders and publishes a frame when one is due on the display by the time it's
+        // done, the UI couldn't show the others anyway
+        u64 frameCost = (u64)(thread->lastProfile.seconds * (f64)GetTimerFrequency());
+        bool due = !fastForward || GetTimerTicks() + frameCost - thread->lastPublish >= thread->frameTicks;
+        bool present = due;
+
+        if (thread->game) {
+            // frames don't start at the top of the screen, the one before a published frame is
+            // rendered too so every line comes from the last frame
+            present = due && !thread->game->gui.skipPixels;
+            thread->game->gui.skipPixels = !due;
+            RunEmuFrame(thread, fastForward);
+        }
+
+        // published before waiting, the UI thread gets the frame as soon as it's done
+        if (present) {
+            PublishEmuFrame(thread);
+            thread->lastPublish = GetTimerTicks();
+        }
+
+        MeasureEmuSpeed(thread, emulated);
+
+        if (fastForward) {
+            thread->deadline = GetTimerTicks();
+        } else {
+            PaceEmuFrame(thread);
+        }
+
+        thread->lastProfile = *EndProfileFrame();
+    }
+
+    StopEmuMovieRecording(thread);
+
+    // nothing waits for frames that won't come
+    LockMutex(&thread->frameLock);
+    BroadcastCondition(&thread->framePublished);
+    UnlockMutex(&thread->frameLock);
+
+    return 0;
+}
+
+EmuThread* CreateEmuThread(EmuThreadConfig* config)
+{
+    EmuThread* thread = (EmuThread*)Allocate(sizeof(EmuThread));
+    if (!thread) {
+        return NULL;
+    }
+
+    memset(thread, 0, sizeof(EmuThread));
+    thread->config = *config;
+    thread->audio = config->audio;
+    thread->pacing = config->pacing;
+    thread->control.paused = true;
+
+    thread->frames = (EmuFrame*)AllocateAligned(sizeof(EmuFrame) * 3, CACHE_LINE_SIZE);
+    if (!thread->frames) {
+        Free(thread);
+        return NULL;
+    }
+
+    memset(thread->frames, 0, sizeof(EmuFrame) * 3);
+    thread->back = 0;
+    thread->front = 1;
+    thread->middle = 2;
+
+    InitMutex(&thread->commandLock);
+    InitMutex(&thread->frameLock);
+    InitCondition(&thread->framePublished);
+
+    thread->running = 1;
+    if (!StartThread(&thread->thread, RunEmuThread, thread)) {
+        thread->running = 0;
+        DestroyEmuThread(thread);
+        return NULL;
+    }
+
+    thread->started = true;
+    return thread;
+}
+
+void StopEmuThread(EmuThread* thread)
+{
+    if (thread->started) {
+        AtomicStoreU32(&thread->running, 0);
+        JoinThread(&thread->thread);
+        thread->started = false;
+    }
+}
+
+void DestroyEmuThread(EmuThread* thread)
+{
+    if (!thread) {
+        return;
+    }
+
+    StopEmuThread(thread);
+
+    // commands that never ran still own their game
+    for (u32 i = 0; i < thread->commandCount; i++) {
+        EmuCommand* command = &thread->commands[(thread->commandStart + i) % EMU_COMMAND_QUEUE_LENGTH];
+        if (command->type == EMU_COMMAND_LOAD && command->game) {
+            Destroy(command->game);
+        }
+    }
+
+    if (thread->game) {
+        Destroy(thread->game);
+    }
+
+    DestroyCondition(&thread->framePublished);
+    DestroyMutex(&thread->frameLock);
+    DestroyMutex(&thread->commandLock);
+    FreeAligned(thread->frames);
+    Free(thread);
+}
+
+bool PostEmuCommand(EmuThread* thread, EmuCommand* command)
+{
+    bool posted = false;
+
+    LockMutex(&thread->commandLock);
+    if (thread->commandCount < EMU_COMMAND_QUEUE_LENGTH) {
+        u32 index = (thread->commandStart + thread->commandCount) % EMU_COMMAND_QUEUE_LENGTH;
+        thread->commands[index] = *command;
+        thread->commandCount++;
+        posted = true;
+    }
+    UnlockMutex(&thread->commandLock);
+
+    return posted;
+}
+
+void SetEmuInput(EmuThread* thread, u8 pad0, u8 pad1)
+{
+    AtomicStoreU32(&thread->input, (u32)pad0 | ((u32)pad1 << 8));
+}
+
+void SignalEmuPresent(EmuThread* thread)
+{
+    AtomicStoreU32(&thread->presents, AtomicLoadU32(&thread->presents) + 1);
+}
+
+EmuFrame* AcquireEmuFrame(EmuThread* thread, bool* newFrame)
+{
+    *newFrame = false;
+
+    if (AtomicLoadU32(&thread->middle) & EMU_FRAME_FRESH) {
+        u32 previous = AtomicExchangeU32(&thread->middle, thread->front);
+        thread->front = previous & ~EMU_FRAME_FRESH;
+        thread->frontValid = true;
+        *newFrame = true;
+    }
+
+    return thread->frontValid ? &thread->frames[thread->front] : NULL;
+}
+
+void WaitEmuFrame(EmuThread* thread)
+{
+    LockMutex(&thread->frameLock);
+    while (!(AtomicLoadU32(&thread->middle) & EMU_FRAME_FRESH) && AtomicLoadU32(&thread->running)) {
+        WaitCondition(&thread->framePublished, &thread->frameLock);
+    }
+    UnlockMutex(&thread->frameLock);
+}
+
+void RestoreEmuView(NES* view, EmuFrame* frame)
+{
+    RestoreNES(view, frame->state);
+    memcpy(view->apuOutput->buffer, frame->samples, frame->sampleCount * sizeof(s16));
+    view->apuOutput->bufferIndex = frame->sampleCount;
+}
@@ -0,0 +1,213 @@
+#ifndef EMU_THREAD_H
+#define EMU_THREAD_H
+
+#include "types.h"
+#include "platform.h"
+#include "profile.h"
+
+/*
+ * Runs the game on its own thread so the UI thread (SDL events, ImGui, GL) can take as long as it
+ * needs without delaying emulation. The two threads share nothing but what's below:
+ *
+ *   - Frames: after every frame the emulation thread copies the screen, the hot NES state and the
+ *     audio of the frame into an EmuFrame and publishes it through a triple buffer. The UI thread
+ *     picks up the newest one whenever it draws, frames it was too slow to see are replaced.
+ *   - Input: the controller state is a single atomic word the UI thread overwrites after handling
+ *     the events of every UI frame. The game reads it when it strobes the pads (NES.liveInput).
+ *   - Commands: debugger and menu actions go through a queue the emulation thread drains at the
+ *     start of every frame. The loaded NES is only ever touched by the emulation thread, a new
+ *     game is handed over with EMU_COMMAND_LOAD.
+ *
+ * The debugger panels read a clone of the game the UI thread owns, restored from the state of the
+ * last frame published (see RestoreEmuView).
+ *
+ * Between frames the thread sleeps on the OS high resolution timer until shortly before the next
+ * frame is due and spins the rest, so it stays precise without keeping a core busy.
+ *
+ * Fast forward drops the pacing: frames run back to back and only the ones due on the display
+ * (about one per NTSC frame of wall time) are rendered to RGBA and published, the rest skip the
+ * pixels. Their audio is dropped a whole frame at a time, with the edges faded, instead of filling
+ * the device queue.
+ */
+
+#define EMU_COMMAND_QUEUE_LENGTH 64
+
+// how long before a frame is due the thread stops sleeping and spins
+#define EMU_SPIN_SECONDS 0.001
+// sleep between checks of the audio queue or the UI presents
+#define EMU_POLL_SECONDS 0.0005
+// the audio pacing keeps about this many frames of audio queued
+#define EMU_AUDIO_QUEUED_FRAMES 2
+// samples faded in and out at the edges of the frames fast forward plays
+#define EMU_AUDIO_FADE_SAMPLES 64
+// how often the emulation speed is measured
+#define EMU_SPEED_SECONDS 0.5
+
+typedef enum EmuPacing {
+    EMU_PACING_TIMER, // NTSC frame rate on the high resolution timer
+    EMU_PACING_AUDIO, // a frame whenever the audio queue runs low, the timer when there's no audio device
+    EMU_PACING_VSYNC, // a frame per frame the UI presents, only meant for when the UI has v-sync
+    EMU_PACING_COUNT
+} EmuPacing;
+
+typedef enum EmuCommandType {
+    EMU_COMMAND_LOAD,             // game, takes ownership of it
+    EMU_COMMAND_RUN,              // leaves the debugger, the breakpoint is ignored for one instruction
+    EMU_COMMAND_PAUSE,            // stops in the debugger
+    EMU_COMMAND_STEP,             // one instruction, when in the debugger
+    EMU_COMMAND_RESET,            // resets and stops in the debugger
+    EMU_COMMAND_SAVE,             // path, stops in the debugger
+    EMU_COMMAND_SET_BREAKPOINT,   // address
+    EMU_COMMAND_SET_ONE_CYCLE,    // enabled, one instruction per frame
+    EMU_COMMAND_SET_AUDIO,        // audio
+    EMU_COMMAND_SET_PACING,       // pacing
+    EMU_COMMAND_SET_FAST_FORWARD, // enabled, no pacing and only the frames due on the display are rendered
+} EmuCommandType;
+
+// APU channels and filters the audio panel toggles, applied to every game loaded.
+typedef struct EmuAudioSettings {
+    bool channels[APU_CHANNEL_COUNT];
+    bool hpFilter1Enabled;
+    s32 hpFilter1Freq;
+    bool hpFilter2Enabled;
+    s32 hpFilter2Freq;
+    bool lpFilterEnabled;
+    s32 lpFilterFreq;
+} EmuAudioSettings;
+
+typedef struct EmuCommand {
+    EmuCommandType type;
+
+    NES* game;
+    u32 gameId; // generation the UI gave the game, published with its frames
+    bool fromSnapshot;
+
+    u16 address;
+    bool enabled;
+    EmuAudioSettings audio;
+    EmuPacing pacing;
+    char path[1024];
+} EmuCommand;
+
+typedef struct EmuControlState {
+    bool hitRun;
+    bool paused;
+    bool stepping;
+    bool oneCycleAtTime;
+    bool fastForward;
+    u16 breakpoint;
+} EmuControlState;
+
+typedef struct EmuFrame {
+    u64 sequence; // frames published before this one
+    u32 gameId;   // 0 when no game is loaded, the other fields are only valid when it isn't
+    bool paused;
+    f32 speed; // frames emulated per NTSC frame of wall time, measured every EMU_SPEED_SECONDS
+
+    Color pixels[PPU_SCREEN_WIDTH * PPU_SCREEN_HEIGHT];
+    u8 state[NES_STATE_SIZE];
+
+    s32 sampleCount;
+    s16 samples[APU_BUFFER_LENGTH];
+
+    // the emulation thread's profile of the frame before this one
+    ProfileFrame profile;
+} EmuFrame;
+
+// Called on the emulation thread with the audio of every frame.
+typedef void (*EmuAudioProc)(void* data, APUOutput* output);
+// Called on the emulation thread, APU samples waiting to be played, negative without an audio device.
+typedef s32 (*EmuAudioQueuedProc)(void* data);
+
+typedef struct EmuThreadConfig {
+    EmuAudioProc audioProc;
+    EmuAudioQueuedProc audioQueuedProc;
+    void* audioData;
+
+    EmuPacing pacing;
+
+    // optional, every instruction is logged to it
+    FILE* logFile;
+    // optional, the input of every game loaded is recorded to it
+    const char* moviePath;
+
+    EmuAudioSettings audio;
+} EmuThreadConfig;
+
+typedef struct EmuThread {
+    EmuThreadConfig config;
+    Thread thread;
+    volatile u32 running;
+    bool started; // not joined yet
+
+    // owned by the emulation thread while it runs
+    NES* game;
+    u32 gameId;
+    EmuControlState control;
+    EmuAudioSettings audio;
+    s64 cycleRemainder;
+    ProfileFrame lastProfile;
+    u64 sequence;
+
+    // pacing, in timer ticks
+    EmuPacing pacing;
+    u64 frameTicks;
+    u64 deadline;
+    u32 lastPresent;
+    u64 lastPublish;
+
+    // emulation speed
+    u64 speedStart;
+    u32 speedFrames;
+    f32 speed;
+
+    // frames the UI thread presented, for EMU_PACING_VSYNC
+    volatile u32 presents;
+
+    // pad 0 in the low byte, pad 1 in the next one
+    volatile u32 input;
+
+    Mutex commandLock;
+    EmuCommand commands[EMU_COMMAND_QUEUE_LENGTH];
+    u32 commandStart;
+    u32 commandCount;
+
+    // triple buffer: the emulation thread writes frames[back], the UI thread reads frames[front]
+    // and the third index is exchanged through middle, with EMU_FRAME_FRESH set when it holds a
+    // frame the UI thread hasn't taken yet
+    EmuFrame* frames;
+    u32 back;
+    u32 front;
+    bool frontValid;
+    volatile u32 middle;
+
+    Mutex frameLock;
+    Condition framePublished;
+} EmuThread;
+
+#define EMU_FRAME_FRESH 0x4
+
+// Starts the thread with no game loaded and the debugger stopped.
+EmuThread* CreateEmuThread(EmuThreadConfig* config);
+// Stops and joins the thread, the game it was running is still in game, recording stopped.
+void StopEmuThread(EmuThread* thread);
+// Stops the thread if it's still running and frees it along with the game.
+void DestroyEmuThread(EmuThread* thread);
+
+// Returns false when the queue is full, the caller still owns the game of EMU_COMMAND_LOAD then.
+bool PostEmuCommand(EmuThread* thread, EmuCommand* command);
+
+void SetEmuInput(EmuThread* thread, u8 pad0, u8 pad1);
+// Called by the UI thread after every present (buffer swap).
+void SignalEmuPresent(EmuThread* thread);
+
+// The newest frame published, NULL until the first one. It stays valid until the next call.
+// newFrame tells whether it changed since the previous call.
+EmuFrame* AcquireEmuFrame(EmuThread* thread, bool* newFrame);
+// Blocks until there's a frame newer than the one acquired last, or the thread stopped.
+void WaitEmuFrame(EmuThread* thread);
+
+// Brings view, a clone of the game of frame, to the state of the frame.
+void RestoreEmuView(NES* view, EmuFrame* frame);
+
+#endif // EMU_THREAD_H
@@ -9,7 +9,7 @@ void InitGUI(NES* nes)
     gui->width = PPU_SCREEN_WIDTH;
     gui->height = PPU_SCREEN_HEIGHT;
 
-    ASSERT(sizeof(gui->pixels) == gui->width * gui->height * sizeof(Color));
+    ASSERT(gui->pixels);
 }
 
 void ResetGUI(NES* nes)
@@ -20,8 +20,6 @@ void ResetGUI(NES* nes)
     gui->height = PPU_SCREEN_HEIGHT;
 
     memset(gui->pixels, 0, PPU_SCREEN_WIDTH * PPU_SCREEN_HEIGHT * sizeof(Color));
-
-    ASSERT(sizeof(gui->pixels) == gui->width * gui->height * sizeof(Color));
 }
 
 void SetGUIPixel(GUI* gui, u32 x, u32 y, Color color)
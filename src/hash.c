@@ -0,0 +1,123 @@
+#include <string.h>
+
+#include "hash.h"
+
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+internal inline u64 RotateLeft64(u64 x, s32 r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+internal inline u64 ReadLE64(const u8* p)
+{
+    u64 v;
+    memcpy(&v, p, sizeof(u64));
+    return v;
+}
+
+internal inline u32 ReadLE32(const u8* p)
+{
+    u32 v;
+    memcpy(&v, p, sizeof(u32));
+    return v;
+}
+
+internal inline u64 XXH64Round(u64 acc, u64 input)
+{
+    acc += input * XXH_PRIME64_2;
+    acc = RotateLeft64(acc, 31);
+    return acc * XXH_PRIME64_1;
+}
+
+internal inline u64 XXH64MergeRound(u64 acc, u64 val)
+{
+    acc ^= XXH64Round(0, val);
+    return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+u64 HashBytes(const void* data, size length, u64 seed)
+{
+    const u8* p = (const u8*)data;
+    const u8* end = p + length;
+    u64 h;
+
+    if (length >= 32) {
+        const u8* limit = end - 32;
+        u64 v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+        u64 v2 = seed + XXH_PRIME64_2;
+        u64 v3 = seed;
+        u64 v4 = seed - XXH_PRIME64_1;
+
+        do {
+            v1 = XXH64Round(v1, ReadLE64(p));
+            v2 = XXH64Round(v2, ReadLE64(p + 8));
+            v3 = XXH64Round(v3, ReadLE64(p + 16));
+            v4 = XXH64Round(v4, ReadLE64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        h = RotateLeft64(v1, 1) + RotateLeft64(v2, 7) + RotateLeft64(v3, 12) + RotateLeft64(v4, 18);
+        h = XXH64MergeRound(h, v1);
+        h = XXH64MergeRound(h, v2);
+        h = XXH64MergeRound(h, v3);
+        h = XXH64MergeRound(h, v4);
+    } else {
+        h = seed + XXH_PRIME64_5;
+    }
+
+    h += (u64)length;
+
+    while (p + 8 <= end) {
+        h ^= XXH64Round(0, ReadLE64(p));
+        h = RotateLeft64(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+        p += 8;
+    }
+
+    if (p + 4 <= end) {
+        h ^= (u64)ReadLE32(p) * XXH_PRIME64_1;
+        h = RotateLeft64(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        p += 4;
+    }
+
+    while (p < end) {
+        h ^= (*p) * XXH_PRIME64_5;
+        h = RotateLeft64(h, 11) * XXH_PRIME64_1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= XXH_PRIME64_2;
+    h ^= h >> 29;
+    h *= XXH_PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+u32 Crc32(const void* data, size length, u32 crc)
+{
+    local u32 table[256];
+    local bool tableReady = false;
+
+    if (!tableReady) {
+        for (u32 i = 0; i < 256; ++i) {
+            u32 c = i;
+            for (s32 k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        tableReady = true;
+    }
+
+    const u8* p = (const u8*)data;
+    crc = ~crc;
+    for (size i = 0; i < length; ++i) {
+        crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
@@ -0,0 +1,12 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include "utils.h"
+
+// xxHash64 (https://github.com/Cyan4973/xxHash), used to key ROM images and fingerprint frames.
+u64 HashBytes(const void* data, size length, u64 seed);
+
+// CRC-32 (IEEE 802.3, as used by PNG and zip), pass the previous result to continue a running checksum.
+u32 Crc32(const void* data, size length, u32 crc);
+
+#endif // HASH_H
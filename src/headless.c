@@ -1,46 +1,274 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "headless.h"
 #include "nes.h"
 #include "cpu.h"
 #include "cpu_trace.h"
+#include "hash.h"
+#include "image.h"
+#include "media.h"
+#include "apu.h"
+#include "platform.h"
+#include "movie.h"
+#include "thread_pool.h"
 
 #undef nes
 
-int RunHeadless(HeadlessConfig* config)
+// Hashes the RGBA framebuffer as it sits in memory, no per-pixel conversion needed.
+u64 HashFrame(NES* nes)
+{
+    GUI* gui = &nes->gui;
+    return HashBytes(gui->pixels, gui->width * gui->height * sizeof(Color), 0);
+}
+
+void WriteJSONString(FILE* file, const char* value)
+{
+    fputc('"', file);
+    for (const char* c = value ? value : ""; *c; ++c) {
+        switch (*c) {
+            case '"': fputs("\\\"", file); break;
+            case '\\': fputs("\\\\", file); break;
+            case '\n': fputs("\\n", file); break;
+            case '\r': fputs("\\r", file); break;
+            case '\t': fputs("\\t", file); break;
+            default: {
+                if ((u8)*c < 0x20) {
+                    fprintf(file, "\\u%04x", (u8)*c);
+                } else {
+                    fputc(*c, file);
+                }
+                break;
+            }
+        }
+    }
+    fputc('"', file);
+}
+
+// stdout can be taken by the video or the audio stream, the text output goes to stderr then
+internal bool IsHeadlessStdoutStreaming(HeadlessConfig* config)
+{
+    return (config->videoPath && strcmp(config->videoPath, "-") == 0) ||
+           (config->audioPath && strcmp(config->audioPath, "-") == 0);
+}
+
+internal bool ShouldDumpFrame(const char* dumpFrames, u64 frame)
 {
+    const char* c = dumpFrames;
+    while (c && *c) {
+        char* end;
+        u64 value = strtoull(c, &end, 10);
+        if (end == c) {
+            break;
+        }
+
+        if (value == frame) {
+            return true;
+        }
+
+        c = (*end == ',') ? end + 1 : end;
+    }
+    return false;
+}
+
+internal void DumpFrame(NES* nes, HeadlessConfig* config, u64 frame)
+{
+    char path[MAX_PATH_LENGTH];
+    snprintf(path, sizeof(path), "%s_%llu.%s", config->dumpPrefix ? config->dumpPrefix : "frame",
+             (unsigned long long)frame, config->dumpPNG ? "png" : "ppm");
+
+    GUI* gui = &nes->gui;
+    bool written = config->dumpPNG ? WritePNG(path, gui->pixels, gui->width, gui->height)
+                                   : WritePPM(path, gui->pixels, gui->width, gui->height);
+    if (!written) {
+        fprintf(stderr, "Error: Could not write frame dump: %s\n", path);
+    }
+}
+
+s32 RunHeadlessInstance(HeadlessConfig* config, HeadlessResult* result)
+{
+    memset(result, 0, sizeof(HeadlessResult));
+    result->status = 1;
+
     if (!config->romPath) {
         fprintf(stderr, "Error: No ROM path specified for headless mode.\n");
-        return 1;
+        return result->status;
     }
 
     Cartridge cartridge = {0};
     if (!LoadNesRom((char*)config->romPath, &cartridge)) {
         fprintf(stderr, "Error: Could not load ROM: %s\n", config->romPath);
-        return 1;
+        return result->status;
     }
 
     NES* nes = CreateNES(cartridge);
     if (!nes) {
         fprintf(stderr, "Error: Unsupported mapper or failed to create NES.\n");
-        return 1;
+        return result->status;
     }
 
     if (config->startPC != 0) {
         nes->cpu.pc = config->startPC;
     }
 
+    u64 maxFrames = config->maxFrames;
+
+    Movie* movie = NULL;
+    if (config->moviePath) {
+        movie = LoadMovie(config->moviePath);
+        if (!movie) {
+            fprintf(stderr, "Error: Could not load input movie: %s\n", config->moviePath);
+            Destroy(nes);
+            return result->status;
+        }
+
+        if (!PlayMovie(nes, movie)) {
+            fprintf(stderr, "Error: The input movie was recorded with a different ROM: %s\n", config->moviePath);
+            DestroyMovie(movie);
+            Destroy(nes);
+            return result->status;
+        }
+
+        if (maxFrames == 0 && config->maxInstructions == 0 && config->maxCycles == 0) {
+            maxFrames = movie->length;
+        }
+    }
+
     FILE* logFile = NULL;
     if (config->logCPU && config->logPath) {
         logFile = fopen(config->logPath, "w");
         if (!logFile) {
             fprintf(stderr, "Error: Could not open log file: %s\n", config->logPath);
+            DestroyMovie(movie);
             Destroy(nes);
-            return 1;
+            return result->status;
         }
     }
 
+    FILE* frameHashFile = NULL;
+    if (config->frameHashPath) {
+        frameHashFile = fopen(config->frameHashPath, "w");
+        if (!frameHashFile) {
+            fprintf(stderr, "Error: Could not open frame hash file: %s\n", config->frameHashPath);
+            if (logFile) fclose(logFile);
+            DestroyMovie(movie);
+            Destroy(nes);
+            return result->status;
+        }
+    }
+
+    FILE* profileFile = NULL;
+    if (config->profilePath) {
+        if (!PROFILE_ENABLED) {
+            fprintf(stderr, "Warning: built without NES_PROFILE, ignoring --profile-csv\n");
+        } else {
+            profileFile = fopen(config->profilePath, "w");
+            if (!profileFile) {
+                fprintf(stderr, "Error: Could not open profile file: %s\n", config->profilePath);
+                if (frameHashFile) fclose(frameHashFile);
+                if (logFile) fclose(logFile);
+                DestroyMovie(movie);
+                Destroy(nes);
+                return result->status;
+            }
+
+            WriteProfileCSVHeader(profileFile);
+            ResetProfiler();
+        }
+    }
+
+    if (config->hotspotPath) {
+        nes->cpuProfile = CreateCPUProfile(nes);
+    }
+
+    CPUTrace* trace = NULL;
+    if (config->tracePath) {
+        if (config->traceLast > 0) {
+            // the last instructions are kept in a ring mapped onto the file, a crash or an assert doesn't lose them
+            trace = CreateCPUTraceRing(config->traceLast, config->tracePath);
+        } else {
+            // without a limit the ring is only a write buffer for the file
+            trace = CreateCPUTrace(CPU_TRACE_DEFAULT_CAPACITY, config->tracePath);
+        }
+
+        if (!trace) {
+            fprintf(stderr, "Error: Could not create trace file: %s\n", config->tracePath);
+            DestroyCPUProfile(nes->cpuProfile);
+            nes->cpuProfile = NULL;
+            if (profileFile) fclose(profileFile);
+            if (frameHashFile) fclose(frameHashFile);
+            if (logFile) fclose(logFile);
+            DestroyMovie(movie);
+            Destroy(nes);
+            return result->status;
+        }
+    }
+
+    CPUTraceReference reference;
+    bool comparing = false;
+    FILE* compareOutput = IsHeadlessStdoutStreaming(config) ? stderr : stdout;
+    bool diverged = false;
+    if (config->compareTracePath) {
+        comparing = OpenCPUTraceReference(&reference, config->compareTracePath);
+        if (!comparing) {
+            fprintf(stderr, "Error: Could not open reference trace: %s\n", config->compareTracePath);
+            DestroyCPUTrace(trace);
+            DestroyCPUProfile(nes->cpuProfile);
+            nes->cpuProfile = NULL;
+            if (profileFile) fclose(profileFile);
+            if (frameHashFile) fclose(frameHashFile);
+            if (logFile) fclose(logFile);
+            DestroyMovie(movie);
+            Destroy(nes);
+            return result->status;
+        }
+    }
+
+    VideoWriter video;
+    bool writingVideo = false;
+    if (config->videoPath) {
+        writingVideo = OpenVideoWriter(&video, config->videoPath, nes->gui.width, nes->gui.height);
+        if (!writingVideo) {
+            fprintf(stderr, "Error: Could not open video file: %s\n", config->videoPath);
+            if (comparing) CloseCPUTraceReference(&reference);
+            DestroyCPUTrace(trace);
+            DestroyCPUProfile(nes->cpuProfile);
+            nes->cpuProfile = NULL;
+            if (profileFile) fclose(profileFile);
+            if (frameHashFile) fclose(frameHashFile);
+            if (logFile) fclose(logFile);
+            DestroyMovie(movie);
+            Destroy(nes);
+            return result->status;
+        }
+    }
+
+    AudioWriter audio;
+    bool writingAudio = false;
+    if (config->audioPath) {
+        writingAudio = OpenAudioWriter(&audio, config->audioPath, APU_SAMPLES_PER_SECOND);
+        if (!writingAudio) {
+            fprintf(stderr, "Error: Could not open audio file: %s\n", config->audioPath);
+            if (writingVideo) CloseVideoWriter(&video);
+            if (comparing) CloseCPUTraceReference(&reference);
+            DestroyCPUTrace(trace);
+            DestroyCPUProfile(nes->cpuProfile);
+            nes->cpuProfile = NULL;
+            if (profileFile) fclose(profileFile);
+            if (frameHashFile) fclose(frameHashFile);
+            if (logFile) fclose(logFile);
+            DestroyMovie(movie);
+            Destroy(nes);
+            return result->status;
+        }
+        nes->apuOutput->bufferIndex = 0;
+    }
+
+    u64 startTicks = GetTimerTicks();
+    u64 startCycles = nes->cpu.cycles;
     u64 instructionsRun = 0;
+    u64 framesRun = 0;
+    u64 frameCount = nes->ppu.frameCount;
     while (true) {
         if (config->maxInstructions > 0 && instructionsRun >= config->maxInstructions) {
             break;
@@ -48,19 +276,306 @@ int RunHeadless(HeadlessConfig* config)
         if (config->maxCycles > 0 && nes->cpu.cycles >= config->maxCycles) {
             break;
         }
+        if (maxFrames > 0 && framesRun >= maxFrames) {
+            break;
+        }
+
+        // the reference decides how long the run is when it's shorter than the limits
+        if (comparing) {
+            CPUTraceCompare compare = CompareCPUTraceReference(&reference, nes, compareOutput);
+            if (compare != CPU_TRACE_MATCH) {
+                diverged = compare == CPU_TRACE_DIVERGED;
+                break;
+            }
+        }
 
         if (logFile) {
             LogCPUState(nes, logFile);
         }
+        if (trace) {
+            RecordCPUTrace(trace, nes);
+        }
 
         StepCPU(nes);
         instructionsRun++;
+
+        if (nes->ppu.frameCount != frameCount) {
+            frameCount = nes->ppu.frameCount;
+            framesRun++;
+
+            if (profileFile) {
+                WriteProfileCSVFrame(profileFile, EndProfileFrame());
+            }
+
+            if (frameHashFile) {
+                fprintf(frameHashFile, "%llu %016llx\n", (unsigned long long)framesRun,
+                        (unsigned long long)HashFrame(nes));
+            }
+
+            if (config->dumpFrames && ShouldDumpFrame(config->dumpFrames, framesRun)) {
+                DumpFrame(nes, config, framesRun);
+            }
+
+            if (writingVideo) {
+                WriteVideoFrame(&video, nes->gui.pixels);
+            }
+
+            // the output buffer holds more than a frame of samples, it's drained every frame
+            if (writingAudio) {
+                WriteAudioSamples(&audio, nes->apuOutput->buffer, nes->apuOutput->bufferIndex);
+                nes->apuOutput->bufferIndex = 0;
+            }
+
+            FlushBatteryRAM(nes, false);
+        }
+    }
+
+    result->wallSeconds = (f64)(GetTimerTicks() - startTicks) / (f64)GetTimerFrequency();
+    result->frames = framesRun;
+    result->cycles = nes->cpu.cycles - startCycles;
+    result->instructions = instructionsRun;
+    result->frameHash = HashFrame(nes);
+    result->status = diverged ? 1 : 0;
+
+    if (writingVideo && !CloseVideoWriter(&video)) {
+        fprintf(stderr, "Error: Could not write video file: %s\n", config->videoPath);
+        result->status = 1;
+    }
+    if (writingAudio && !CloseAudioWriter(&audio)) {
+        fprintf(stderr, "Error: Could not write audio file: %s\n", config->audioPath);
+        result->status = 1;
+    }
+
+    if (comparing) {
+        if (!diverged) {
+            fprintf(compareOutput, "Trace matches the reference for %llu instructions\n",
+                    (unsigned long long)reference.matched);
+        }
+        CloseCPUTraceReference(&reference);
+    }
+
+    if (trace) {
+        DestroyCPUTrace(trace);
     }
 
+    if (nes->cpuProfile) {
+        FILE* hotspotFile = fopen(config->hotspotPath, "w");
+        if (hotspotFile) {
+            WriteCPUProfileReport(hotspotFile, nes, nes->cpuProfile, CPU_PROFILE_REPORT_LENGTH);
+            fclose(hotspotFile);
+        } else {
+            fprintf(stderr, "Error: Could not open hotspot report: %s\n", config->hotspotPath);
+            result->status = 1;
+        }
+
+        DestroyCPUProfile(nes->cpuProfile);
+        nes->cpuProfile = NULL;
+    }
+
+    if (profileFile) {
+        fclose(profileFile);
+    }
+    if (frameHashFile) {
+        fclose(frameHashFile);
+    }
     if (logFile) {
         fclose(logFile);
     }
+    DestroyMovie(movie);
     Destroy(nes);
 
-    return 0;
+    return result->status;
+}
+
+void WriteHeadlessSummary(FILE* file, HeadlessConfig* config, HeadlessResult* result)
+{
+    f64 seconds = result->wallSeconds > 0 ? result->wallSeconds : 1e-9;
+
+    fputs("{\"rom\":", file);
+    WriteJSONString(file, config->romPath);
+    fprintf(file, ",\"status\":%d", result->status);
+    fprintf(file, ",\"frames\":%llu", (unsigned long long)result->frames);
+    fprintf(file, ",\"cycles\":%llu", (unsigned long long)result->cycles);
+    fprintf(file, ",\"instructions\":%llu", (unsigned long long)result->instructions);
+    fprintf(file, ",\"wall_time_s\":%.6f", result->wallSeconds);
+    fprintf(file, ",\"fps\":%.2f", (f64)result->frames / seconds);
+    fprintf(file, ",\"cycles_per_s\":%.0f", (f64)result->cycles / seconds);
+    fprintf(file, ",\"frame_hash\":\"%016llx\"}\n", (unsigned long long)result->frameHash);
+}
+
+int RunHeadless(HeadlessConfig* config)
+{
+    HeadlessResult result;
+    if (RunHeadlessInstance(config, &result) != 0) {
+        return result.status;
+    }
+
+    // the summary is opt-in for the instruction/cycle driven runs used by the cpu tests
+    if (config->maxFrames > 0 || config->moviePath || config->summaryPath) {
+        FILE* summaryFile = IsHeadlessStdoutStreaming(config) ? stderr : stdout;
+        if (config->summaryPath && strcmp(config->summaryPath, "-") != 0) {
+            summaryFile = fopen(config->summaryPath, "w");
+            if (!summaryFile) {
+                fprintf(stderr, "Error: Could not open summary file: %s\n", config->summaryPath);
+                return 1;
+            }
+        }
+
+        WriteHeadlessSummary(summaryFile, config, &result);
+
+        if (summaryFile != stdout && summaryFile != stderr) {
+            fclose(summaryFile);
+        }
+    }
+
+    return result.status;
+}
+
+typedef struct HeadlessBatch {
+    HeadlessConfig* config;
+    char** romPaths;
+    s32 romCount;
+
+    FILE* output;
+    Mutex outputLock;
+    s32 failures;
+} HeadlessBatch;
+
+internal void RunBatchJob(void* data, s32 job, s32 worker)
+{
+    HeadlessBatch* batch = (HeadlessBatch*)data;
+
+    HeadlessConfig config = *batch->config;
+    config.romPath = batch->romPaths[job];
+
+    HeadlessResult result;
+    RunHeadlessInstance(&config, &result);
+
+    // lines are streamed as ROMs finish, so the output order depends on the run
+    LockMutex(&batch->outputLock);
+    WriteHeadlessSummary(batch->output, &config, &result);
+    fflush(batch->output);
+    if (result.status != 0) {
+        batch->failures++;
+    }
+    UnlockMutex(&batch->outputLock);
+}
+
+s32 ReadPathList(const char* listPath, char*** paths)
+{
+    FILE* file = fopen(listPath, "r");
+    if (!file) {
+        return -1;
+    }
+
+    s32 count = 0;
+    s32 capacity = 0;
+    char** list = NULL;
+
+    char line[MAX_PATH_LENGTH];
+    while (fgets(line, sizeof(line), file)) {
+        char* start = line;
+        while (*start == ' ' || *start == '\t') {
+            start++;
+        }
+
+        size length = strlen(start);
+        while (length > 0 && (start[length - 1] == '\n' || start[length - 1] == '\r' || start[length - 1] == ' ' ||
+                              start[length - 1] == '\t')) {
+            start[--length] = 0;
+        }
+
+        if (length == 0 || start[0] == '#') {
+            continue;
+        }
+
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            char** grown = (char**)Allocate(sizeof(char*) * capacity);
+            if (list) {
+                memcpy(grown, list, sizeof(char*) * count);
+                Free(list);
+            }
+            list = grown;
+        }
+
+        list[count] = (char*)Allocate(length + 1);
+        memcpy(list[count], start, length + 1);
+        count++;
+    }
+
+    fclose(file);
+
+    *paths = list;
+    return count;
+}
+
+void FreePathList(char** paths, s32 count)
+{
+    for (s32 i = 0; i < count; ++i) {
+        Free(paths[i]);
+    }
+
+    if (paths) {
+        Free(paths);
+    }
+}
+
+int RunHeadlessBatch(HeadlessConfig* config, const char* listPath, s32 jobCount)
+{
+    if (config->maxFrames == 0 && config->maxCycles == 0 && config->maxInstructions == 0) {
+        fprintf(stderr, "Error: Batch mode needs --frames, --max-cycles or --max-instructions.\n");
+        return 1;
+    }
+
+    HeadlessBatch batch = {0};
+    batch.romCount = ReadPathList(listPath, &batch.romPaths);
+    if (batch.romCount < 0) {
+        fprintf(stderr, "Error: Could not open batch list: %s\n", listPath);
+        return 1;
+    }
+
+    // per-run outputs and inputs are rejected by the command line, the jobs only differ by ROM
+    batch.config = config;
+
+    batch.output = stdout;
+    if (config->summaryPath && strcmp(config->summaryPath, "-") != 0) {
+        batch.output = fopen(config->summaryPath, "w");
+        if (!batch.output) {
+            fprintf(stderr, "Error: Could not open summary file: %s\n", config->summaryPath);
+            FreePathList(batch.romPaths, batch.romCount);
+            return 1;
+        }
+    }
+
+    InitMutex(&batch.outputLock);
+
+    ThreadPool* pool = CreateThreadPool(jobCount);
+    if (!pool) {
+        fprintf(stderr, "Error: Could not create the thread pool.\n");
+        DestroyMutex(&batch.outputLock);
+        if (batch.output != stdout) {
+            fclose(batch.output);
+        }
+        FreePathList(batch.romPaths, batch.romCount);
+        return 1;
+    }
+
+    u64 startTicks = GetTimerTicks();
+    RunJobs(pool, RunBatchJob, &batch, batch.romCount);
+    f64 wallSeconds = (f64)(GetTimerTicks() - startTicks) / (f64)GetTimerFrequency();
+
+    fprintf(stderr, "Batch: %d ROMs, %d failed, %d threads, %.3f s\n", batch.romCount, batch.failures,
+            pool->workerCount, wallSeconds);
+
+    DestroyThreadPool(pool);
+    DestroyMutex(&batch.outputLock);
+
+    if (batch.output != stdout) {
+        fclose(batch.output);
+    }
+
+    FreePathList(batch.romPaths, batch.romCount);
+
+    return batch.failures > 0 ? 1 : 0;
 }
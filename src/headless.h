@@ -10,9 +10,63 @@ typedef struct HeadlessConfig {
     u16 startPC;
     u64 maxInstructions;
     u64 maxCycles;
+    u64 maxFrames;
     bool logCPU;
+
+    // one "<frame> <hash>" line per completed frame
+    const char* frameHashPath;
+
+    // comma separated frame numbers written to <dumpPrefix>_<frame>.ppm/.png
+    const char* dumpFrames;
+    const char* dumpPrefix;
+    bool dumpPNG;
+
+    // JSON summary destination, stdout when NULL
+    const char* summaryPath;
+
+    // input movie replayed on the controllers, runs its whole length when no other limit is set
+    const char* moviePath;
+
+    // per-frame profiler counters as CSV, only available in builds with NES_PROFILE
+    const char* profilePath;
+
+    // ranked report of the instruction addresses that took the most cycles
+    const char* hotspotPath;
+
+    // binary CPU trace of every instruction, or of the last traceLast ones when set
+    const char* tracePath;
+    u32 traceLast;
+
+    // nestest-style log the CPU is compared against, the run stops at the first difference
+    const char* compareTracePath;
+
+    // every frame as .y4m video and the APU output as .wav, "-" streams to stdout
+    const char* videoPath;
+    const char* audioPath;
 } HeadlessConfig;
 
+typedef struct HeadlessResult {
+    s32 status;
+    u64 frames;
+    u64 cycles;
+    u64 instructions;
+    f64 wallSeconds;
+    u64 frameHash;
+} HeadlessResult;
+
+u64 HashFrame(NES* nes);
+void WriteJSONString(FILE* file, const char* value);
+s32 RunHeadlessInstance(HeadlessConfig* config, HeadlessResult* result);
+void WriteHeadlessSummary(FILE* file, HeadlessConfig* config, HeadlessResult* result);
 int RunHeadless(HeadlessConfig* config);
 
+// Reads a list of paths, one per line, skipping blank lines and lines starting with #. Returns -1 when
+// the file can't be opened.
+s32 ReadPathList(const char* listPath, char*** paths);
+void FreePathList(char** paths, s32 count);
+
+// Runs every ROM listed in listPath (one path per line, # starts a comment) on jobCount threads
+// with the limits in config, writing one JSON summary line per ROM as each one finishes.
+int RunHeadlessBatch(HeadlessConfig* config, const char* listPath, s32 jobCount);
+
 #endif // HEADLESS_H
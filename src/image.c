@@ -0,0 +1,133 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <string.h>
+
+#include "image.h"
+#include "hash.h"
+
+bool WritePPM(const char* filePath, Color* pixels, u32 width, u32 height)
+{
+    FILE* file = fopen(filePath, "wb");
+    if (!file) {
+        return false;
+    }
+
+    fprintf(file, "P6\n%u %u\n255\n", width, height);
+
+    u8 row[256 * 3];
+    for (u32 y = 0; y < height; ++y) {
+        u32 x = 0;
+        while (x < width) {
+            u32 count = MIN(width - x, 256);
+            for (u32 i = 0; i < count; ++i) {
+                Color c = pixels[y * width + x + i];
+                row[i * 3 + 0] = c.r;
+                row[i * 3 + 1] = c.g;
+                row[i * 3 + 2] = c.b;
+            }
+            fwrite(row, sizeof(u8), count * 3, file);
+            x += count;
+        }
+    }
+
+    fclose(file);
+    return true;
+}
+
+internal void WriteU32BE(u8* p, u32 value)
+{
+    p[0] = (u8)(value >> 24);
+    p[1] = (u8)(value >> 16);
+    p[2] = (u8)(value >> 8);
+    p[3] = (u8)value;
+}
+
+internal void WritePNGChunk(FILE* file, const char* type, u8* data, u32 length)
+{
+    u8 header[8];
+    WriteU32BE(header, length);
+    memcpy(header + 4, type, 4);
+    fwrite(header, sizeof(u8), 8, file);
+    fwrite(data, sizeof(u8), length, file);
+
+    u32 crc = Crc32(type, 4, 0);
+    crc = Crc32(data, length, crc);
+
+    u8 footer[4];
+    WriteU32BE(footer, crc);
+    fwrite(footer, sizeof(u8), 4, file);
+}
+
+// The image data is zlib with stored (uncompressed) deflate blocks, one per scanline.
+// Dumps are written rarely and stay readable by any decoder, so there's no compressor here.
+bool WritePNG(const char* filePath, Color* pixels, u32 width, u32 height)
+{
+    u32 rowLength = 1 + width * 3;
+    if (rowLength > 0xFFFF) {
+        return false;
+    }
+
+    u32 idatLength = 2 + height * (5 + rowLength) + 4;
+    u8* idat = (u8*)Allocate(idatLength);
+    if (!idat) {
+        return false;
+    }
+
+    FILE* file = fopen(filePath, "wb");
+    if (!file) {
+        Free(idat);
+        return false;
+    }
+
+    u8* p = idat;
+    *p++ = 0x78; // deflate, 32K window
+    *p++ = 0x01; // no preset dictionary, fastest
+
+    u32 adlerA = 1;
+    u32 adlerB = 0;
+
+    for (u32 y = 0; y < height; ++y) {
+        *p++ = (y == height - 1) ? 1 : 0; // BFINAL, BTYPE = stored
+        *p++ = (u8)(rowLength & 0xFF);
+        *p++ = (u8)(rowLength >> 8);
+        *p++ = (u8)(~rowLength & 0xFF);
+        *p++ = (u8)((~rowLength >> 8) & 0xFF);
+
+        u8* row = p;
+        *p++ = 0; // filter: none
+        for (u32 x = 0; x < width; ++x) {
+            Color c = pixels[y * width + x];
+            *p++ = c.r;
+            *p++ = c.g;
+            *p++ = c.b;
+        }
+
+        for (u32 i = 0; i < rowLength; ++i) {
+            adlerA = (adlerA + row[i]) % 65521;
+            adlerB = (adlerB + adlerA) % 65521;
+        }
+    }
+
+    WriteU32BE(p, (adlerB << 16) | adlerA);
+
+    local const u8 signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    fwrite(signature, sizeof(u8), 8, file);
+
+    u8 ihdr[13];
+    WriteU32BE(ihdr, width);
+    WriteU32BE(ihdr + 4, height);
+    ihdr[8] = 8;  // bit depth
+    ihdr[9] = 2;  // color type: RGB
+    ihdr[10] = 0; // compression
+    ihdr[11] = 0; // filter
+    ihdr[12] = 0; // interlace
+    WritePNGChunk(file, "IHDR", ihdr, sizeof(ihdr));
+    WritePNGChunk(file, "IDAT", idat, idatLength);
+    WritePNGChunk(file, "IEND", NULL, 0);
+
+    fclose(file);
+    Free(idat);
+    return true;
+}
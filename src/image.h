@@ -0,0 +1,10 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include "utils.h"
+
+// Writers for framebuffer dumps, both drop the alpha channel.
+bool WritePPM(const char* filePath, Color* pixels, u32 width, u32 height);
+bool WritePNG(const char* filePath, Color* pixels, u32 width, u32 height);
+
+#endif // IMAGE_H
@@ -0,0 +1,242 @@
+/*
+ * libnes: the core unity build plus the public API in libnes.h, compiled on its own into
+ * build/libnes.a and build/libnes.dll (nob.exe libnes).
+ */
+
+#include "core.c"
+#include "libnes.h"
+
+struct LibNES {
+    NES* nes;
+    s32 sampleCount; // samples produced by the last frame
+
+    // video outputs, applied again to every rom loaded
+    bool skipPixels;
+    bool lumaEnabled;
+    PPULumaOutput luma;
+    u8 lumaPixels[PPU_SCREEN_WIDTH * PPU_SCREEN_HEIGHT];
+};
+
+LibNES* LibNESCreate(void)
+{
+    LibNES* handle = (LibNES*)Allocate(sizeof(LibNES));
+    if (handle) {
+        memset(handle, 0, sizeof(LibNES));
+    }
+    return handle;
+}
+
+internal void UnloadLibNES(LibNES* handle)
+{
+    if (handle->nes) {
+        Destroy(handle->nes);
+        handle->nes = NULL;
+    }
+    handle->sampleCount = 0;
+}
+
+void LibNESDestroy(LibNES* handle)
+{
+    if (handle) {
+        UnloadLibNES(handle);
+        Free(handle);
+    }
+}
+
+internal void ApplyLibNESVideoOutput(LibNES* handle)
+{
+    if (handle->nes) {
+        handle->nes->gui.skipPixels = handle->skipPixels;
+        handle->nes->gui.luma = handle->lumaEnabled ? &handle->luma : NULL;
+    }
+}
+
+internal bool StartLibNES(LibNES* handle, Cartridge cartridge)
+{
+    UnloadLibNES(handle);
+    handle->nes = CreateNES(cartridge);
+    ApplyLibNESVideoOutput(handle);
+    return handle->nes != NULL;
+}
+
+bool LibNESLoadROM(LibNES* handle, const char* path)
+{
+    Cartridge cartridge = {0};
+    if (!LoadNesRom((char*)path, &cartridge)) {
+        return false;
+    }
+
+    return StartLibNES(handle, cartridge);
+}
+
+bool LibNESLoadROMFromMemory(LibNES* handle, const void* data, size_t length)
+{
+    Cartridge cartridge = {0};
+    if (!LoadNesRomFromMemory((const u8*)data, (u32)length, &cartridge)) {
+        return false;
+    }
+
+    return StartLibNES(handle, cartridge);
+}
+
+bool LibNESIsLoaded(LibNES* handle)
+{
+    return handle->nes != NULL;
+}
+
+void LibNESReset(LibNES* handle)
+{
+    if (handle->nes) {
+        ResetNES(handle->nes);
+    }
+}
+
+bool LibNESRunFrame(LibNES* handle)
+{
+    NES* nes = handle->nes;
+    if (!nes) {
+        return false;
+    }
+
+    // the output buffer is a ring that holds more than a frame of audio, it's drained every frame
+    nes->apuOutput->bufferIndex = 0;
+
+    u64 frameCount = nes->ppu.frameCount;
+    while (nes->ppu.frameCount == frameCount) {
+        StepCPU(nes);
+    }
+
+    handle->sampleCount = nes->apuOutput->bufferIndex;
+    FlushBatteryRAM(nes, false);
+    return true;
+}
+
+uint64_t LibNESGetFrameCount(LibNES* handle)
+{
+    return handle->nes ? handle->nes->ppu.frameCount : 0;
+}
+
+const uint8_t* LibNESGetFramebuffer(LibNES* handle)
+{
+    return handle->nes ? (const uint8_t*)handle->nes->gui.pixels : NULL;
+}
+
+bool LibNESSetVideoOutput(LibNES* handle, bool rgba, int lumaWidth, int lumaHeight)
+{
+    bool lumaEnabled = lumaWidth > 0 && lumaHeight > 0;
+    if (lumaEnabled && !InitPPULumaOutput(&handle->luma, handle->lumaPixels, lumaWidth, lumaHeight)) {
+        return false;
+    }
+
+    if (lumaEnabled) {
+        memset(handle->lumaPixels, 0, sizeof(handle->lumaPixels));
+    }
+
+    handle->skipPixels = !rgba;
+    handle->lumaEnabled = lumaEnabled;
+    ApplyLibNESVideoOutput(handle);
+    return true;
+}
+
+const uint8_t* LibNESGetLuma(LibNES* handle)
+{
+    return handle->lumaEnabled ? handle->lumaPixels : NULL;
+}
+
+const int16_t* LibNESGetAudio(LibNES* handle, int* sampleCount)
+{
+    if (!handle->nes) {
+        *sampleCount = 0;
+        return NULL;
+    }
+
+    *sampleCount = handle->sampleCount;
+    return handle->nes->apuOutput->buffer;
+}
+
+const uint8_t* LibNESGetRAM(LibNES* handle)
+{
+    return handle->nes ? handle->nes->cpuRAM : NULL;
+}
+
+void LibNESSetInput(LibNES* handle, int port, uint8_t buttons)
+{
+    if (handle->nes && port >= 0 && port < 2) {
+        handle->nes->controllers[port].state = buttons;
+    }
+}
+
+size_t LibNESGetSnapshotSize(LibNES* handle)
+{
+    return handle->nes ? GetSnapshotSize(handle->nes) : 0;
+}
+
+bool LibNESSnapshot(LibNES* handle, void* buffer, size_t bufferSize)
+{
+    if (!handle->nes || bufferSize < GetSnapshotSize(handle->nes)) {
+        return false;
+    }
+
+    SnapshotNES(handle->nes, (u8*)buffer);
+    return true;
+}
+
+bool LibNESRestore(LibNES* handle, const void* buffer, size_t bufferSize)
+{
+    if (!handle->nes || bufferSize < GetSnapshotSize(handle->nes)) {
+        return false;
+    }
+
+    RestoreNES(handle->nes, (u8*)buffer);
+    return true;
+}
+
+LibNESBatch* LibNESCreateBatch(const char* romPath, const LibNESBatchConfig* config)
+{
+    if (config->hookCount < 0 || config->hookCount > NES_BATCH_MAX_HOOKS) {
+        return NULL;
+    }
+
+    NESBatchConfig batchConfig = {0};
+    batchConfig.instanceCount = config->instanceCount;
+    batchConfig.workerCount = config->workerCount;
+    batchConfig.framesPerStep = config->framesPerStep;
+    batchConfig.observation = config->grayscale ? NES_OBSERVATION_GRAYSCALE : NES_OBSERVATION_INDICES;
+    batchConfig.width = config->width;
+    batchConfig.height = config->height;
+    batchConfig.hookCount = config->hookCount;
+
+    for (s32 i = 0; i < config->hookCount; i++) {
+        batchConfig.hooks[i].address = config->hooks[i].address;
+        batchConfig.hooks[i].length = config->hooks[i].length;
+        batchConfig.hooks[i].bcd = config->hooks[i].bcd;
+        batchConfig.hooks[i].scale = config->hooks[i].scale;
+    }
+
+    Cartridge cartridge = {0};
+    if (!LoadNesRom((char*)romPath, &cartridge)) {
+        return NULL;
+    }
+
+    return (LibNESBatch*)CreateNESBatch(cartridge, &batchConfig);
+}
+
+void LibNESDestroyBatch(LibNESBatch* batch)
+{
+    DestroyNESBatch((NESBatch*)batch);
+}
+
+size_t LibNESGetBatchObservationSize(LibNESBatch* batch)
+{
+    return GetNESBatchObservationSize((NESBatch*)batch);
+}
+
+void LibNESResetBatchInstance(LibNESBatch* batch, int index)
+{
+    ResetNESBatchInstance((NESBatch*)batch, index);
+}
+
+void LibNESStepBatch(LibNESBatch* batch, const uint8_t* inputs, uint8_t* observations, float* rewards)
+{
+    StepNESBatch((NESBatch*)batch, inputs, observations, rewards);
+}
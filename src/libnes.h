@@ -0,0 +1,129 @@
+#ifndef LIBNES_H
+#define LIBNES_H
+
+/*
+ * libnes: the emulator core as a library, without SDL, OpenGL or ImGui. This header only uses
+ * standard types so programs can use it without the rest of the sources.
+ *
+ *     LibNES* nes = LibNESCreate();
+ *     LibNESLoadROM(nes, "game.nes");
+ *     while (running) {
+ *         LibNESSetInput(nes, 0, LIBNES_BUTTON_START);
+ *         LibNESRunFrame(nes);
+ *         const uint8_t* rgba = LibNESGetFramebuffer(nes);
+ *         const int16_t* samples = LibNESGetAudio(nes, &sampleCount);
+ *     }
+ *     LibNESDestroy(nes);
+ *
+ * An instance isn't thread safe, but separate instances can run on separate threads.
+ * Build with LIBNES_SHARED defined to export the functions from a DLL.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(LIBNES_SHARED) && defined(_WIN32)
+#define LIBNES_API __declspec(dllexport)
+#elif defined(LIBNES_SHARED)
+#define LIBNES_API __attribute__((visibility("default")))
+#else
+#define LIBNES_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LIBNES_SCREEN_WIDTH 256
+#define LIBNES_SCREEN_HEIGHT 240
+#define LIBNES_SAMPLE_RATE 48000
+#define LIBNES_RAM_SIZE 0x800
+
+// Controller bits for LibNESSetInput, in the order the pads shift them out.
+#define LIBNES_BUTTON_A (1 << 0)
+#define LIBNES_BUTTON_B (1 << 1)
+#define LIBNES_BUTTON_SELECT (1 << 2)
+#define LIBNES_BUTTON_START (1 << 3)
+#define LIBNES_BUTTON_UP (1 << 4)
+#define LIBNES_BUTTON_DOWN (1 << 5)
+#define LIBNES_BUTTON_LEFT (1 << 6)
+#define LIBNES_BUTTON_RIGHT (1 << 7)
+
+typedef struct LibNES LibNES;
+
+LIBNES_API LibNES* LibNESCreate(void);
+LIBNES_API void LibNESDestroy(LibNES* handle);
+
+// Loading replaces the running game, false when the file isn't an iNES rom with a supported mapper.
+LIBNES_API bool LibNESLoadROM(LibNES* handle, const char* path);
+LIBNES_API bool LibNESLoadROMFromMemory(LibNES* handle, const void* data, size_t length);
+LIBNES_API bool LibNESIsLoaded(LibNES* handle);
+LIBNES_API void LibNESReset(LibNES* handle);
+
+// Runs until the PPU finishes the current frame.
+LIBNES_API bool LibNESRunFrame(LibNES* handle);
+LIBNES_API uint64_t LibNESGetFrameCount(LibNES* handle);
+
+// 256x240 RGBA pixels of the last frame, valid until the instance is destroyed or another rom is loaded.
+LIBNES_API const uint8_t* LibNESGetFramebuffer(LibNES* handle);
+// Chooses what the PPU renders: the RGBA framebuffer (on by default) and/or a lumaWidth x lumaHeight
+// grayscale frame (up to the screen size, 0 turns it off). Without RGBA the framebuffer isn't updated.
+LIBNES_API bool LibNESSetVideoOutput(LibNES* handle, bool rgba, int lumaWidth, int lumaHeight);
+// The grayscale frame, NULL when it's off.
+LIBNES_API const uint8_t* LibNESGetLuma(LibNES* handle);
+// Mono samples at LIBNES_SAMPLE_RATE produced by the last LibNESRunFrame.
+LIBNES_API const int16_t* LibNESGetAudio(LibNES* handle, int* sampleCount);
+// The 2 KB of CPU RAM, for reading game state.
+LIBNES_API const uint8_t* LibNESGetRAM(LibNES* handle);
+
+// buttons is a mask of LIBNES_BUTTON_* for controller port 0 or 1.
+LIBNES_API void LibNESSetInput(LibNES* handle, int port, uint8_t buttons);
+
+// Snapshots hold the whole emulation state and are only valid for the rom that is loaded.
+LIBNES_API size_t LibNESGetSnapshotSize(LibNES* handle);
+LIBNES_API bool LibNESSnapshot(LibNES* handle, void* buffer, size_t bufferSize);
+LIBNES_API bool LibNESRestore(LibNES* handle, const void* buffer, size_t bufferSize);
+
+// Lock-step batches: instanceCount copies of one game stepped together on a thread pool, every step
+// writes one observation per instance into the caller's tensor and a reward from RAM values.
+#define LIBNES_BATCH_MAX_HOOKS 8
+
+// reward += scale * change of the value at address (length bytes, little-endian, BCD when bcd is set)
+typedef struct LibNESRewardHook {
+    uint16_t address;
+    uint8_t length;
+    bool bcd;
+    float scale;
+} LibNESRewardHook;
+
+typedef struct LibNESBatchConfig {
+    int instanceCount;
+    int workerCount; // 0 uses one worker per processor
+    int framesPerStep;
+
+    // 240x256 palette indices per instance, or height x width luma when grayscale is set
+    bool grayscale;
+    int width;
+    int height;
+
+    int hookCount;
+    LibNESRewardHook hooks[LIBNES_BATCH_MAX_HOOKS];
+} LibNESBatchConfig;
+
+typedef struct LibNESBatch LibNESBatch;
+
+LIBNES_API LibNESBatch* LibNESCreateBatch(const char* romPath, const LibNESBatchConfig* config);
+LIBNES_API void LibNESDestroyBatch(LibNESBatch* batch);
+// Bytes of one instance observation.
+LIBNES_API size_t LibNESGetBatchObservationSize(LibNESBatch* batch);
+LIBNES_API void LibNESResetBatchInstance(LibNESBatch* batch, int index);
+// inputs: 2 controller bytes per instance, observations: instanceCount observations,
+// rewards: instanceCount values or NULL. Doesn't allocate.
+LIBNES_API void LibNESStepBatch(LibNESBatch* batch, const uint8_t* inputs, uint8_t* observations, float* rewards);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBNES_H
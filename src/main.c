@@ -2,6 +2,13 @@
 #define _CRT_SECURE_NO_WARNINGS
 #endif
 
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L // for platform.c
+#endif
+#if defined(__APPLE__) && !defined(_DARWIN_C_SOURCE)
+#define _DARWIN_C_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -21,6 +28,7 @@
 #include "cpu.h"
 #include "cpu_debug.h"
 #include "cpu_trace.h"
+#include "cpu_profile.h"
 #include "ppu.h"
 #include "ppu_debug.h"
 #include "apu.h"
@@ -36,6 +44,16 @@
 #include "memory.h"
 #include "oam.h"
 #include "headless.h"
+#include "platform.h"
+#include "profile.h"
+#include "hash.h"
+#include "rom_cache.h"
+#include "image.h"
+#include "media.h"
+#include "movie.h"
+#include "thread_pool.h"
+#include "test_runner.h"
+#include "emu_thread.h"
 
 #define nes (app.runtime.nes)
 
@@ -134,6 +152,34 @@ internal void BuildSavePath(const char* sourcePath, char* dest, size_t destSize)
     strncat(dest, ".nsave", destSize - strlen(dest) - 1);
 }
 
+// The game goes to the emulation thread, the UI thread keeps a clone of it for the debugger panels.
+internal bool StartGame(SDL_Window* win, NES* game, bool fromSnapshot)
+{
+    NES* view = NESClone(game);
+    if (view && !AttachDebug(view)) {
+        Destroy(view);
+        view = NULL;
+    }
+
+    EmuCommand command = {0};
+    command.type = EMU_COMMAND_LOAD;
+    command.game = game;
+    command.gameId = app.runtime.gameId + 1;
+    command.fromSnapshot = fromSnapshot;
+
+    if (!view || !PostEmuCommand(app.runtime.emu, &command)) {
+        SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "Error", "The game couldn't be started!", win);
+        if (view) Destroy(view);
+        Destroy(game);
+        return false;
+    }
+
+    if (nes) Destroy(nes);
+    nes = view;
+    app.runtime.gameId = command.gameId;
+    return true;
+}
+
 internal bool LoadFileIntoApp(SDL_Window* win, const char* path)
 {
     if (!path || !path[0]) return false;
@@ -143,16 +189,15 @@ internal bool LoadFileIntoApp(SDL_Window* win, const char* path)
             SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "Error", "The file couldn't be loaded!", win);
             return false;
         }
-        if (nes) Destroy(nes);
-        nes = CreateNES(cartridge);
-        if (!nes) {
+        NES* game = CreateNES(cartridge);
+        if (!game) {
             SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "Unsupported mapper",
                                      "This ROM uses a mapper that is not implemented yet.", win);
             return false;
         }
-        hitRun = false;
+        MapBatterySave(game, false);
+        if (!StartGame(win, game, false)) return false;
         debugging = true;
-        stepping = false;
         CopyString(loadedFilePath, sizeof(loadedFilePath), path);
         BuildSavePath(path, saveFilePath, sizeof(saveFilePath));
         UpdateWindowTitle(win, path);
@@ -164,8 +209,9 @@ internal bool LoadFileIntoApp(SDL_Window* win, const char* path)
             SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "Error", "The file couldn't be loaded!", win);
             return false;
         }
-        if (nes) Destroy(nes);
-        nes = loaded;
+        // the SRAM of the save state replaces the .sav
+        MapBatterySave(loaded, true);
+        if (!StartGame(win, loaded, true)) return false;
         CopyString(loadedFilePath, sizeof(loadedFilePath), path);
         CopyString(saveFilePath, sizeof(saveFilePath), path);
         if (nes->cartridge.path[0]) CopyString(loadedFilePath, sizeof(loadedFilePath), nes->cartridge.path);
@@ -176,10 +222,10 @@ internal bool LoadFileIntoApp(SDL_Window* win, const char* path)
     return false;
 }
 
-internal void QueueAudioBuffer(APU* apu, SDL_AudioDeviceID audioDeviceId, SDL_AudioStream* audioStream)
+internal void QueueAudioBuffer(APUOutput* output, SDL_AudioDeviceID audioDeviceId, SDL_AudioStream* audioStream)
 {
     if (!audioDeviceId) return;
-    s32 bytesToQueue = apu->bufferIndex * APU_BYTES_PER_SAMPLE;
+    s32 bytesToQueue = output->bufferIndex * APU_BYTES_PER_SAMPLE;
 
 // Queue backpressure: even with a perfectly-timed sample accumulator the
 // host audio clock and the emulation clock are never 100% identical.  If
@@ -202,7 +248,7 @@ internal void QueueAudioBuffer(APU* apu, SDL_AudioDeviceID audioDeviceId, SDL_Au
     if (queuedBytes > APU_MAX_QUEUED_BYTES) return; // let hardware catch up
 
     if (audioStream) {
-        if (SDL_AudioStreamPut(audioStream, apu->buffer, bytesToQueue) == 0) {
+        if (SDL_AudioStreamPut(audioStream, output->buffer, bytesToQueue) == 0) {
             s32 convertedBytes = SDL_AudioStreamAvailable(audioStream);
             if (convertedBytes > 0) {
                 u8* convertedBuffer = (u8*)SDL_malloc(convertedBytes);
@@ -213,34 +259,86 @@ internal void QueueAudioBuffer(APU* apu, SDL_AudioDeviceID audioDeviceId, SDL_Au
                 }
             }
         }
-    } else SDL_QueueAudio(audioDeviceId, apu->buffer, bytesToQueue);
+    } else SDL_QueueAudio(audioDeviceId, output->buffer, bytesToQueue);
+}
+
+typedef struct AudioSink {
+    SDL_AudioDeviceID deviceId;
+    SDL_AudioStream* stream;
+    s32 frameBytes; // one sample of every channel, in the device format
+    s32 frequency;
+} AudioSink;
+
+// Runs on the emulation thread, SDL locks the device around the queue.
+internal void QueueEmuAudio(void* data, APUOutput* output)
+{
+    AudioSink* sink = (AudioSink*)data;
+    QueueAudioBuffer(output, sink->deviceId, sink->stream);
+}
+
+internal s32 GetQueuedEmuAudio(void* data)
+{
+    AudioSink* sink = (AudioSink*)data;
+    if (!sink->deviceId) return -1;
+
+    // the queue holds samples already converted to the device format
+    u64 queuedFrames = SDL_GetQueuedAudioSize(sink->deviceId) / sink->frameBytes;
+    return (s32)(queuedFrames * APU_SAMPLES_PER_SECOND / sink->frequency);
 }
 
+// The game latches this state whenever it strobes the pads, it's updated right after the events are handled.
 internal void UpdateControllerInput(SDL_GameController* controller)
 {
     const Uint8* keyboard = SDL_GetKeyboardState(NULL);
+    u8 state = 0;
 
-    SetButton(nes, 0, BUTTON_UP, keyboard[SDL_SCANCODE_UP] || coarseButtons[1]);
-    SetButton(nes, 0, BUTTON_DOWN, keyboard[SDL_SCANCODE_DOWN] || coarseButtons[3]);
-    SetButton(nes, 0, BUTTON_LEFT, keyboard[SDL_SCANCODE_LEFT] || coarseButtons[0]);
-    SetButton(nes, 0, BUTTON_RIGHT, keyboard[SDL_SCANCODE_RIGHT] || coarseButtons[2]);
-    SetButton(nes, 0, BUTTON_SELECT, keyboard[SDL_SCANCODE_SPACE] || coarseButtons[4]);
-    SetButton(nes, 0, BUTTON_START, keyboard[SDL_SCANCODE_RETURN] || coarseButtons[5]);
-    SetButton(nes, 0, BUTTON_B, keyboard[SDL_SCANCODE_S] || coarseButtons[6]);
-    SetButton(nes, 0, BUTTON_A, keyboard[SDL_SCANCODE_A] || coarseButtons[7]);
+    if (keyboard[SDL_SCANCODE_UP] || coarseButtons[1]) SetBitFlag(&state, BUTTON_UP);
+    if (keyboard[SDL_SCANCODE_DOWN] || coarseButtons[3]) SetBitFlag(&state, BUTTON_DOWN);
+    if (keyboard[SDL_SCANCODE_LEFT] || coarseButtons[0]) SetBitFlag(&state, BUTTON_LEFT);
+    if (keyboard[SDL_SCANCODE_RIGHT] || coarseButtons[2]) SetBitFlag(&state, BUTTON_RIGHT);
+    if (keyboard[SDL_SCANCODE_SPACE] || coarseButtons[4]) SetBitFlag(&state, BUTTON_SELECT);
+    if (keyboard[SDL_SCANCODE_RETURN] || coarseButtons[5]) SetBitFlag(&state, BUTTON_START);
+    if (keyboard[SDL_SCANCODE_S] || coarseButtons[6]) SetBitFlag(&state, BUTTON_B);
+    if (keyboard[SDL_SCANCODE_A] || coarseButtons[7]) SetBitFlag(&state, BUTTON_A);
 
     if (controller) {
-        if (SDL_GameControllerGetButton(controller, SDL_CONTROLLER_BUTTON_A)) SetButton(nes, 0, BUTTON_A, true);
-        if (SDL_GameControllerGetButton(controller, SDL_CONTROLLER_BUTTON_X)) SetButton(nes, 0, BUTTON_B, true);
-        if (SDL_GameControllerGetButton(controller, SDL_CONTROLLER_BUTTON_START)) SetButton(nes, 0, BUTTON_START, true);
-        if (SDL_GameControllerGetButton(controller, SDL_CONTROLLER_BUTTON_BACK)) SetButton(nes, 0, BUTTON_SELECT, true);
-        if (SDL_GameControllerGetButton(controller, SDL_CONTROLLER_BUTTON_DPAD_UP)) SetButton(nes, 0, BUTTON_UP, true);
+        if (SDL_GameControllerGetButton(controller, SDL_CONTROLLER_BUTTON_A)) SetBitFlag(&state, BUTTON_A);
+        if (SDL_GameControllerGetButton(controller, SDL_CONTROLLER_BUTTON_X)) SetBitFlag(&state, BUTTON_B);
+        if (SDL_GameControllerGetButton(controller, SDL_CONTROLLER_BUTTON_START)) SetBitFlag(&state, BUTTON_START);
+        if (SDL_GameControllerGetButton(controller, SDL_CONTROLLER_BUTTON_BACK)) SetBitFlag(&state, BUTTON_SELECT);
+        if (SDL_GameControllerGetButton(controller, SDL_CONTROLLER_BUTTON_DPAD_UP)) SetBitFlag(&state, BUTTON_UP);
         if (SDL_GameControllerGetButton(controller, SDL_CONTROLLER_BUTTON_DPAD_DOWN))
-            SetButton(nes, 0, BUTTON_DOWN, true);
+            SetBitFlag(&state, BUTTON_DOWN);
         if (SDL_GameControllerGetButton(controller, SDL_CONTROLLER_BUTTON_DPAD_LEFT))
-            SetButton(nes, 0, BUTTON_LEFT, true);
+            SetBitFlag(&state, BUTTON_LEFT);
         if (SDL_GameControllerGetButton(controller, SDL_CONTROLLER_BUTTON_DPAD_RIGHT))
-            SetButton(nes, 0, BUTTON_RIGHT, true);
+            SetBitFlag(&state, BUTTON_RIGHT);
+    }
+
+    SetEmuInput(app.runtime.emu, state, 0);
+}
+
+// Picks up the newest frame of the emulation thread and brings the debugger's clone up to it.
+internal void ReceiveEmuFrame(void)
+{
+    bool newFrame;
+    EmuFrame* frame = AcquireEmuFrame(app.runtime.emu, &newFrame);
+    app.runtime.frame = frame;
+
+    if (!frame || !newFrame) {
+        return;
+    }
+
+    debugging = frame->paused;
+
+    // frames of the game that was replaced can still be in flight
+    if (nes && frame->gameId == app.runtime.gameId) {
+        RestoreEmuView(nes, frame);
+    }
+
+    if (frame->profile.seconds > 0) {
+        app.runtime.emuProfiles[app.runtime.emuProfileCount % PROFILE_HISTORY_LENGTH] = frame->profile;
+        app.runtime.emuProfileCount++;
     }
 }
 
@@ -253,6 +351,25 @@ int main(int argc, char** argv)
     u16 startPC = 0;
     u64 maxInstructions = 0;
     u64 maxCycles = 0;
+    u64 maxFrames = 0;
+    const char* frameHashPath = NULL;
+    const char* dumpFrames = NULL;
+    const char* dumpPrefix = NULL;
+    bool dumpPNG = false;
+    const char* summaryPath = NULL;
+    const char* moviePath = NULL;
+    const char* profilePath = NULL;
+    const char* hotspotPath = NULL;
+    const char* tracePath = NULL;
+    u32 traceLast = 0;
+    const char* compareTracePath = NULL;
+    const char* videoPath = NULL;
+    const char* audioPath = NULL;
+    const char* batchPath = NULL;
+    s32 jobCount = 0;
+    const char* testPath = NULL;
+    const char* reportPath = NULL;
+    const char* pacingName = NULL;
     const char* romPath = NULL;
 
     int parse_argc = argc;
@@ -288,6 +405,126 @@ int main(int argc, char** argv)
                 return 1;
             }
             maxCycles = strtoull(shift_args(&parse_argc, &parse_argv), NULL, 0);
+        } else if (strncmp(flag, "--frames", strlen("--frames")) == 0) {
+            if (parse_argc == 0) {
+                fprintf(stderr, "Error: --frames requires a value\n");
+                return 1;
+            }
+            maxFrames = strtoull(shift_args(&parse_argc, &parse_argv), NULL, 0);
+        } else if (strncmp(flag, "--frame-hashes", strlen("--frame-hashes")) == 0) {
+            if (parse_argc == 0) {
+                fprintf(stderr, "Error: --frame-hashes requires a path\n");
+                return 1;
+            }
+            frameHashPath = shift_args(&parse_argc, &parse_argv);
+        } else if (strncmp(flag, "--dump-frames", strlen("--dump-frames")) == 0) {
+            if (parse_argc == 0) {
+                fprintf(stderr, "Error: --dump-frames requires a comma separated list of frames\n");
+                return 1;
+            }
+            dumpFrames = shift_args(&parse_argc, &parse_argv);
+        } else if (strncmp(flag, "--dump-prefix", strlen("--dump-prefix")) == 0) {
+            if (parse_argc == 0) {
+                fprintf(stderr, "Error: --dump-prefix requires a path\n");
+                return 1;
+            }
+            dumpPrefix = shift_args(&parse_argc, &parse_argv);
+        } else if (strncmp(flag, "--dump-format", strlen("--dump-format")) == 0) {
+            if (parse_argc == 0) {
+                fprintf(stderr, "Error: --dump-format requires ppm or png\n");
+                return 1;
+            }
+            dumpPNG = strcmp(shift_args(&parse_argc, &parse_argv), "png") == 0;
+        } else if (strncmp(flag, "--dump-video", strlen("--dump-video")) == 0) {
+            if (parse_argc == 0) {
+                fprintf(stderr, "Error: --dump-video requires a .y4m path or -\n");
+                return 1;
+            }
+            videoPath = shift_args(&parse_argc, &parse_argv);
+        } else if (strncmp(flag, "--dump-audio", strlen("--dump-audio")) == 0) {
+            if (parse_argc == 0) {
+                fprintf(stderr, "Error: --dump-audio requires a .wav path or -\n");
+                return 1;
+            }
+            audioPath = shift_args(&parse_argc, &parse_argv);
+        } else if (strncmp(flag, "--summary", strlen("--summary")) == 0) {
+            if (parse_argc == 0) {
+                fprintf(stderr, "Error: --summary requires a path or -\n");
+                return 1;
+            }
+            summaryPath = shift_args(&parse_argc, &parse_argv);
+        } else if (strncmp(flag, "--record-movie", strlen("--record-movie")) == 0) {
+            if (parse_argc == 0) {
+                fprintf(stderr, "Error: --record-movie requires a path\n");
+                return 1;
+            }
+            CopyString(recordMoviePath, sizeof(recordMoviePath), shift_args(&parse_argc, &parse_argv));
+        } else if (strncmp(flag, "--play-movie", strlen("--play-movie")) == 0) {
+            if (parse_argc == 0) {
+                fprintf(stderr, "Error: --play-movie requires a path\n");
+                return 1;
+            }
+            moviePath = shift_args(&parse_argc, &parse_argv);
+        } else if (strncmp(flag, "--profile-csv", strlen("--profile-csv")) == 0) {
+            if (parse_argc == 0) {
+                fprintf(stderr, "Error: --profile-csv requires a path\n");
+                return 1;
+            }
+            profilePath = shift_args(&parse_argc, &parse_argv);
+        } else if (strncmp(flag, "--hotspots", strlen("--hotspots")) == 0) {
+            if (parse_argc == 0) {
+                fprintf(stderr, "Error: --hotspots requires a path\n");
+                return 1;
+            }
+            hotspotPath = shift_args(&parse_argc, &parse_argv);
+        } else if (strncmp(flag, "--compare-trace", strlen("--compare-trace")) == 0) {
+            if (parse_argc == 0) {
+                fprintf(stderr, "Error: --compare-trace requires a path\n");
+                return 1;
+            }
+            compareTracePath = shift_args(&parse_argc, &parse_argv);
+        } else if (strncmp(flag, "--trace-last", strlen("--trace-last")) == 0) {
+            if (parse_argc == 0) {
+                fprintf(stderr, "Error: --trace-last requires a value\n");
+                return 1;
+            }
+            traceLast = (u32)strtoul(shift_args(&parse_argc, &parse_argv), NULL, 0);
+        } else if (strncmp(flag, "--trace", strlen("--trace")) == 0) {
+            if (parse_argc == 0) {
+                fprintf(stderr, "Error: --trace requires a path\n");
+                return 1;
+            }
+            tracePath = shift_args(&parse_argc, &parse_argv);
+        } else if (strncmp(flag, "--batch", strlen("--batch")) == 0) {
+            if (parse_argc == 0) {
+                fprintf(stderr, "Error: --batch requires a path\n");
+                return 1;
+            }
+            batchPath = shift_args(&parse_argc, &parse_argv);
+        } else if (strncmp(flag, "--jobs", strlen("--jobs")) == 0) {
+            if (parse_argc == 0) {
+                fprintf(stderr, "Error: --jobs requires a value\n");
+                return 1;
+            }
+            jobCount = (s32)strtol(shift_args(&parse_argc, &parse_argv), NULL, 0);
+        } else if (strncmp(flag, "--test", strlen("--test")) == 0) {
+            if (parse_argc == 0) {
+                fprintf(stderr, "Error: --test requires a .nes file or a list of them\n");
+                return 1;
+            }
+            testPath = shift_args(&parse_argc, &parse_argv);
+        } else if (strncmp(flag, "--pacing", strlen("--pacing")) == 0) {
+            if (parse_argc == 0) {
+                fprintf(stderr, "Error: --pacing requires timer, audio or vsync\n");
+                return 1;
+            }
+            pacingName = shift_args(&parse_argc, &parse_argv);
+        } else if (strncmp(flag, "--report", strlen("--report")) == 0) {
+            if (parse_argc == 0) {
+                fprintf(stderr, "Error: --report requires a path\n");
+                return 1;
+            }
+            reportPath = shift_args(&parse_argc, &parse_argv);
         } else {
             if (!romPath) {
                 romPath = flag;
@@ -298,7 +535,49 @@ int main(int argc, char** argv)
         }
     }
 
-    if (headlessMode) {
+    if (testPath) {
+        TestRunConfig config = {0};
+        config.path = testPath;
+        config.maxCycles = maxCycles;
+        config.jobCount = jobCount;
+        config.reportPath = reportPath;
+        return RunTestSuite(&config);
+    }
+
+    if (headlessMode || batchPath) {
+        if (batchPath && (logCPUPath || frameHashPath || dumpFrames)) {
+            fprintf(stderr, "Error: --log-cpu, --frame-hashes and --dump-frames don't work with --batch\n");
+            return 1;
+        }
+        if (batchPath && moviePath) {
+            fprintf(stderr, "Error: --play-movie doesn't work with --batch\n");
+            return 1;
+        }
+        if (batchPath && (videoPath || audioPath)) {
+            fprintf(stderr, "Error: --dump-video and --dump-audio don't work with --batch\n");
+            return 1;
+        }
+        if (batchPath && profilePath) {
+            fprintf(stderr, "Error: --profile-csv doesn't work with --batch\n");
+            return 1;
+        }
+        if (batchPath && hotspotPath) {
+            fprintf(stderr, "Error: --hotspots doesn't work with --batch\n");
+            return 1;
+        }
+        if (batchPath && (tracePath || traceLast)) {
+            fprintf(stderr, "Error: --trace and --trace-last don't work with --batch\n");
+            return 1;
+        }
+        if (batchPath && compareTracePath) {
+            fprintf(stderr, "Error: --compare-trace doesn't work with --batch\n");
+            return 1;
+        }
+        if (videoPath && audioPath && strcmp(videoPath, "-") == 0 && strcmp(audioPath, "-") == 0) {
+            fprintf(stderr, "Error: only one of --dump-video and --dump-audio can stream to stdout\n");
+            return 1;
+        }
+
         HeadlessConfig config = {0};
         config.romPath = romPath;
         config.logPath = logCPUPath;
@@ -306,9 +585,40 @@ int main(int argc, char** argv)
         config.maxInstructions = maxInstructions;
         config.maxCycles = maxCycles;
         config.logCPU = logCPUPath != NULL;
+        config.maxFrames = maxFrames;
+        config.frameHashPath = frameHashPath;
+        config.dumpFrames = dumpFrames;
+        config.dumpPrefix = dumpPrefix;
+        config.dumpPNG = dumpPNG;
+        config.summaryPath = summaryPath;
+        config.moviePath = moviePath;
+        config.profilePath = profilePath;
+        config.hotspotPath = hotspotPath;
+        config.tracePath = tracePath;
+        config.traceLast = traceLast;
+        config.compareTracePath = compareTracePath;
+        config.videoPath = videoPath;
+        config.audioPath = audioPath;
+
+        if (batchPath) {
+            return RunHeadlessBatch(&config, batchPath, jobCount);
+        }
+
         return RunHeadless(&config);
     }
 
+    EmuPacing pacing = EMU_PACING_TIMER;
+    if (pacingName) {
+        if (strcmp(pacingName, "audio") == 0) {
+            pacing = EMU_PACING_AUDIO;
+        } else if (strcmp(pacingName, "vsync") == 0) {
+            pacing = EMU_PACING_VSYNC;
+        } else if (strcmp(pacingName, "timer") != 0) {
+            fprintf(stderr, "Error: unknown --pacing %s, use timer, audio or vsync\n", pacingName);
+            return 1;
+        }
+    }
+
     SDL_Window* win;
     SDL_GLContext glContext;
     int windowWidth, windowHeight;
@@ -351,7 +661,15 @@ int main(int argc, char** argv)
 
     glContext = SDL_GL_CreateContext(win);
     SDL_GL_MakeCurrent(win, glContext);
-    SDL_GL_SetSwapInterval(0); // v-sync
+    // the emulation thread keeps its own time, the UI only has to present what it published
+    app.runtime.vsync = SDL_GL_SetSwapInterval(1) == 0;
+
+    // pacing from the presents needs something else than the emulation thread setting their pace
+    if (pacing == EMU_PACING_VSYNC && !app.runtime.vsync) {
+        fprintf(stderr, "Warning: v-sync is not available, pacing with the timer\n");
+        pacing = EMU_PACING_TIMER;
+    }
+    app.ui.pacing = pacing;
 
     LoadGLFunctions();
     SetupDevice(&device);
@@ -389,10 +707,6 @@ int main(int argc, char** argv)
         }
     }
 
-    if (romPath) {
-        LoadFileIntoApp(win, romPath);
-    }
-
     FILE* guiLogFile = NULL;
     if (logCPUPath) {
         guiLogFile = fopen(logCPUPath, "w");
@@ -401,23 +715,35 @@ int main(int argc, char** argv)
         }
     }
 
-    u64 startCounter = SDL_GetPerformanceCounter();
+    AudioSink audioSink = {0};
+    if (audioDeviceId) {
+        audioSink.deviceId = audioDeviceId;
+        audioSink.stream = audioStream;
+        audioSink.frameBytes = SDL_AUDIO_BITSIZE(have.format) / 8 * have.channels;
+        audioSink.frequency = have.freq;
+    }
+
+    EmuThreadConfig emuConfig = {0};
+    emuConfig.audioProc = QueueEmuAudio;
+    emuConfig.audioQueuedProc = GetQueuedEmuAudio;
+    emuConfig.audioData = &audioSink;
+    emuConfig.pacing = pacing;
+    emuConfig.logFile = guiLogFile;
+    emuConfig.moviePath = recordMoviePath;
+    emuConfig.audio = GetAudioSettings();
+    memcpy(&app.ui.audioSettings, &emuConfig.audio, sizeof(EmuAudioSettings));
+
+    app.runtime.emu = CreateEmuThread(&emuConfig);
+    if (!app.runtime.emu) {
+        fprintf(stderr, "Error: could not start the emulation thread\n");
+        quit = true;
+    }
+
+    if (romPath && app.runtime.emu) {
+        LoadFileIntoApp(win, romPath);
+    }
 
-    // Frame cycle accumulator — carries the sub-cycle fractional remainder
-    // across frames so it is never permanently lost.
-    //
-    // The NES PPU runs 341 cycles × 262 scanlines = 89342 PPU ticks per frame.
-    // The CPU runs at PPU/3, so the exact CPU cycles per frame is:
-    //   89342 / 3 = 29780.666... cycles
-    // Truncating to 29780 drops 0.666 cycles per frame = ~40 cycles/sec lost.
-    // Although small, compounding over millions of frames matters for accuracy.
-    //
-    // Solution: accumulate the integer part (0.666... * 3 = 2 remainder over
-    // every 3 frames). We use the same numerator/denominator approach as the
-    // APU accumulator: add PPU_CYCLES_PER_FRAME every frame, take the integer
-    // CPU part, subtract PPU_CYCLES_PER_FRAME from the running total.
-    // In practice: base = 29780, every 3 frames one frame gets 29781 cycles.
-    s64 cycleRemainder = 0; // accumulates sub-integer CPU cycles across frames
+    u64 startCounter = SDL_GetPerformanceCounter();
 
     while (!quit) {
         SDL_Event evt;
@@ -437,76 +763,16 @@ int main(int argc, char** argv)
             }
         }
 
-        if (nes) {
-            UpdateControllerInput(controller);
-        }
+        UpdateControllerInput(controller);
+
+        // without v-sync the frames of the emulation thread set the pace
+        if (!app.runtime.vsync) WaitEmuFrame(app.runtime.emu);
+        ReceiveEmuFrame();
 
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplSDL2_NewFrame();
         igNewFrame();
 
-        if (nes) {
-            // Exact NTSC CPU cycles per frame derived from PPU geometry:
-            //   PPU cycles/frame = PPU_CYCLES_PER_SCANLINE * PPU_SCANLINES_PER_FRAME
-            //                    = 341 * 262 = 89342
-            //   CPU cycles/frame = 89342 / 3 = 29780.666...
-            //
-            // The old value was 0.0167 * CPU_FREQ = 29889 — 109 cycles/frame
-            // too many, making the emulator run at ~59.88 fps instead of the
-            // correct ~60.099 fps (NTSC).  Over-counted cycles also mean more
-            // audio samples are generated per wall-clock second, compounding
-            // the APU drift described in apu.h.
-            //
-            // cycleRemainder tracks the fractional cycles not yet assigned.
-            // 89342 mod 3 = 2, so the remainder grows by 2 per frame.
-            // When it accumulates to >= 3 we add one extra CPU cycle that frame
-            // and subtract 3 from the remainder.  This keeps the long-run
-            // average at exactly 29780.666... cycles/frame with no float math.
-            cycleRemainder += (PPU_CYCLES_PER_SCANLINE * PPU_SCANLINES_PER_FRAME) % 3; // += 2
-            s64 cycles = (PPU_CYCLES_PER_SCANLINE * PPU_SCANLINES_PER_FRAME) / 3;      // 29780
-            if (cycleRemainder >= 3) {
-                cycles++;
-                cycleRemainder -= 3;
-            }
-
-            if (stepping || oneCycleAtTime) {
-                cycles = 1;
-            }
-
-            nes->apu.bufferIndex = 0;
-            nes->apu.pulse1.bufferIndex = 0;
-            nes->apu.pulse2.bufferIndex = 0;
-            nes->apu.triangle.bufferIndex = 0;
-            nes->apu.noise.bufferIndex = 0;
-            nes->apu.dmc.bufferIndex = 0;
-
-            while (cycles > 0) {
-                if (!debugging) {
-                    if (!hitRun) {
-                        if (nes->cpu.pc == breakpoint) {
-                            debugging = true;
-                            stepping = false;
-                        }
-                    } else {
-                        hitRun = false;
-                    }
-                }
-
-                if (debugging && !stepping) break;
-
-                if (guiLogFile) {
-                    LogCPUState(nes, guiLogFile);
-                }
-
-                CPUStep step = StepCPU(nes);
-                cycles -= step.cycles;
-
-                if (debugging) stepping = false;
-            }
-
-            QueueAudioBuffer(&nes->apu, audioDeviceId, audioStream);
-        }
-
         SDL_GetWindowSize(win, &windowWidth, &windowHeight);
 
         DrawUI(win, &device, dt);
@@ -516,37 +782,27 @@ int main(int argc, char** argv)
         glClear(GL_COLOR_BUFFER_BIT);
         ImGui_ImplOpenGL3_RenderDrawData(igGetDrawData());
         SDL_GL_SwapWindow(win);
+        SignalEmuPresent(app.runtime.emu);
 
         u64 endCounter = SDL_GetPerformanceCounter();
-        f32 secondsElapsed = GetSecondsElapsed(startCounter, endCounter);
-
-// True NTSC frame duration: 1 / (CPU_FREQ / (341 * 262 / 3))
-//   = (341 * 262) / (3 * CPU_FREQ)
-//   = 89342 / 5369319
-//   ≈ 0.016639 s  (16.639 ms, NOT 16.7 ms)
-//
-// Using 0.0167 s over-waits by ~0.061 ms per frame = ~3.7 ms/sec.
-// Combined with the APU over-sampling this worsened audio drift.
-// The exact expression avoids a magic number and stays in sync with
-// any future changes to CPU_FREQ or PPU constants.
-#define NES_FRAME_DURATION_S ((f32)(PPU_CYCLES_PER_SCANLINE * PPU_SCANLINES_PER_FRAME) / (3.0f * CPU_FREQ))
-
-        while (secondsElapsed < NES_FRAME_DURATION_S) {
-            endCounter = SDL_GetPerformanceCounter();
-            secondsElapsed = GetSecondsElapsed(startCounter, endCounter);
-        }
-
         dt = GetSecondsElapsed(startCounter, endCounter);
         startCounter = endCounter;
+
+        EndProfileFrame();
+    }
+
+    // the emulation thread queues audio, it stops before the device goes away
+    if (app.runtime.emu) {
+        StopEmuThread(app.runtime.emu);
+        if (app.runtime.emu->game) Save(app.runtime.emu->game, saveFilePath);
+        DestroyEmuThread(app.runtime.emu);
     }
+    if (nes) Destroy(nes);
+    if (guiLogFile) fclose(guiLogFile);
 
     if (audioDeviceId) SDL_CloseAudioDevice(audioDeviceId);
     if (audioStream) SDL_FreeAudioStream(audioStream);
     if (controller) SDL_GameControllerClose(controller);
-    if (nes) {
-        Save(nes, saveFilePath);
-        Destroy(nes);
-    }
 
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplSDL2_Shutdown();
@@ -561,21 +817,5 @@ int main(int argc, char** argv)
 
 #undef nes
 
-#include "nes.c"
-#include "cpu.c"
-#include "cpu_io.c"
-#include "cpu_debug.c"
-#include "cpu_trace.c"
-#include "ppu.c"
-#include "ppu_debug.c"
-#include "apu.c"
-#include "apu_tables.c"
-#include "controller.c"
-#include "gui.c"
-#include "mapper0.c"
-#include "mapper1.c"
-#include "mapper2.c"
-#include "mapper3.c"
-#include "mapper66.c"
-#include "ui.c"
-#include "headless.c"
\ No newline at end of file
+#include "core.c"
+#include "ui.c"
\ No newline at end of file
@@ -2,6 +2,72 @@
 #define MAPPER_H
 
 #include "types.h"
+#include "memory.h"
+
+#define MAPPER_PRG_WINDOW_SIZE 0x4000
+#define MAPPER_CHR_WINDOW_SIZE 0x1000
+
+/*
+ * Mappers don't copy banks around, they point the CPU/PPU windows into the shared
+ * cartridge image. PRG is seen through two 16 KB windows and CHR through two 4 KB windows,
+ * bank numbers wrap around the size of the rom like the unconnected address lines do.
+ * Carts without CHR ROM use the first 8 KB of ppuMemory as CHR RAM.
+ */
+
+static inline void MapPRGBank(NES* nes, u32 window, u32 bank)
+{
+    u32 bankCount = nes->cartridge.prgSizeInBytes / MAPPER_PRG_WINDOW_SIZE;
+    nes->prgBankOffsets[window] = bankCount > 0 ? (bank % bankCount) * MAPPER_PRG_WINDOW_SIZE : 0;
+}
+
+static inline void MapCHRBank(NES* nes, u32 window, u32 bank)
+{
+    u32 bankCount = nes->cartridge.chrSizeInBytes / MAPPER_CHR_WINDOW_SIZE;
+    u32 offset = bankCount > 0 ? (bank % bankCount) * MAPPER_CHR_WINDOW_SIZE : 0;
+    if (nes->chrBankOffsets[window] != offset) {
+        nes->chrBankOffsets[window] = offset;
+        nes->ppu.chrGeneration++;
+    }
+}
+
+// Maps a 32 KB PRG bank at $8000.
+static inline void MapPRGBank32K(NES* nes, u32 bank)
+{
+    MapPRGBank(nes, 0, bank * 2);
+    MapPRGBank(nes, 1, bank * 2 + 1);
+}
+
+// Maps an 8 KB CHR bank at $0000.
+static inline void MapCHRBank8K(NES* nes, u32 bank)
+{
+    MapCHRBank(nes, 0, bank * 2);
+    MapCHRBank(nes, 1, bank * 2 + 1);
+}
+
+static inline u8 ReadPRG(NES* nes, u16 address)
+{
+    u32 window = (address >> 14) & 1;
+    return nes->cartridge.prg[nes->prgBankOffsets[window] + (address & (MAPPER_PRG_WINDOW_SIZE - 1))];
+}
+
+static inline u8 ReadCHR(NES* nes, u16 address)
+{
+    if (!nes->cartridge.chr) {
+        return ReadU8(&nes->ppuMemory, address);
+    }
+
+    u32 window = (address >> 12) & 1;
+    return nes->cartridge.chr[nes->chrBankOffsets[window] + (address & (MAPPER_CHR_WINDOW_SIZE - 1))];
+}
+
+static inline void WriteCHR(NES* nes, u16 address, u8 value)
+{
+    // CHR ROM is read-only and shared between instances
+    if (!nes->cartridge.chr) {
+        WriteU8(&nes->ppuMemory, address, value);
+        nes->ppu.chrGeneration++;
+    }
+}
 
 void Mapper0Init(NES* nes);
 u8 Mapper0ReadU8(NES* nes, u16 address);
@@ -10,8 +76,6 @@ void Mapper0WriteU8(NES* nes, u16 address, u8 value);
 void Mapper1Init(NES* nes);
 u8 Mapper1ReadU8(NES* nes, u16 address);
 void Mapper1WriteU8(NES* nes, u16 address, u8 value);
-void Mapper1Save(NES* nes, FILE* file);
-void Mapper1Load(NES* nes, FILE* file);
 
 void Mapper2Init(NES* nes);
 u8 Mapper2ReadU8(NES* nes, u16 address);
@@ -3,34 +3,20 @@
 
 void Mapper0Init(NES* nes)
 {
-    u32 chrBanks = nes->cartridge.chrBanks;
-    u32 prgBanks = nes->cartridge.prgBanks;
-
-    if (prgBanks > 0) {
-        u8* prg = nes->cartridge.prg;
-        CopyMemoryBytes(&nes->cpuMemory, 0x8000, prg, 0x4000);
-
-        if (prgBanks > 1) {
-            CopyMemoryBytes(&nes->cpuMemory, 0xC000, prg + 0x4000, 0x4000);
-        } else {
-            CopyMemoryBytes(&nes->cpuMemory, 0xC000, prg, 0x4000);
-        }
-    }
-
-    if (chrBanks > 0) {
-        u8* chr = nes->cartridge.chr;
-        CopyMemoryBytes(&nes->ppuMemory, 0x0000, chr, 0x2000);
-    }
+    // 16 KB carts mirror the only bank at $C000
+    MapPRGBank(nes, 0, 0);
+    MapPRGBank(nes, 1, 1);
+    MapCHRBank8K(nes, 0);
 }
 
 u8 Mapper0ReadU8(NES* nes, u16 address)
 {
     if (ISBETWEEN(address, 0x0000, 0x2000)) {
-        return ReadU8(&nes->ppuMemory, address);
+        return ReadCHR(nes, address);
     }
 
     if (ISBETWEEN(address, 0x8000, 0x10000)) {
-        return ReadU8(&nes->cpuMemory, address);
+        return ReadPRG(nes, address);
     }
 
     ASSERT(false);
@@ -40,7 +26,7 @@ u8 Mapper0ReadU8(NES* nes, u16 address)
 void Mapper0WriteU8(NES* nes, u16 address, u8 value)
 {
     if (ISBETWEEN(address, 0x0000, 0x2000)) {
-        WriteU8(&nes->ppuMemory, address, value);
+        WriteCHR(nes, address, value);
         return;
     }
 
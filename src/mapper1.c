@@ -10,6 +10,9 @@ typedef struct Mapper1Data {
     u8 chrMode;
 } Mapper1Data;
 
+// the registers live in the NES state so snapshots pick them up
+_Static_assert(sizeof(Mapper1Data) <= MAPPER_REGISTERS_SIZE, "Mapper1Data doesn't fit in the mapper registers");
+
 static void WriteControl(NES* nes, Mapper1Data* data, u8 value)
 {
     data->control = value;
@@ -19,69 +22,54 @@ static void WriteControl(NES* nes, Mapper1Data* data, u8 value)
     switch (value & 3) {
         case 0:
         case 1:
-            nes->cartridge.mirrorType = MIRROR_FOUR;
+            nes->mirrorType = MIRROR_FOUR;
             break;
         case 2:
-            nes->cartridge.mirrorType = MIRROR_VERTICAL;
+            nes->mirrorType = MIRROR_VERTICAL;
             break;
         case 3:
-            nes->cartridge.mirrorType = MIRROR_HORIZONTAL;
+            nes->mirrorType = MIRROR_HORIZONTAL;
             break;
     }
 }
 
 static void WriteChrBank0(NES* nes, Mapper1Data* data, u8 value)
 {
-    u8* chr;
-    s32 chrBank0;
-
     if (nes->cartridge.chrBanks == 0) return;
 
-    chr = nes->cartridge.chr;
-    chrBank0 = value;
-
     switch (data->chrMode) {
         case 0:
-            CopyMemoryBytes(&nes->ppuMemory, 0x0000, chr + chrBank0 * 0x2000, 0x2000);
+            MapCHRBank8K(nes, value);
             break;
         case 1:
-            CopyMemoryBytes(&nes->ppuMemory, 0x0000, chr + chrBank0 * 0x1000, 0x1000);
+            MapCHRBank(nes, 0, value);
             break;
     }
 }
 
 static void WriteChrBank1(NES* nes, Mapper1Data* data, u8 value)
 {
-    u8* chr;
-    s32 chrBank1;
-
     if (nes->cartridge.chrBanks == 0) return;
 
-    chr = nes->cartridge.chr;
-    chrBank1 = value;
-
     if (data->chrMode == 1) {
-        CopyMemoryBytes(&nes->ppuMemory, 0x1000, chr + chrBank1 * 0x1000, 0x1000);
+        MapCHRBank(nes, 1, value);
     }
 }
 
 static void WritePrgBank(NES* nes, Mapper1Data* data, u8 value)
 {
-    u8* prg = nes->cartridge.prg;
-    s32 prgBank = value;
-
     switch (data->prgMode) {
         case 0:
         case 1:
-            CopyMemoryBytes(&nes->cpuMemory, 0x8000, prg + prgBank * 0x8000, 0x8000);
+            MapPRGBank32K(nes, value);
             break;
         case 2:
-            CopyMemoryBytes(&nes->cpuMemory, 0x8000, prg, 0x4000);
-            CopyMemoryBytes(&nes->cpuMemory, 0xC000, prg + prgBank * 0x4000, 0x4000);
+            MapPRGBank(nes, 0, 0);
+            MapPRGBank(nes, 1, value);
             break;
         case 3:
-            CopyMemoryBytes(&nes->cpuMemory, 0x8000, prg + prgBank * 0x4000, 0x4000);
-            CopyMemoryBytes(&nes->cpuMemory, 0xC000, prg + (nes->cartridge.prgBanks - 1) * 0x4000, 0x4000);
+            MapPRGBank(nes, 0, value);
+            MapPRGBank(nes, 1, nes->cartridge.prgBanks - 1);
             break;
     }
 }
@@ -112,36 +100,26 @@ static void LoadRegister(NES* nes, Mapper1Data* data, u16 address, u8 value)
 
 void Mapper1Init(NES* nes)
 {
-    u32 prgBanks = nes->cartridge.prgBanks;
-    u32 chrBanks = nes->cartridge.chrBanks;
     Mapper1Data* data;
 
-    if (prgBanks > 0) {
-        u8* prg = nes->cartridge.prg;
-        CopyMemoryBytes(&nes->cpuMemory, 0x8000, prg, 0x4000);
-        CopyMemoryBytes(&nes->cpuMemory, 0xC000, prg + (prgBanks - 1) * 0x4000, 0x4000);
-    }
+    MapPRGBank(nes, 0, 0);
+    MapPRGBank(nes, 1, nes->cartridge.prgBanks - 1);
+    MapCHRBank8K(nes, 0);
 
-    if (chrBanks > 0) {
-        u8* chr = nes->cartridge.chr;
-        CopyMemoryBytes(&nes->ppuMemory, 0x0000, chr, 0x2000);
-    }
-
-    data = (Mapper1Data*)Allocate(sizeof(Mapper1Data));
+    data = (Mapper1Data*)nes->mapperData;
     memset(data, 0, sizeof(Mapper1Data));
     data->control = 0x1C;
     data->shift = 0x10;
-    nes->mapperData = data;
 }
 
 u8 Mapper1ReadU8(NES* nes, u16 address)
 {
     if (ISBETWEEN(address, 0x0000, 0x2000)) {
-        return ReadU8(&nes->ppuMemory, address);
+        return ReadCHR(nes, address);
     }
 
     if (ISBETWEEN(address, 0x8000, 0x10000)) {
-        return ReadU8(&nes->cpuMemory, address);
+        return ReadPRG(nes, address);
     }
 
     ASSERT(false);
@@ -153,7 +131,7 @@ void Mapper1WriteU8(NES* nes, u16 address, u8 value)
     Mapper1Data* data = (Mapper1Data*)nes->mapperData;
 
     if (ISBETWEEN(address, 0x0000, 0x2000)) {
-        WriteU8(&nes->ppuMemory, address, value);
+        WriteCHR(nes, address, value);
         return;
     }
 
@@ -164,14 +142,3 @@ void Mapper1WriteU8(NES* nes, u16 address, u8 value)
 
     ASSERT(false);
 }
-
-void Mapper1Save(NES* nes, FILE* file)
-{
-    fwrite(nes->mapperData, sizeof(Mapper1Data), 1, file);
-}
-
-void Mapper1Load(NES* nes, FILE* file)
-{
-    nes->mapperData = Allocate(sizeof(Mapper1Data));
-    fread(nes->mapperData, sizeof(Mapper1Data), 1, file);
-}
@@ -0,0 +1,294 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <string.h>
+
+#include "media.h"
+
+#define WAV_HEADER_SIZE 44
+
+internal s32 RunMediaWriter(void* data)
+{
+    MediaStream* stream = (MediaStream*)data;
+
+    LockMutex(&stream->lock);
+    while (true) {
+        while (!stream->pending && !stream->quit) {
+            WaitCondition(&stream->changed, &stream->lock);
+        }
+
+        if (!stream->pending) {
+            break;
+        }
+
+        u8* buffer = stream->pending;
+        u32 bufferSize = stream->pendingSize;
+        UnlockMutex(&stream->lock);
+
+        bool written = fwrite(buffer, 1, bufferSize, stream->file) == bufferSize;
+
+        LockMutex(&stream->lock);
+        if (!written) {
+            stream->failed = true;
+        }
+        stream->pending = NULL;
+        BroadcastCondition(&stream->changed);
+    }
+    UnlockMutex(&stream->lock);
+
+    return 0;
+}
+
+bool OpenMediaStream(MediaStream* stream, const char* path)
+{
+    memset(stream, 0, sizeof(MediaStream));
+
+    stream->isStdout = strcmp(path, "-") == 0;
+    if (stream->isStdout) {
+        stream->file = stdout;
+        SetBinaryMode(stdout);
+    } else {
+        stream->file = fopen(path, "wb");
+        if (!stream->file) {
+            return false;
+        }
+    }
+
+    // the buffers are already large, a second copy in the C runtime would only cost time
+    setvbuf(stream->file, NULL, _IONBF, 0);
+
+    stream->buffers[0] = (u8*)AllocateAligned(MEDIA_BUFFER_SIZE, CACHE_LINE_SIZE);
+    stream->buffers[1] = (u8*)AllocateAligned(MEDIA_BUFFER_SIZE, CACHE_LINE_SIZE);
+    InitMutex(&stream->lock);
+    InitCondition(&stream->changed);
+
+    if (!stream->buffers[0] || !stream->buffers[1] || !StartThread(&stream->thread, RunMediaWriter, stream)) {
+        DestroyCondition(&stream->changed);
+        DestroyMutex(&stream->lock);
+        if (stream->buffers[0]) FreeAligned(stream->buffers[0]);
+        if (stream->buffers[1]) FreeAligned(stream->buffers[1]);
+        if (!stream->isStdout) fclose(stream->file);
+        memset(stream, 0, sizeof(MediaStream));
+        return false;
+    }
+
+    return true;
+}
+
+// Hands the active buffer to the writer thread, waiting for it to finish the previous one.
+internal void SubmitMediaBuffer(MediaStream* stream)
+{
+    if (stream->used == 0) {
+        return;
+    }
+
+    LockMutex(&stream->lock);
+    while (stream->pending) {
+        WaitCondition(&stream->changed, &stream->lock);
+    }
+    stream->pending = stream->buffers[stream->active];
+    stream->pendingSize = stream->used;
+    BroadcastCondition(&stream->changed);
+    UnlockMutex(&stream->lock);
+
+    stream->active ^= 1;
+    stream->used = 0;
+}
+
+void WriteMediaStream(MediaStream* stream, const void* data, u32 length)
+{
+    const u8* bytes = (const u8*)data;
+    stream->written += length;
+
+    while (length > 0) {
+        u32 count = MIN(length, MEDIA_BUFFER_SIZE - stream->used);
+        memcpy(stream->buffers[stream->active] + stream->used, bytes, count);
+        stream->used += count;
+        bytes += count;
+        length -= count;
+
+        if (stream->used == MEDIA_BUFFER_SIZE) {
+            SubmitMediaBuffer(stream);
+        }
+    }
+}
+
+bool FinishMediaStream(MediaStream* stream)
+{
+    if (!stream->file) {
+        return false;
+    }
+
+    SubmitMediaBuffer(stream);
+
+    LockMutex(&stream->lock);
+    stream->quit = true;
+    BroadcastCondition(&stream->changed);
+    UnlockMutex(&stream->lock);
+
+    JoinThread(&stream->thread);
+
+    fflush(stream->file);
+    return !stream->failed;
+}
+
+void CloseMediaStream(MediaStream* stream)
+{
+    if (!stream->file) {
+        return;
+    }
+
+    if (!stream->isStdout) {
+        fclose(stream->file);
+    }
+
+    DestroyCondition(&stream->changed);
+    DestroyMutex(&stream->lock);
+    FreeAligned(stream->buffers[0]);
+    FreeAligned(stream->buffers[1]);
+    memset(stream, 0, sizeof(MediaStream));
+}
+
+bool OpenVideoWriter(VideoWriter* writer, const char* path, u32 width, u32 height)
+{
+    memset(writer, 0, sizeof(VideoWriter));
+    writer->width = width;
+    writer->height = height;
+
+    writer->planes = (u8*)AllocateAligned(width * height + 2 * (width / 2) * (height / 2), CACHE_LINE_SIZE);
+    if (!writer->planes) {
+        return false;
+    }
+
+    if (!OpenMediaStream(&writer->stream, path)) {
+        FreeAligned(writer->planes);
+        writer->planes = NULL;
+        return false;
+    }
+
+    char header[128];
+    s32 length = snprintf(header, sizeof(header), "YUV4MPEG2 W%u H%u F%u:%u Ip A8:7 C420jpeg\n", width, height,
+                          MEDIA_FRAME_RATE_NUMERATOR, MEDIA_FRAME_RATE_DENOMINATOR);
+    WriteMediaStream(&writer->stream, header, (u32)length);
+
+    return true;
+}
+
+// Studio range BT.601, the chroma of every 2x2 block comes from its average color.
+void WriteVideoFrame(VideoWriter* writer, Color* pixels)
+{
+    u32 width = writer->width;
+    u32 height = writer->height;
+    u8* lumaPlane = writer->planes;
+    u8* uPlane = lumaPlane + width * height;
+    u8* vPlane = uPlane + (width / 2) * (height / 2);
+
+    for (u32 i = 0; i < width * height; i++) {
+        Color c = pixels[i];
+        lumaPlane[i] = (u8)(((66 * c.r + 129 * c.g + 25 * c.b + 128) >> 8) + 16);
+    }
+
+    for (u32 y = 0; y < height / 2; y++) {
+        for (u32 x = 0; x < width / 2; x++) {
+            Color* p = pixels + (y * 2) * width + x * 2;
+            s32 r = (p[0].r + p[1].r + p[width].r + p[width + 1].r + 2) / 4;
+            s32 g = (p[0].g + p[1].g + p[width].g + p[width + 1].g + 2) / 4;
+            s32 b = (p[0].b + p[1].b + p[width].b + p[width + 1].b + 2) / 4;
+
+            uPlane[y * (width / 2) + x] = (u8)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            vPlane[y * (width / 2) + x] = (u8)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+
+    WriteMediaStream(&writer->stream, "FRAME\n", 6);
+    WriteMediaStream(&writer->stream, writer->planes, width * height + 2 * (width / 2) * (height / 2));
+}
+
+bool CloseVideoWriter(VideoWriter* writer)
+{
+    bool written = FinishMediaStream(&writer->stream);
+    CloseMediaStream(&writer->stream);
+
+    if (writer->planes) {
+        FreeAligned(writer->planes);
+        writer->planes = NULL;
+    }
+
+    return written;
+}
+
+internal void WriteU16LE(u8* p, u16 value)
+{
+    p[0] = value & 0xFF;
+    p[1] = (value >> 8) & 0xFF;
+}
+
+internal void WriteU32LE(u8* p, u32 value)
+{
+    p[0] = value & 0xFF;
+    p[1] = (value >> 8) & 0xFF;
+    p[2] = (value >> 16) & 0xFF;
+    p[3] = (value >> 24) & 0xFF;
+}
+
+// dataSize 0xFFFFFFFF marks a stream of unknown length.
+internal void BuildWAVHeader(u8* header, u32 sampleRate, u32 dataSize)
+{
+    memcpy(header + 0, "RIFF", 4);
+    WriteU32LE(header + 4, dataSize == 0xFFFFFFFF ? dataSize : 36 + dataSize);
+    memcpy(header + 8, "WAVE", 4);
+    memcpy(header + 12, "fmt ", 4);
+    WriteU32LE(header + 16, 16);
+    WriteU16LE(header + 20, 1); // PCM
+    WriteU16LE(header + 22, 1); // mono
+    WriteU32LE(header + 24, sampleRate);
+    WriteU32LE(header + 28, sampleRate * sizeof(s16));
+    WriteU16LE(header + 32, sizeof(s16));
+    WriteU16LE(header + 34, 16);
+    memcpy(header + 36, "data", 4);
+    WriteU32LE(header + 40, dataSize);
+}
+
+bool OpenAudioWriter(AudioWriter* writer, const char* path, u32 sampleRate)
+{
+    memset(writer, 0, sizeof(AudioWriter));
+
+    if (!OpenMediaStream(&writer->stream, path)) {
+        return false;
+    }
+
+    u8 header[WAV_HEADER_SIZE];
+    BuildWAVHeader(header, sampleRate, 0xFFFFFFFF);
+    WriteMediaStream(&writer->stream, header, WAV_HEADER_SIZE);
+
+    return true;
+}
+
+// The samples are written as they are in memory, little-endian on every platform the emulator runs on.
+void WriteAudioSamples(AudioWriter* writer, const s16* samples, u32 count)
+{
+    WriteMediaStream(&writer->stream, samples, count * sizeof(s16));
+    writer->sampleCount += count;
+}
+
+bool CloseAudioWriter(AudioWriter* writer)
+{
+    bool written = FinishMediaStream(&writer->stream);
+
+    MediaStream* stream = &writer->stream;
+    if (written && stream->file && !stream->isStdout) {
+        u64 dataSize = writer->sampleCount * sizeof(s16);
+        if (dataSize <= 0xFFFFFFFF - 36) {
+            u8 header[WAV_HEADER_SIZE];
+            BuildWAVHeader(header, 0, (u32)dataSize);
+
+            // only the two sizes are patched, the rest was written when the file was opened
+            written = fseek(stream->file, 4, SEEK_SET) == 0 && fwrite(header + 4, 1, 4, stream->file) == 4 &&
+                      fseek(stream->file, 40, SEEK_SET) == 0 && fwrite(header + 40, 1, 4, stream->file) == 4;
+        }
+    }
+
+    CloseMediaStream(stream);
+    return written;
+}
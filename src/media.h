@@ -0,0 +1,68 @@
+#ifndef MEDIA_H
+#define MEDIA_H
+
+#include "types.h"
+#include "platform.h"
+#include <stdio.h>
+
+/*
+ * Streaming video and audio export for headless runs. Output goes through a MediaStream: the
+ * emulator fills one large aligned buffer while a writer thread hands the other one to the file,
+ * so a slow disk or a pipe into an encoder only stalls emulation when both buffers are full.
+ * The path "-" streams to stdout.
+ */
+
+#define MEDIA_BUFFER_SIZE MEGABYTES(4)
+
+// NTSC frame rate, CPU_FREQ / 29780.5 cycles per frame
+#define MEDIA_FRAME_RATE_NUMERATOR 3579546
+#define MEDIA_FRAME_RATE_DENOMINATOR 59561
+
+typedef struct MediaStream {
+    FILE* file;
+    bool isStdout;
+
+    u8* buffers[2];
+    s32 active;
+    u32 used; // bytes in the active buffer
+    u64 written;
+
+    Thread thread;
+    Mutex lock;
+    Condition changed;
+    u8* pending; // buffer the writer thread owns, NULL when it's idle
+    u32 pendingSize;
+    bool quit;
+    bool failed;
+} MediaStream;
+
+bool OpenMediaStream(MediaStream* stream, const char* path);
+void WriteMediaStream(MediaStream* stream, const void* data, u32 length);
+// Writes what's buffered and stops the writer thread, the file stays open.
+bool FinishMediaStream(MediaStream* stream);
+void CloseMediaStream(MediaStream* stream);
+
+// YUV4MPEG2 (.y4m), BT.601 4:2:0 with an 8:7 pixel aspect ratio, which ffmpeg and most players read.
+typedef struct VideoWriter {
+    MediaStream stream;
+    u32 width;
+    u32 height;
+    u8* planes; // Y, then U, then V
+} VideoWriter;
+
+bool OpenVideoWriter(VideoWriter* writer, const char* path, u32 width, u32 height);
+void WriteVideoFrame(VideoWriter* writer, Color* pixels);
+bool CloseVideoWriter(VideoWriter* writer);
+
+// Mono 16-bit PCM .wav. The sizes in the header are filled in on close, streams to stdout
+// keep the 0xFFFFFFFF placeholders decoders treat as "until the end".
+typedef struct AudioWriter {
+    MediaStream stream;
+    u64 sampleCount;
+} AudioWriter;
+
+bool OpenAudioWriter(AudioWriter* writer, const char* path, u32 sampleRate);
+void WriteAudioSamples(AudioWriter* writer, const s16* samples, u32 count);
+bool CloseAudioWriter(AudioWriter* writer);
+
+#endif // MEDIA_H
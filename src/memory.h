@@ -12,6 +12,14 @@ static inline void CreateMemory(Memory* memory, u32 length)
     memory->created = true;
 }
 
+// Wraps storage owned by someone else, DestroyMemory must not be called on it.
+static inline void InitMemory(Memory* memory, u8* bytes, u32 length)
+{
+    memory->bytes = bytes;
+    memory->length = length;
+    memory->created = true;
+}
+
 static inline void DestroyMemory(Memory* memory)
 {
     if (memory->bytes) {
@@ -0,0 +1,230 @@
+#include "movie.h"
+
+internal Movie* AllocateMovie(void)
+{
+    Movie* movie = (Movie*)Allocate(sizeof(Movie));
+    if (movie) {
+        memset(movie, 0, sizeof(Movie));
+    }
+    return movie;
+}
+
+internal void StartMovie(NES* nes, Movie* movie)
+{
+    movie->startFrame = nes->ppu.frameCount;
+    movie->frame = MOVIE_NO_FRAME;
+    movie->latch = 0;
+    movie->cursor = 0;
+    movie->buttons[0] = 0;
+    movie->buttons[1] = 0;
+
+    nes->movie = movie;
+}
+
+Movie* RecordMovie(NES* nes, bool fromSnapshot)
+{
+    Movie* movie = AllocateMovie();
+    if (!movie) {
+        return NULL;
+    }
+
+    movie->recording = true;
+    movie->romHash = nes->cartridge.image ? nes->cartridge.image->hash : 0;
+
+    if (fromSnapshot) {
+        movie->stateSize = (u32)GetSnapshotSize(nes);
+        movie->state = (u8*)Allocate(movie->stateSize);
+        if (!movie->state) {
+            Free(movie);
+            return NULL;
+        }
+        SnapshotNES(nes, movie->state);
+    }
+
+    StartMovie(nes, movie);
+    return movie;
+}
+
+bool SaveMovie(NES* nes, const char* filePath)
+{
+    Movie* movie = nes->movie;
+    if (!movie) {
+        return false;
+    }
+
+    FILE* file = fopen(filePath, "wb");
+    if (!file) {
+        return false;
+    }
+
+    if (movie->recording) {
+        movie->length = (u32)(nes->ppu.frameCount - movie->startFrame);
+    }
+
+    u32 magic = MOVIE_MAGIC;
+    u32 version = MOVIE_VERSION;
+    fwrite(&magic, sizeof(u32), 1, file);
+    fwrite(&version, sizeof(u32), 1, file);
+    fwrite(&movie->romHash, sizeof(u64), 1, file);
+    fwrite(&movie->length, sizeof(u32), 1, file);
+    fwrite(&movie->stateSize, sizeof(u32), 1, file);
+    fwrite(&movie->inputCount, sizeof(u32), 1, file);
+
+    if (movie->stateSize > 0) {
+        fwrite(movie->state, sizeof(u8), movie->stateSize, file);
+    }
+
+    fwrite(movie->inputs, sizeof(MovieInput), movie->inputCount, file);
+
+    bool written = !ferror(file);
+    fclose(file);
+    return written;
+}
+
+Movie* LoadMovie(const char* filePath)
+{
+    FILE* file = fopen(filePath, "rb");
+    if (!file) {
+        return NULL;
+    }
+
+    Movie* movie = AllocateMovie();
+    if (!movie) {
+        fclose(file);
+        return NULL;
+    }
+
+    u32 magic = 0, version = 0;
+    bool valid = fread(&magic, sizeof(u32), 1, file) == 1 && magic == MOVIE_MAGIC &&
+                 fread(&version, sizeof(u32), 1, file) == 1 && version == MOVIE_VERSION &&
+                 fread(&movie->romHash, sizeof(u64), 1, file) == 1 &&
+                 fread(&movie->length, sizeof(u32), 1, file) == 1 &&
+                 fread(&movie->stateSize, sizeof(u32), 1, file) == 1 &&
+                 fread(&movie->inputCount, sizeof(u32), 1, file) == 1;
+
+    // snapshots are raw copies of the hot state and only load into a build with the same layout
+    if (valid && movie->stateSize > 0) {
+        movie->state = (u8*)Allocate(movie->stateSize);
+        valid = movie->state && movie->stateSize == NES_STATE_SIZE &&
+                fread(movie->state, sizeof(u8), movie->stateSize, file) == movie->stateSize;
+    }
+
+    if (valid && movie->inputCount > 0) {
+        movie->inputCapacity = movie->inputCount;
+        movie->inputs = (MovieInput*)Allocate(sizeof(MovieInput) * movie->inputCapacity);
+        valid = movie->inputs &&
+                fread(movie->inputs, sizeof(MovieInput), movie->inputCount, file) == movie->inputCount;
+    }
+
+    fclose(file);
+
+    if (!valid) {
+        DestroyMovie(movie);
+        return NULL;
+    }
+
+    return movie;
+}
+
+bool PlayMovie(NES* nes, Movie* movie)
+{
+    u64 romHash = nes->cartridge.image ? nes->cartridge.image->hash : 0;
+    if (movie->romHash != romHash) {
+        return false;
+    }
+
+    if (movie->state) {
+        RestoreNES(nes, movie->state);
+    }
+
+    movie->recording = false;
+    StartMovie(nes, movie);
+    return true;
+}
+
+void DestroyMovie(Movie* movie)
+{
+    if (!movie) {
+        return;
+    }
+
+    if (movie->state) {
+        Free(movie->state);
+    }
+
+    if (movie->inputs) {
+        Free(movie->inputs);
+    }
+
+    Free(movie);
+}
+
+internal void AppendMovieInput(Movie* movie, u8 buttons0, u8 buttons1)
+{
+    if (movie->inputCount == movie->inputCapacity) {
+        u32 capacity = movie->inputCapacity ? movie->inputCapacity * 2 : 256;
+        MovieInput* inputs = (MovieInput*)Allocate(sizeof(MovieInput) * capacity);
+        if (!inputs) {
+            return;
+        }
+
+        if (movie->inputs) {
+            memcpy(inputs, movie->inputs, sizeof(MovieInput) * movie->inputCount);
+            Free(movie->inputs);
+        }
+
+        movie->inputs = inputs;
+        movie->inputCapacity = capacity;
+    }
+
+    MovieInput* input = &movie->inputs[movie->inputCount++];
+    input->frame = movie->frame;
+    input->latch = movie->latch;
+    input->buttons[0] = buttons0;
+    input->buttons[1] = buttons1;
+}
+
+void LatchMovieInput(NES* nes, s32 index)
+{
+    Movie* movie = nes->movie;
+    Controller* controller = &nes->controllers[index];
+
+    // both pads are strobed by the same write, the first one advances the position
+    if (index == 0) {
+        u32 frame = (u32)(nes->ppu.frameCount - movie->startFrame);
+        if (frame != movie->frame) {
+            movie->frame = frame;
+            movie->latch = 0;
+        } else {
+            movie->latch++;
+        }
+    }
+
+    // both pads start released, only changes are stored
+    if (movie->recording) {
+        if (controller->state != movie->buttons[index]) {
+            movie->buttons[index] = controller->state;
+
+            MovieInput* last = movie->inputCount > 0 ? &movie->inputs[movie->inputCount - 1] : NULL;
+            if (last && last->frame == movie->frame && last->latch == movie->latch) {
+                last->buttons[index] = controller->state;
+            } else {
+                AppendMovieInput(movie, movie->buttons[0], movie->buttons[1]);
+            }
+        }
+        return;
+    }
+
+    while (movie->cursor < movie->inputCount) {
+        MovieInput* input = &movie->inputs[movie->cursor];
+        if (input->frame > movie->frame || (input->frame == movie->frame && input->latch > movie->latch)) {
+            break;
+        }
+
+        movie->buttons[0] = input->buttons[0];
+        movie->buttons[1] = input->buttons[1];
+        movie->cursor++;
+    }
+
+    controller->state = movie->buttons[index];
+}
@@ -0,0 +1,57 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include "types.h"
+
+/*
+ * Input movies: the pad state of both controllers, stored only when it changes.
+ * Entries are keyed by the frame (relative to the start of the movie) and the number
+ * of earlier strobes in that frame, so a replay hands the game the same value at the
+ * same $4016 write it was recorded at. A movie starts either at power on or from a
+ * snapshot of the hot NES state stored in the file.
+ */
+
+#define MOVIE_MAGIC 0x4D53454E // "NESM"
+#define MOVIE_VERSION 1
+#define MOVIE_NO_FRAME 0xFFFFFFFF
+
+typedef struct MovieInput {
+    u32 frame;
+    u16 latch;
+    u8 buttons[2];
+} MovieInput;
+
+typedef struct Movie {
+    bool recording;
+    u64 romHash;
+    u32 length; // frames covered by the movie
+
+    u8* state;
+    u32 stateSize;
+
+    MovieInput* inputs;
+    u32 inputCount;
+    u32 inputCapacity;
+
+    // playback/record position
+    u64 startFrame;
+    u32 frame;
+    u16 latch;
+    u32 cursor;
+    u8 buttons[2];
+} Movie;
+
+// Starts recording the input of nes, storing a snapshot of its current state when fromSnapshot is set.
+Movie* RecordMovie(NES* nes, bool fromSnapshot);
+bool SaveMovie(NES* nes, const char* filePath);
+
+Movie* LoadMovie(const char* filePath);
+// Restores the movie snapshot, if any, and replaces the controller input of nes with the movie.
+bool PlayMovie(NES* nes, Movie* movie);
+
+void DestroyMovie(Movie* movie);
+
+// Called on every strobe of the controller, records or replays the pad state the game is about to read.
+void LatchMovieInput(NES* nes, s32 index);
+
+#endif // MOVIE_H
@@ -11,6 +11,7 @@
 #include "controller.h"
 #include "gui.h"
 #include "memory.h"
+#include "rom_cache.h"
 #include "mapper0.h"
 #include "mapper1.h"
 #include "mapper2.h"
@@ -60,28 +61,46 @@
  * http://nesdev.com/NES%20emulator%20development%20guide.txt
  */
 
-bool LoadNesRom(char* filePath, Cartridge* cartridge)
+internal void FreeRomData(MappedFile* file, u8* bytes)
 {
-    FILE* file = fopen(filePath, "rb");
-    if (!file) {
-        return false;
+    if (file) {
+        UnmapFile(file);
     }
 
-    CartridgeHeader header;
-    s64 read = fread(&header, sizeof(u8), HEADER_SIZE, file);
-    if (read == 0) {
-        fclose(file);
+    if (bytes) {
+        Free(bytes);
+    }
+}
+
+// Parses the iNES image in data. PRG and CHR are used in place and shared through the rom cache,
+// which takes ownership of the backing storage, either the file mapping or the heap block bytes.
+internal bool ParseNesRom(u8* data, u64 length, MappedFile* file, u8* bytes, const char* filePath,
+                          Cartridge* cartridge)
+{
+    if (length < HEADER_SIZE) {
+        FreeRomData(file, bytes);
         return false;
     }
 
+    CartridgeHeader header;
+    memcpy(&header, data, HEADER_SIZE);
+
     if (!(header.nesStr[0] == 'N' && header.nesStr[1] == 'E' && header.nesStr[2] == 'S' && header.nesStr[3] == 0x1A)) {
-        fclose(file);
+        FreeRomData(file, bytes);
         return false;
     }
 
+    u64 offset = HEADER_SIZE;
+
     cartridge->hasTrainer = HAS_FLAG(header.flags6, TRAINER_MASK);
     if (cartridge->hasTrainer) {
-        fread(&cartridge->trainer, sizeof(u8), TRAINER_SIZE, file);
+        if (offset + TRAINER_SIZE > length) {
+            FreeRomData(file, bytes);
+            return false;
+        }
+
+        memcpy(cartridge->trainer, data + offset, TRAINER_SIZE);
+        offset += TRAINER_SIZE;
     }
 
     if (HAS_FLAG(header.flags6, VRAMLAYOUT_MASK)) {
@@ -99,28 +118,61 @@ bool LoadNesRom(char* filePath, Cartridge* cartridge)
     strncpy(cartridge->path, filePath, sizeof(cartridge->path) - 1);
 
     cartridge->prgBanks = header.prgROMSize;
-    if (cartridge->prgBanks > 0) {
-        cartridge->prgSizeInBytes = cartridge->prgBanks * CPU_PRG_BANK_SIZE;
-        cartridge->prg = (u8*)Allocate(cartridge->prgSizeInBytes);
-        fread(cartridge->prg, sizeof(u8), cartridge->prgSizeInBytes, file);
-    }
-
+    cartridge->prgSizeInBytes = cartridge->prgBanks * CPU_PRG_BANK_SIZE;
     cartridge->chrBanks = header.chrROMSize;
-    if (cartridge->chrBanks > 0) {
-        cartridge->chrSizeInBytes = cartridge->chrBanks * CHR_BANK_SIZE;
-        cartridge->chr = (u8*)Allocate(cartridge->chrSizeInBytes);
-        fread(cartridge->chr, sizeof(u8), cartridge->chrSizeInBytes, file);
+    cartridge->chrSizeInBytes = cartridge->chrBanks * CHR_BANK_SIZE;
+
+    u8* prg = data + offset;
+    u8* chr = prg + cartridge->prgSizeInBytes;
+    offset += cartridge->prgSizeInBytes + cartridge->chrSizeInBytes;
+
+    // there is no code to run without PRG
+    if (cartridge->prgBanks == 0 || offset > length) {
+        FreeRomData(file, bytes);
+        return false;
     }
 
-    fread(cartridge->title, sizeof(u8), MAX_TITLE_LENGTH, file);
+    memset(cartridge->title, 0, MAX_TITLE_LENGTH);
+    memcpy(cartridge->title, data + offset, MIN(length - offset, MAX_TITLE_LENGTH));
 
-    fclose(file);
+    cartridge->image = InternRomImage(file, bytes, prg, cartridge->prgSizeInBytes,
+                                      cartridge->chrBanks > 0 ? chr : NULL, cartridge->chrSizeInBytes);
+    if (!cartridge->image) {
+        return false;
+    }
+
+    cartridge->prg = cartridge->image->prg;
+    cartridge->chr = cartridge->image->chr;
 
     return true;
 }
 
+bool LoadNesRom(char* filePath, Cartridge* cartridge)
+{
+    // the rom is mapped read-only
+    MappedFile file;
+    if (!MapFile(&file, filePath, 0, false)) {
+        return false;
+    }
+
+    return ParseNesRom(file.data, file.size, &file, NULL, filePath, cartridge);
+}
+
+bool LoadNesRomFromMemory(const u8* data, u32 length, Cartridge* cartridge)
+{
+    u8* bytes = (u8*)Allocate(length);
+    if (!bytes) {
+        return false;
+    }
+
+    memcpy(bytes, data, length);
+    return ParseNesRom(bytes, length, NULL, bytes, "", cartridge);
+}
+
 internal void CreateMapper(NES* nes)
 {
+    nes->mapperData = nes->mapperRegisters;
+
     switch (nes->cartridge.mapper) {
         case 0: {
             nes->mapperInit = Mapper0Init;
@@ -133,8 +185,6 @@ internal void CreateMapper(NES* nes)
             nes->mapperInit = Mapper1Init;
             nes->mapperReadU8 = Mapper1ReadU8;
             nes->mapperWriteU8 = Mapper1WriteU8;
-            nes->mapperSave = Mapper1Save;
-            nes->mapperLoad = Mapper1Load;
             break;
         }
 
@@ -178,13 +228,118 @@ void InitMapper(NES* nes)
 
 void Destroy(NES* nes);
 
+// The battery save lives next to the rom, with the extension swapped for .sav.
+internal void BuildBatteryPath(const char* romPath, char* dest, size_t destSize)
+{
+    const char* extension = strrchr(romPath, '.');
+    size_t prefixLength = extension ? (size_t)(extension - romPath) : strlen(romPath);
+    if (prefixLength >= destSize) prefixLength = destSize - 1;
+    memcpy(dest, romPath, prefixLength);
+    dest[prefixLength] = 0;
+    strncat(dest, ".sav", destSize - strlen(dest) - 1);
+}
+
+bool MapBatterySave(NES* nes, bool keepContents)
+{
+    if (!nes->cartridge.hasBatteryPack || !nes->cartridge.path[0] || nes->batteryFile.data) {
+        return false;
+    }
+
+    char batteryPath[MAX_PATH_LENGTH];
+    BuildBatteryPath(nes->cartridge.path, batteryPath, sizeof(batteryPath));
+
+    if (!MapFile(&nes->batteryFile, batteryPath, CPU_SRAM_SIZE, true)) {
+        // stays on volatile SRAM
+        return false;
+    }
+
+    if (keepContents) {
+        memcpy(nes->batteryFile.data, nes->sramRAM, CPU_SRAM_SIZE);
+        nes->batteryDirty = true;
+    }
+
+    InitMemory(&nes->sramMemory, nes->batteryFile.data, CPU_SRAM_SIZE);
+    return true;
+}
+
+void FlushBatteryRAM(NES* nes, bool wait)
+{
+    if (nes->batteryFile.data && (nes->batteryDirty || wait)) {
+        FlushMappedFile(&nes->batteryFile, wait);
+        nes->batteryDirty = false;
+    }
+}
+
+// Everything an instance owns is placed in one arena: the NES itself, then the framebuffer and the audio output.
+internal size GetNESArenaSize(void)
+{
+    return ArenaSizeOf(sizeof(NES)) + ArenaSizeOf(sizeof(Color) * PPU_SCREEN_WIDTH * PPU_SCREEN_HEIGHT) +
+           ArenaSizeOf(sizeof(APUOutput));
+}
+
+// Destroyed instances are kept here and handed out again by AllocateNES, every block has the same size.
+#define NES_POOL_CAPACITY 64
+
+global NES* nesPool[NES_POOL_CAPACITY];
+global s32 nesPoolCount = 0;
+global Mutex nesPoolLock = MUTEX_INIT;
+
+internal NES* LayoutNES(Arena arena)
+{
+    arena.used = 0;
+
+    NES* nes = PushStruct(&arena, NES);
+    nes->gui.pixels = PushArray(&arena, Color, PPU_SCREEN_WIDTH * PPU_SCREEN_HEIGHT);
+    nes->apuOutput = PushStruct(&arena, APUOutput);
+    nes->arena = arena;
+
+    return nes;
+}
+
+// Allocates an instance, torn down with a single free in Destroy.
+// Recycled blocks are only zeroed when clear is set, a clone overwrites what it needs.
+internal NES* AllocateNES(bool clear)
+{
+    LockMutex(&nesPoolLock);
+    NES* recycled = nesPoolCount > 0 ? nesPool[--nesPoolCount] : NULL;
+    UnlockMutex(&nesPoolLock);
+
+    if (recycled) {
+        Arena arena = recycled->arena;
+
+        if (clear) {
+            memset(arena.base, 0, arena.capacity);
+        }
+
+        return LayoutNES(arena);
+    }
+
+    Arena arena;
+    if (!CreateArena(&arena, GetNESArenaSize())) {
+        return NULL;
+    }
+
+    return LayoutNES(arena);
+}
+
+void DrainNESPool(void)
+{
+    LockMutex(&nesPoolLock);
+    while (nesPoolCount > 0) {
+        Arena arena = nesPool[--nesPoolCount]->arena;
+        DestroyArena(&arena);
+    }
+    UnlockMutex(&nesPoolLock);
+}
+
+// Takes ownership of the cartridge reference to the rom image.
 NES* CreateNES(Cartridge cartridge)
 {
-    NES* nes = (NES*)Allocate(sizeof(NES));
+    NES* nes = AllocateNES(true);
 
     if (nes) {
-        memset(nes, 0, sizeof(NES));
         nes->cartridge = cartridge;
+        nes->mirrorType = cartridge.mirrorType;
 
         InitCPU(nes);
         InitPPU(nes);
@@ -199,10 +354,6 @@ NES* CreateNES(Cartridge cartridge)
             return NULL;
         }
 
-        if (cartridge.hasBatteryPack) {
-            // load battery ram
-        }
-
         PowerCPU(nes);
         PowerPPU(nes);
         PowerAPU(nes);
@@ -223,27 +374,111 @@ void ResetNES(NES* nes)
 
 void Destroy(NES* nes)
 {
-    DestroyMemory(&nes->cpuMemory);
-    DestroyMemory(&nes->ppuMemory);
-    DestroyMemory(&nes->oamMemory);
-    DestroyMemory(&nes->oamMemory2);
+    if (nes->batteryFile.data) {
+        FlushBatteryRAM(nes, true);
+        UnmapFile(&nes->batteryFile);
+    }
+
+    ReleaseRomImage(nes->cartridge.image);
+
+    if (nes->debug) {
+        Free(nes->debug);
+        nes->debug = NULL;
+    }
+
+    LockMutex(&nesPoolLock);
+    if (nesPoolCount < NES_POOL_CAPACITY) {
+        nesPool[nesPoolCount++] = nes;
+        UnlockMutex(&nesPoolLock);
+        return;
+    }
+    UnlockMutex(&nesPoolLock);
 
-    if (nes->cartridge.chr) {
-        Free(nes->cartridge.chr);
+    Arena arena = nes->arena;
+    DestroyArena(&arena);
+}
+
+NESDebug* AttachDebug(NES* nes)
+{
+    if (!nes->debug) {
+        nes->debug = (NESDebug*)Allocate(sizeof(NESDebug));
+        if (nes->debug) {
+            memset(nes->debug, 0, sizeof(NESDebug));
+        }
     }
 
-    if (nes->cartridge.prg) {
-        Free(nes->cartridge.prg);
+    return nes->debug;
+}
+
+size GetSnapshotSize(NES* nes)
+{
+    return NES_STATE_SIZE;
+}
+
+// Battery-backed SRAM lives in the mapped .sav file, sramRAM stages it around the single copy of the hot state.
+void SnapshotNES(NES* nes, u8* buffer)
+{
+    if (nes->batteryFile.data) {
+        memcpy(nes->sramRAM, nes->batteryFile.data, CPU_SRAM_SIZE);
     }
 
-    Free(nes);
+    memcpy(buffer, nes, NES_STATE_SIZE);
 }
 
-internal inline void SaveMemory(Memory* memory, FILE* file)
+// Restoring a battery-backed game that owns its .sav (MapBatterySave) writes the SRAM of the snapshot to it.
+void RestoreNES(NES* nes, u8* buffer)
 {
-    fwrite(&memory->created, sizeof(bool), 1, file);
-    fwrite(&memory->length, sizeof(u32), 1, file);
-    fwrite(memory->bytes, sizeof(u8), memory->length, file);
+    memcpy(nes, buffer, NES_STATE_SIZE);
+
+    if (nes->batteryFile.data) {
+        memcpy(nes->batteryFile.data, nes->sramRAM, CPU_SRAM_SIZE);
+        nes->batteryDirty = true;
+    }
+}
+
+// Builds an independent instance from a snapshot of src. It shares the read-only rom image,
+// gets volatile SRAM even when src is battery-backed and starts without a debug context.
+// The framebuffer and audio output aren't copied, they are rewritten by the next frame.
+NES* NESClone(NES* src)
+{
+    NES* nes = AllocateNES(false);
+    if (!nes) {
+        return NULL;
+    }
+
+    SnapshotNES(src, (u8*)nes);
+
+    nes->cartridge = src->cartridge;
+    RetainRomImage(nes->cartridge.image);
+
+    memset(&nes->batteryFile, 0, sizeof(MappedFile));
+    nes->batteryDirty = false;
+    nes->debug = NULL;
+    nes->movie = NULL;
+    nes->liveInput = NULL;
+    nes->cpuProfile = NULL;
+#ifdef CPU_FLAT_BUS
+    nes->flatBus = NULL;
+#endif
+    nes->watchTestStatus = false;
+    nes->testStatusWritten = false;
+
+    nes->mapperInit = src->mapperInit;
+    nes->mapperReadU8 = src->mapperReadU8;
+    nes->mapperWriteU8 = src->mapperWriteU8;
+    nes->mapperData = nes->mapperRegisters;
+
+    InitCPU(nes);
+    InitPPU(nes);
+
+    nes->gui.width = src->gui.width;
+    nes->gui.height = src->gui.height;
+    nes->gui.skipPixels = false;
+    nes->gui.indices = NULL;
+    nes->gui.luma = NULL;
+    nes->apuOutput->bufferIndex = 0;
+
+    return nes;
 }
 
 void Save(NES* nes, char* filePath)
@@ -253,16 +488,12 @@ void Save(NES* nes, char* filePath)
         return;
     }
 
-    // Write ram data
-    SaveMemory(&nes->cpuMemory, file);
-    SaveMemory(&nes->ppuMemory, file);
-    SaveMemory(&nes->oamMemory, file);
-    SaveMemory(&nes->oamMemory2, file);
+    // Write CPU, PPU, APU, controllers, mapper registers and ram data
+    if (nes->batteryFile.data) {
+        memcpy(nes->sramRAM, nes->batteryFile.data, CPU_SRAM_SIZE);
+    }
 
-    // Write CPU, PPU and APU data
-    fwrite(&nes->cpu, sizeof(CPU), 1, file);
-    fwrite(&nes->ppu, sizeof(PPU), 1, file);
-    // fwrite(&nes->apu, sizeof(APU), 1, file);
+    fwrite(nes, NES_STATE_SIZE, 1, file);
 
     // Write cartridge data
     Cartridge* cartridge = &nes->cartridge;
@@ -285,39 +516,26 @@ void Save(NES* nes, char* filePath)
     fwrite(&cartridge->chrSizeInBytes, sizeof(u32), 1, file);
     fwrite(cartridge->chr, sizeof(u8), cartridge->chrSizeInBytes, file);
 
-    // Write controllers data
-    fwrite(&nes->controllers[0], sizeof(Controller), 1, file);
-    fwrite(&nes->controllers[1], sizeof(Controller), 1, file);
-
-    // Write mapper
-    if (nes->mapperSave) {
-        nes->mapperSave(nes, file);
-    }
-
     // Write GUI data
     GUI* gui = &nes->gui;
     fwrite(&gui->width, sizeof(u32), 1, file);
     fwrite(&gui->height, sizeof(u32), 1, file);
     fwrite(gui->pixels, sizeof(Color), 256 * 240, file);
 
-    for (s32 i = 0; i < 2; ++i) {
-        fwrite(gui->patterns[i], sizeof(Color), 128 * 128, file);
-    }
-
-    fwrite(gui->patternHover, sizeof(Color), 8 * 8, file);
-
-    fwrite(gui->nametable, sizeof(Color), 256 * 240, file);
-
     fclose(file);
 }
 
-internal inline void ReadMemory(Memory* memory, FILE* file)
+internal bool ReadNESSave(FILE* file, void* data, u64 length)
 {
-    fread(&memory->created, sizeof(bool), 1, file);
-    fread(&memory->length, sizeof(u32), 1, file);
+    return fread(data, 1, length, file) == length;
+}
 
-    memory->bytes = (u8*)Allocate(memory->length);
-    fread(memory->bytes, sizeof(u8), memory->length, file);
+// Closes the file and gives the partially loaded instance back, the cartridge image is only set once interned.
+internal NES* FailNESSave(FILE* file, NES* nes)
+{
+    fclose(file);
+    Destroy(nes);
+    return NULL;
 }
 
 NES* LoadNESSave(char* filePath)
@@ -327,69 +545,91 @@ NES* LoadNESSave(char* filePath)
         return NULL;
     }
 
-    NES* nes = (NES*)Allocate(sizeof(NES));
-    memset(nes, 0, sizeof(NES));
-
-    // Read ram data
-    ReadMemory(&nes->cpuMemory, file);
-    ReadMemory(&nes->ppuMemory, file);
-    ReadMemory(&nes->oamMemory, file);
-    ReadMemory(&nes->oamMemory2, file);
+    NES* nes = AllocateNES(true);
+    if (!nes) {
+        fclose(file);
+        return NULL;
+    }
 
-    // Read CPU, PPU and APU data
-    fread(&nes->cpu, sizeof(CPU), 1, file);
-    fread(&nes->ppu, sizeof(PPU), 1, file);
-    // fread(&nes->apu, sizeof(APU), 1, file);
+    // Read CPU, PPU, APU, controllers, mapper registers and ram data
+    if (!ReadNESSave(file, nes, NES_STATE_SIZE)) {
+        return FailNESSave(file, nes);
+    }
 
     // Read cartridge data
     Cartridge* cartridge = &nes->cartridge;
-    fread(&cartridge->mirrorType, sizeof(MirrorType), 1, file);
-    fread(&cartridge->hasBatteryPack, sizeof(bool), 1, file);
-    fread(&cartridge->mapper, sizeof(u8), 1, file);
-    fread(&cartridge->prgRAMSize, sizeof(u8), 1, file);
-    fread(cartridge->path, sizeof(char), sizeof(cartridge->path), file);
+    if (!ReadNESSave(file, &cartridge->mirrorType, sizeof(MirrorType)) ||
+        !ReadNESSave(file, &cartridge->hasBatteryPack, sizeof(bool)) ||
+        !ReadNESSave(file, &cartridge->mapper, sizeof(u8)) ||
+        !ReadNESSave(file, &cartridge->prgRAMSize, sizeof(u8)) ||
+        !ReadNESSave(file, cartridge->path, sizeof(cartridge->path)) ||
+        !ReadNESSave(file, cartridge->title, MAX_TITLE_LENGTH) ||
+        !ReadNESSave(file, &cartridge->hasTrainer, sizeof(bool)) ||
+        !ReadNESSave(file, cartridge->trainer, TRAINER_SIZE)) {
+        return FailNESSave(file, nes);
+    }
+
+    // the path names the .sav, don't trust the file to terminate it
+    cartridge->path[sizeof(cartridge->path) - 1] = '\0';
+
+    // PRG and CHR are read into one block and shared with any instance already running the same rom
+    if (!ReadNESSave(file, &cartridge->prgBanks, sizeof(u32)) ||
+        !ReadNESSave(file, &cartridge->prgSizeInBytes, sizeof(u32))) {
+        return FailNESSave(file, nes);
+    }
+
+    long prgPosition = ftell(file);
+    if (cartridge->prgSizeInBytes == 0 || fseek(file, cartridge->prgSizeInBytes, SEEK_CUR) != 0) {
+        return FailNESSave(file, nes);
+    }
 
-    fread(cartridge->title, sizeof(u8), MAX_TITLE_LENGTH, file);
+    if (!ReadNESSave(file, &cartridge->chrBanks, sizeof(u32)) ||
+        !ReadNESSave(file, &cartridge->chrSizeInBytes, sizeof(u32))) {
+        return FailNESSave(file, nes);
+    }
 
-    fread(&cartridge->hasTrainer, sizeof(bool), 1, file);
-    fread(&cartridge->trainer, sizeof(u8), TRAINER_SIZE, file);
+    long chrPosition = ftell(file);
 
-    fread(&cartridge->prgBanks, sizeof(u32), 1, file);
-    fread(&cartridge->prgSizeInBytes, sizeof(u32), 1, file);
+    u8* romBytes = (u8*)Allocate((u64)cartridge->prgSizeInBytes + cartridge->chrSizeInBytes);
+    if (!romBytes) {
+        return FailNESSave(file, nes);
+    }
 
-    cartridge->prg = (u8*)Allocate(cartridge->prgSizeInBytes);
-    fread(cartridge->prg, sizeof(u8), cartridge->prgSizeInBytes, file);
+    u8* prg = romBytes;
+    u8* chr = cartridge->chrSizeInBytes > 0 ? romBytes + cartridge->prgSizeInBytes : NULL;
 
-    fread(&cartridge->chrBanks, sizeof(u32), 1, file);
-    fread(&cartridge->chrSizeInBytes, sizeof(u32), 1, file);
+    if (fseek(file, prgPosition, SEEK_SET) != 0 || !ReadNESSave(file, prg, cartridge->prgSizeInBytes) ||
+        fseek(file, chrPosition, SEEK_SET) != 0 ||
+        !ReadNESSave(file, romBytes + cartridge->prgSizeInBytes, cartridge->chrSizeInBytes)) {
+        Free(romBytes);
+        return FailNESSave(file, nes);
+    }
 
-    cartridge->chr = (u8*)Allocate(cartridge->chrSizeInBytes);
-    fread(cartridge->chr, sizeof(u8), cartridge->chrSizeInBytes, file);
+    // the rom cache takes the block, also when it fails
+    cartridge->image = InternRomImage(NULL, romBytes, prg, cartridge->prgSizeInBytes, chr, cartridge->chrSizeInBytes);
+    if (!cartridge->image) {
+        return FailNESSave(file, nes);
+    }
 
-    // Read controllers data
-    fread(&nes->controllers[0], sizeof(Controller), 1, file);
-    fread(&nes->controllers[1], sizeof(Controller), 1, file);
+    cartridge->prg = cartridge->image->prg;
+    cartridge->chr = cartridge->image->chr;
 
-    // Read mapper
+    // Bind the ram views and mapper without resetting the state just read
+    InitCPU(nes);
+    InitPPU(nes);
     CreateMapper(nes);
-    if (nes->mapperLoad) {
-        nes->mapperLoad(nes, file);
+
+    if (!nes->mapperInit) {
+        return FailNESSave(file, nes);
     }
 
     // Read GUI data
     GUI* gui = &nes->gui;
-    fread(&gui->width, sizeof(u32), 1, file);
-    fread(&gui->height, sizeof(u32), 1, file);
-    fread(gui->pixels, sizeof(Color), 256 * 240, file);
-
-    for (s32 i = 0; i < 2; ++i) {
-        fread(gui->patterns[i], sizeof(Color), 128 * 128, file);
+    if (!ReadNESSave(file, &gui->width, sizeof(u32)) || !ReadNESSave(file, &gui->height, sizeof(u32)) ||
+        !ReadNESSave(file, gui->pixels, sizeof(Color) * 256 * 240)) {
+        return FailNESSave(file, nes);
     }
 
-    fread(gui->patternHover, sizeof(Color), 8 * 8, file);
-
-    fread(gui->nametable, sizeof(Color), 256 * 240, file);
-
     fclose(file);
 
     return nes;
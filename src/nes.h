@@ -4,11 +4,25 @@
 #include "types.h"
 
 bool LoadNesRom(char* filePath, Cartridge* cartridge);
+// Loads an iNES image from memory, the bytes are copied.
+bool LoadNesRomFromMemory(const u8* data, u32 length, Cartridge* cartridge);
 NES* CreateNES(Cartridge cartridge);
 void ResetNES(NES* nes);
 void Destroy(NES* nes);
 void Save(NES* nes, char* filePath);
 NES* LoadNESSave(char* filePath);
 void InitMapper(NES* nes);
+// Backs the SRAM of a battery-backed cart with the .sav file next to the rom, so game writes land directly
+// in the page cache. When keepContents is set sramRAM overwrites the file, otherwise the file is loaded.
+// Games only get it when asked for, without it SRAM is volatile and instances of a rom are independent.
+// Returns false when the game stays on volatile SRAM.
+bool MapBatterySave(NES* nes, bool keepContents);
+void FlushBatteryRAM(NES* nes, bool wait);
+NESDebug* AttachDebug(NES* nes);
+size GetSnapshotSize(NES* nes);
+void SnapshotNES(NES* nes, u8* buffer);
+void RestoreNES(NES* nes, u8* buffer);
+NES* NESClone(NES* src);
+void DrainNESPool(void);
 
 #endif
@@ -0,0 +1,191 @@
+#include "nes_batch.h"
+#include "nes.h"
+#include "cpu.h"
+#include "ppu.h"
+
+internal u32 ReadRewardHook(NES* nes, NESRewardHook* hook)
+{
+    u32 value = 0;
+    for (s32 i = hook->length - 1; i >= 0; i--) {
+        u8 byte = PeekCPUU8(nes, hook->address + i);
+        value = hook->bcd ? value * 100 + (byte >> 4) * 10 + (byte & 0x0F) : (value << 8) | byte;
+    }
+    return value;
+}
+
+internal void ReadRewardHooks(NESBatch* batch, NESBatchInstance* instance)
+{
+    for (s32 i = 0; i < batch->config.hookCount; i++) {
+        instance->hookValues[i] = ReadRewardHook(instance->nes, &batch->config.hooks[i]);
+    }
+}
+
+// Runs on the worker that will step the instance, so its memory is placed near that worker.
+internal void CreateNESBatchInstance(void* data, s32 job, s32 worker)
+{
+    NESBatch* batch = (NESBatch*)data;
+    NESBatchInstance* instance = &batch->instances[job];
+
+    instance->nes = NESClone(batch->initial);
+    if (!instance->nes) {
+        return;
+    }
+
+    // only the observation is rendered
+    instance->nes->gui.skipPixels = true;
+    if (batch->config.observation == NES_OBSERVATION_GRAYSCALE) {
+        InitPPULumaOutput(&instance->luma, NULL, batch->config.width, batch->config.height);
+        instance->nes->gui.luma = &instance->luma;
+    }
+
+    ReadRewardHooks(batch, instance);
+}
+
+NESBatch* CreateNESBatch(Cartridge cartridge, NESBatchConfig* config)
+{
+    bool grayscale = config->observation == NES_OBSERVATION_GRAYSCALE;
+    if (config->instanceCount <= 0 || config->hookCount < 0 || config->hookCount > NES_BATCH_MAX_HOOKS ||
+        (grayscale && (config->width <= 0 || config->width > PPU_SCREEN_WIDTH || config->height <= 0 ||
+                       config->height > PPU_SCREEN_HEIGHT))) {
+        ReleaseRomImage(cartridge.image);
+        return NULL;
+    }
+
+    NESBatch* batch = (NESBatch*)Allocate(sizeof(NESBatch));
+    if (!batch) {
+        ReleaseRomImage(cartridge.image);
+        return NULL;
+    }
+
+    memset(batch, 0, sizeof(NESBatch));
+    batch->config = *config;
+    if (batch->config.framesPerStep <= 0) {
+        batch->config.framesPerStep = 1;
+    }
+
+    batch->initial = CreateNES(cartridge);
+    if (!batch->initial) {
+        Free(batch);
+        return NULL;
+    }
+
+    batch->observationSize = grayscale ? (size)config->width * config->height : PPU_SCREEN_WIDTH * PPU_SCREEN_HEIGHT;
+    batch->initialState = (u8*)Allocate(GetSnapshotSize(batch->initial));
+    batch->instances =
+        (NESBatchInstance*)AllocateAligned(sizeof(NESBatchInstance) * config->instanceCount, CACHE_LINE_SIZE);
+    if (batch->instances) {
+        memset(batch->instances, 0, sizeof(NESBatchInstance) * config->instanceCount);
+    }
+    batch->pool = CreateThreadPool(config->workerCount);
+
+    if (!batch->initialState || !batch->instances || !batch->pool) {
+        DestroyNESBatch(batch);
+        return NULL;
+    }
+
+    SnapshotNES(batch->initial, batch->initialState);
+
+    RunJobs(batch->pool, CreateNESBatchInstance, batch, config->instanceCount);
+
+    for (s32 i = 0; i < config->instanceCount; i++) {
+        if (!batch->instances[i].nes) {
+            DestroyNESBatch(batch);
+            return NULL;
+        }
+    }
+
+    return batch;
+}
+
+void DestroyNESBatch(NESBatch* batch)
+{
+    if (!batch) {
+        return;
+    }
+
+    if (batch->instances) {
+        for (s32 i = 0; i < batch->config.instanceCount; i++) {
+            NESBatchInstance* instance = &batch->instances[i];
+            if (instance->nes) {
+                Destroy(instance->nes);
+            }
+        }
+        FreeAligned(batch->instances);
+    }
+
+    if (batch->pool) {
+        DestroyThreadPool(batch->pool);
+    }
+
+    Free(batch->initialState);
+    Destroy(batch->initial);
+    Free(batch);
+}
+
+size GetNESBatchObservationSize(NESBatch* batch)
+{
+    return batch->observationSize;
+}
+
+void ResetNESBatchInstance(NESBatch* batch, s32 index)
+{
+    ASSERT(index >= 0 && index < batch->config.instanceCount);
+
+    NESBatchInstance* instance = &batch->instances[index];
+    RestoreNES(instance->nes, batch->initialState);
+    ReadRewardHooks(batch, instance);
+}
+
+internal void StepNESBatchInstance(void* data, s32 job, s32 worker)
+{
+    NESBatch* batch = (NESBatch*)data;
+    NESBatchInstance* instance = &batch->instances[job];
+    NES* nes = instance->nes;
+    u8* observation = batch->observations + job * batch->observationSize;
+    bool grayscale = batch->config.observation == NES_OBSERVATION_GRAYSCALE;
+
+    nes->controllers[0].state = batch->inputs[job * 2 + 0];
+    nes->controllers[1].state = batch->inputs[job * 2 + 1];
+
+    // the PPU renders straight into the caller tensor
+    if (grayscale) {
+        instance->luma.pixels = observation;
+    } else {
+        nes->gui.indices = observation;
+    }
+
+    for (s32 i = 0; i < batch->config.framesPerStep; i++) {
+        u64 frameCount = nes->ppu.frameCount;
+        while (nes->ppu.frameCount == frameCount) {
+            StepCPU(nes);
+        }
+    }
+
+    nes->gui.indices = NULL;
+    instance->luma.pixels = NULL;
+
+    f32 reward = 0;
+    for (s32 i = 0; i < batch->config.hookCount; i++) {
+        NESRewardHook* hook = &batch->config.hooks[i];
+        u32 value = ReadRewardHook(nes, hook);
+        reward += hook->scale * ((f32)value - (f32)instance->hookValues[i]);
+        instance->hookValues[i] = value;
+    }
+
+    if (batch->rewards) {
+        batch->rewards[job] = reward;
+    }
+}
+
+void StepNESBatch(NESBatch* batch, const u8* inputs, u8* observations, f32* rewards)
+{
+    batch->inputs = inputs;
+    batch->observations = observations;
+    batch->rewards = rewards;
+
+    RunJobs(batch->pool, StepNESBatchInstance, batch, batch->config.instanceCount);
+
+    batch->inputs = NULL;
+    batch->observations = NULL;
+    batch->rewards = NULL;
+}
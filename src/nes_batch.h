@@ -0,0 +1,87 @@
+#ifndef NES_BATCH_H
+#define NES_BATCH_H
+
+#include "types.h"
+#include "thread_pool.h"
+#include "ppu.h"
+
+/*
+ * Lock-step batches of instances of the same game, for workloads that step many environments with
+ * different inputs every frame. StepNESBatch runs every instance for the same number of frames on the
+ * thread pool and writes one observation per instance into a tensor the caller owns, instance after
+ * instance, plus a reward computed from RAM values.
+ *
+ * The PPU renders observations straight into the tensor (palette indices or a PPULumaOutput) and
+ * skips the RGBA frame. Everything is allocated by CreateNESBatch. Instances are cloned from the
+ * powered-on game by the worker that starts on their slice of the jobs, so their memory is first
+ * touched (and placed) by the thread that runs them, and every step after that only reuses it.
+ * Like the screen, an observation keeps its previous contents where the game had rendering turned off.
+ */
+
+#define NES_BATCH_MAX_HOOKS 8
+
+typedef enum NESObservation {
+    NES_OBSERVATION_INDICES,   // PPU_SCREEN_HEIGHT x PPU_SCREEN_WIDTH system palette indices
+    NES_OBSERVATION_GRAYSCALE, // height x width luma, averaged over the pixels each one covers
+} NESObservation;
+
+// The value at address (little-endian, length bytes, two decimal digits per byte when bcd is set)
+// is read after every step, the instance reward adds scale times how much it changed.
+typedef struct NESRewardHook {
+    u16 address;
+    u8 length;
+    bool bcd;
+    f32 scale;
+} NESRewardHook;
+
+typedef struct NESBatchConfig {
+    s32 instanceCount;
+    s32 workerCount; // 0 uses one worker per processor
+    s32 framesPerStep;
+
+    NESObservation observation;
+    s32 width; // grayscale only
+    s32 height;
+
+    s32 hookCount;
+    NESRewardHook hooks[NES_BATCH_MAX_HOOKS];
+} NESBatchConfig;
+
+typedef struct NESBatchInstance {
+    ALIGNED(CACHE_LINE_SIZE) NES* nes;
+    u32 hookValues[NES_BATCH_MAX_HOOKS];
+    PPULumaOutput luma; // grayscale only
+} NESBatchInstance;
+
+typedef struct NESBatch {
+    NESBatchConfig config;
+    ThreadPool* pool;
+
+    // the powered-on game, instances are cloned from it and reset to it
+    NES* initial;
+    u8* initialState;
+
+    NESBatchInstance* instances;
+    size observationSize;
+
+    // arguments of the step that is running
+    const u8* inputs;
+    u8* observations;
+    f32* rewards;
+} NESBatch;
+
+// Takes ownership of the cartridge reference to the rom image, NULL when the game can't be created.
+NESBatch* CreateNESBatch(Cartridge cartridge, NESBatchConfig* config);
+void DestroyNESBatch(NESBatch* batch);
+
+// Bytes of one observation, the tensor passed to StepNESBatch holds instanceCount of them.
+size GetNESBatchObservationSize(NESBatch* batch);
+
+// Puts the instance back to the powered-on state.
+void ResetNESBatchInstance(NESBatch* batch, s32 index);
+
+// inputs holds the two controller states of every instance (instanceCount x 2 bytes),
+// rewards (instanceCount values) can be NULL.
+void StepNESBatch(NESBatch* batch, const u8* inputs, u8* observations, f32* rewards);
+
+#endif // NES_BATCH_H
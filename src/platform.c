@@ -0,0 +1,465 @@
+// ftruncate, clock_gettime and clock_nanosleep are POSIX, the strict C modes hide them without this.
+// It only works above the first system header, so the unity roots (core.c, main.c) define it too.
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+#if defined(__APPLE__) && !defined(_DARWIN_C_SOURCE)
+#define _DARWIN_C_SOURCE // _SC_NPROCESSORS_ONLN
+#endif
+
+#include <string.h>
+
+#include "platform.h"
+
+typedef struct ThreadStart {
+    ThreadProc proc;
+    void* data;
+} ThreadStart;
+
+internal ThreadStart* CreateThreadStart(ThreadProc proc, void* data)
+{
+    ThreadStart* start = (ThreadStart*)Allocate(sizeof(ThreadStart));
+    if (start) {
+        start->proc = proc;
+        start->data = data;
+    }
+    return start;
+}
+
+internal s32 RunThreadStart(ThreadStart* start)
+{
+    ThreadStart copy = *start;
+    Free(start);
+    return copy.proc(copy.data);
+}
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+
+bool MapFile(MappedFile* mappedFile, const char* path, u64 size, bool writable)
+{
+    memset(mappedFile, 0, sizeof(MappedFile));
+
+    DWORD access = writable ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ;
+    DWORD creation = writable ? OPEN_ALWAYS : OPEN_EXISTING;
+    HANDLE file = CreateFileA(path, access, FILE_SHARE_READ, NULL, creation, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        return false;
+    }
+
+    if (!writable && size == 0) {
+        size = (u64)fileSize.QuadPart;
+    }
+
+    // CreateFileMapping grows the file on disk when the requested size is bigger than the file
+    if (size == 0 || (!writable && size > (u64)fileSize.QuadPart)) {
+        CloseHandle(file);
+        return false;
+    }
+
+    DWORD protect = writable ? PAGE_READWRITE : PAGE_READONLY;
+    HANDLE mapping = CreateFileMappingA(file, NULL, protect, (DWORD)(size >> 32), (DWORD)size, NULL);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* data = MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, (SIZE_T)size);
+    if (!data) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    mappedFile->data = (u8*)data;
+    mappedFile->size = size;
+    mappedFile->writable = writable;
+    mappedFile->fileHandle = file;
+    mappedFile->mappingHandle = mapping;
+    return true;
+}
+
+void FlushMappedFile(MappedFile* mappedFile, bool wait)
+{
+    if (!mappedFile->data || !mappedFile->writable) {
+        return;
+    }
+
+    FlushViewOfFile(mappedFile->data, (SIZE_T)mappedFile->size);
+
+    if (wait) {
+        FlushFileBuffers((HANDLE)mappedFile->fileHandle);
+    }
+}
+
+void UnmapFile(MappedFile* mappedFile)
+{
+    if (mappedFile->data) {
+        UnmapViewOfFile(mappedFile->data);
+        CloseHandle((HANDLE)mappedFile->mappingHandle);
+        CloseHandle((HANDLE)mappedFile->fileHandle);
+    }
+
+    memset(mappedFile, 0, sizeof(MappedFile));
+}
+
+u64 GetTimerTicks(void)
+{
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (u64)counter.QuadPart;
+}
+
+u64 GetTimerFrequency(void)
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return (u64)frequency.QuadPart;
+}
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+void SleepUntilTimer(u64 ticks)
+{
+    u64 now = GetTimerTicks();
+    if (ticks <= now) {
+        return;
+    }
+
+    // high resolution waitable timers (Windows 10 1803 and later) don't depend on the system tick,
+    // without them the 15.6 ms default tick would oversleep, the caller spins instead
+    HANDLE timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (!timer) {
+        return;
+    }
+
+    // relative due time, in 100 ns units
+    LARGE_INTEGER dueTime;
+    dueTime.QuadPart = -(LONGLONG)((ticks - now) * 10000000ull / GetTimerFrequency());
+    if (SetWaitableTimer(timer, &dueTime, 0, NULL, NULL, FALSE)) {
+        WaitForSingleObject(timer, INFINITE);
+    }
+    CloseHandle(timer);
+}
+
+internal DWORD WINAPI ThreadEntry(LPVOID parameter)
+{
+    return (DWORD)RunThreadStart((ThreadStart*)parameter);
+}
+
+bool StartThread(Thread* thread, ThreadProc proc, void* data)
+{
+    ThreadStart* start = CreateThreadStart(proc, data);
+    if (!start) {
+        return false;
+    }
+
+    thread->handle = CreateThread(NULL, 0, ThreadEntry, start, 0, NULL);
+    if (!thread->handle) {
+        Free(start);
+        return false;
+    }
+
+    return true;
+}
+
+void JoinThread(Thread* thread)
+{
+    WaitForSingleObject((HANDLE)thread->handle, INFINITE);
+    CloseHandle((HANDLE)thread->handle);
+    thread->handle = NULL;
+}
+
+void InitMutex(Mutex* mutex)
+{
+    InitializeSRWLock((PSRWLOCK)&mutex->lock);
+}
+
+void DestroyMutex(Mutex* mutex)
+{
+    // SRW locks don't own any resources
+}
+
+void LockMutex(Mutex* mutex)
+{
+    AcquireSRWLockExclusive((PSRWLOCK)&mutex->lock);
+}
+
+void UnlockMutex(Mutex* mutex)
+{
+    ReleaseSRWLockExclusive((PSRWLOCK)&mutex->lock);
+}
+
+void InitCondition(Condition* condition)
+{
+    InitializeConditionVariable((PCONDITION_VARIABLE)&condition->variable);
+}
+
+void DestroyCondition(Condition* condition)
+{
+    // condition variables don't own any resources
+}
+
+void WaitCondition(Condition* condition, Mutex* mutex)
+{
+    SleepConditionVariableSRW((PCONDITION_VARIABLE)&condition->variable, (PSRWLOCK)&mutex->lock, INFINITE, 0);
+}
+
+void SignalCondition(Condition* condition)
+{
+    WakeConditionVariable((PCONDITION_VARIABLE)&condition->variable);
+}
+
+void BroadcastCondition(Condition* condition)
+{
+    WakeAllConditionVariable((PCONDITION_VARIABLE)&condition->variable);
+}
+
+u32 AtomicLoadU32(volatile u32* value)
+{
+    return (u32)InterlockedCompareExchange((volatile LONG*)value, 0, 0);
+}
+
+void AtomicStoreU32(volatile u32* value, u32 newValue)
+{
+    InterlockedExchange((volatile LONG*)value, (LONG)newValue);
+}
+
+u32 AtomicExchangeU32(volatile u32* value, u32 newValue)
+{
+    return (u32)InterlockedExchange((volatile LONG*)value, (LONG)newValue);
+}
+
+s32 GetProcessorCount(void)
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (s32)info.dwNumberOfProcessors;
+}
+
+void SetBinaryMode(FILE* file)
+{
+    _setmode(_fileno(file), _O_BINARY);
+}
+
+#else
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+bool MapFile(MappedFile* mappedFile, const char* path, u64 size, bool writable)
+{
+    memset(mappedFile, 0, sizeof(MappedFile));
+    mappedFile->fd = -1;
+
+    s32 fd = writable ? open(path, O_RDWR | O_CREAT, 0644) : open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) {
+        close(fd);
+        return false;
+    }
+
+    if (!writable && size == 0) {
+        size = (u64)fileStat.st_size;
+    }
+
+    if (size == 0 || (!writable && size > (u64)fileStat.st_size)) {
+        close(fd);
+        return false;
+    }
+
+    // new pages are zero-filled, which is what a fresh battery save expects
+    if (writable && (u64)fileStat.st_size < size && ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        return false;
+    }
+
+    s32 protect = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    void* data = mmap(NULL, (size_t)size, protect, writable ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    mappedFile->data = (u8*)data;
+    mappedFile->size = size;
+    mappedFile->writable = writable;
+    mappedFile->fd = fd;
+    return true;
+}
+
+void FlushMappedFile(MappedFile* mappedFile, bool wait)
+{
+    if (!mappedFile->data || !mappedFile->writable) {
+        return;
+    }
+
+    msync(mappedFile->data, (size_t)mappedFile->size, wait ? MS_SYNC : MS_ASYNC);
+}
+
+void UnmapFile(MappedFile* mappedFile)
+{
+    if (mappedFile->data) {
+        munmap(mappedFile->data, (size_t)mappedFile->size);
+        close(mappedFile->fd);
+    }
+
+    memset(mappedFile, 0, sizeof(MappedFile));
+    mappedFile->fd = -1;
+}
+
+u64 GetTimerTicks(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (u64)now.tv_sec * 1000000000ull + (u64)now.tv_nsec;
+}
+
+u64 GetTimerFrequency(void)
+{
+    return 1000000000ull;
+}
+
+void SleepUntilTimer(u64 ticks)
+{
+#ifdef __APPLE__
+    u64 now = GetTimerTicks();
+    if (ticks <= now) {
+        return;
+    }
+
+    // no clock_nanosleep, a relative sleep is close enough
+    struct timespec duration;
+    duration.tv_sec = (time_t)((ticks - now) / 1000000000ull);
+    duration.tv_nsec = (long)((ticks - now) % 1000000000ull);
+    while (nanosleep(&duration, &duration) == -1 && errno == EINTR) {
+    }
+#else
+    struct timespec deadline;
+    deadline.tv_sec = (time_t)(ticks / 1000000000ull);
+    deadline.tv_nsec = (long)(ticks % 1000000000ull);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+    }
+#endif
+}
+
+
+internal void* ThreadEntry(void* parameter)
+{
+    RunThreadStart((ThreadStart*)parameter);
+    return NULL;
+}
+
+bool StartThread(Thread* thread, ThreadProc proc, void* data)
+{
+    ThreadStart* start = CreateThreadStart(proc, data);
+    if (!start) {
+        return false;
+    }
+
+    if (pthread_create(&thread->handle, NULL, ThreadEntry, start) != 0) {
+        Free(start);
+        return false;
+    }
+
+    return true;
+}
+
+void JoinThread(Thread* thread)
+{
+    pthread_join(thread->handle, NULL);
+}
+
+void InitMutex(Mutex* mutex)
+{
+    pthread_mutex_init(&mutex->lock, NULL);
+}
+
+void DestroyMutex(Mutex* mutex)
+{
+    pthread_mutex_destroy(&mutex->lock);
+}
+
+void LockMutex(Mutex* mutex)
+{
+    pthread_mutex_lock(&mutex->lock);
+}
+
+void UnlockMutex(Mutex* mutex)
+{
+    pthread_mutex_unlock(&mutex->lock);
+}
+
+void InitCondition(Condition* condition)
+{
+    pthread_cond_init(&condition->variable, NULL);
+}
+
+void DestroyCondition(Condition* condition)
+{
+    pthread_cond_destroy(&condition->variable);
+}
+
+void WaitCondition(Condition* condition, Mutex* mutex)
+{
+    pthread_cond_wait(&condition->variable, &mutex->lock);
+}
+
+void SignalCondition(Condition* condition)
+{
+    pthread_cond_signal(&condition->variable);
+}
+
+void BroadcastCondition(Condition* condition)
+{
+    pthread_cond_broadcast(&condition->variable);
+}
+
+u32 AtomicLoadU32(volatile u32* value)
+{
+    return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+}
+
+void AtomicStoreU32(volatile u32* value, u32 newValue)
+{
+    __atomic_store_n(value, newValue, __ATOMIC_SEQ_CST);
+}
+
+u32 AtomicExchangeU32(volatile u32* value, u32 newValue)
+{
+    return __atomic_exchange_n(value, newValue, __ATOMIC_SEQ_CST);
+}
+
+s32 GetProcessorCount(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (s32)count : 1;
+}
+
+void SetBinaryMode(FILE* file)
+{
+    // there's no text mode
+    (void)file;
+}
+
+#endif
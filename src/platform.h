@@ -0,0 +1,107 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include "utils.h"
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+/*
+ * Thin wrappers over the few OS services the core needs that the C runtime
+ * doesn't provide. Windows uses the Win32 API, everything else POSIX.
+ */
+
+typedef struct MappedFile {
+    u8* data;
+    u64 size;
+    bool writable;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#else
+    s32 fd;
+#endif
+} MappedFile;
+
+// Maps a file into memory. Read-only mappings map the whole file when size is 0.
+// Writable mappings create the file if it doesn't exist and grow it to size bytes.
+bool MapFile(MappedFile* mappedFile, const char* path, u64 size, bool writable);
+
+// Schedules dirty pages of a writable mapping to be written back to disk,
+// blocking until they are on disk when wait is set.
+void FlushMappedFile(MappedFile* mappedFile, bool wait);
+
+void UnmapFile(MappedFile* mappedFile);
+
+// Monotonic high resolution timer, ticks advance GetTimerFrequency() times per second.
+u64 GetTimerTicks(void);
+u64 GetTimerFrequency(void);
+
+// Sleeps until GetTimerTicks() reaches ticks with the finest timer the OS has. Wake ups can still
+// come a little late, callers that need the exact time sleep until shortly before it and spin.
+void SleepUntilTimer(u64 ticks);
+
+typedef s32 (*ThreadProc)(void* data);
+
+typedef struct Thread {
+#ifdef _WIN32
+    void* handle;
+#else
+    pthread_t handle;
+#endif
+} Thread;
+
+// Both can be statically initialized with MUTEX_INIT/CONDITION_INIT.
+typedef struct Mutex {
+#ifdef _WIN32
+    void* lock; // SRWLOCK
+#else
+    pthread_mutex_t lock;
+#endif
+} Mutex;
+
+typedef struct Condition {
+#ifdef _WIN32
+    void* variable; // CONDITION_VARIABLE
+#else
+    pthread_cond_t variable;
+#endif
+} Condition;
+
+#ifdef _WIN32
+#define MUTEX_INIT {0}
+#define CONDITION_INIT {0}
+#else
+#define MUTEX_INIT {PTHREAD_MUTEX_INITIALIZER}
+#define CONDITION_INIT {PTHREAD_COND_INITIALIZER}
+#endif
+
+bool StartThread(Thread* thread, ThreadProc proc, void* data);
+void JoinThread(Thread* thread);
+
+void InitMutex(Mutex* mutex);
+void DestroyMutex(Mutex* mutex);
+void LockMutex(Mutex* mutex);
+void UnlockMutex(Mutex* mutex);
+
+void InitCondition(Condition* condition);
+void DestroyCondition(Condition* condition);
+// Atomically releases mutex and waits, the mutex is held again on return.
+void WaitCondition(Condition* condition, Mutex* mutex);
+void SignalCondition(Condition* condition);
+void BroadcastCondition(Condition* condition);
+
+// Sequentially consistent operations on a 32-bit value shared between threads.
+u32 AtomicLoadU32(volatile u32* value);
+void AtomicStoreU32(volatile u32* value, u32 newValue);
+// Returns the value that was replaced.
+u32 AtomicExchangeU32(volatile u32* value, u32 newValue);
+
+s32 GetProcessorCount(void);
+
+// Stops the C runtime from translating line endings, for binary data written to stdout.
+void SetBinaryMode(FILE* file);
+
+#endif // PLATFORM_H
@@ -6,6 +6,56 @@
  * http://wiki.nesdev.com/w/index.php/PPU_sprite_evaluation
  */
 
+bool InitPPULumaOutput(PPULumaOutput* output, u8* pixels, s32 width, s32 height)
+{
+    if (width <= 0 || width > PPU_SCREEN_WIDTH || height <= 0 || height > PPU_SCREEN_HEIGHT) {
+        return false;
+    }
+
+    memset(output, 0, sizeof(PPULumaOutput));
+    output->pixels = pixels;
+    output->width = width;
+    output->height = height;
+
+    for (s32 x = 0; x < PPU_SCREEN_WIDTH; x++) {
+        output->columns[x] = (u8)(x * width / PPU_SCREEN_WIDTH);
+        output->columnCounts[output->columns[x]]++;
+    }
+
+    for (s32 y = 0; y < PPU_SCREEN_HEIGHT; y++) {
+        output->rows[y] = (u8)(y * height / PPU_SCREEN_HEIGHT);
+        output->rowCounts[output->rows[y]]++;
+        output->firstRows[y] = y == 0 || output->rows[y - 1] != output->rows[y];
+    }
+
+    for (s32 y = 0; y < PPU_SCREEN_HEIGHT; y++) {
+        output->lastRows[y] = y == PPU_SCREEN_HEIGHT - 1 || output->rows[y + 1] != output->rows[y];
+    }
+
+    return true;
+}
+
+// The scanline renders x = 1..255 on cycles 1..255 and x = 0 on cycle 256.
+internal void WriteLumaPixel(PPULumaOutput* output, u32 cycle, u8 x, u8 y, u8 colorIndex)
+{
+    // drop what a row left behind when rendering was turned off before it ended, rows that
+    // start rendering partway through only add the pixels that were rendered
+    if (cycle == 1 && output->firstRows[y]) {
+        memset(output->sums, 0, sizeof(u32) * output->width);
+    }
+
+    output->sums[output->columns[x]] += paletteLuma[colorIndex];
+
+    if (cycle == PPU_SCREEN_WIDTH && output->lastRows[y]) {
+        u8 row = output->rows[y];
+        u8* pixels = output->pixels + row * output->width;
+        for (s32 column = 0; column < output->width; column++) {
+            pixels[column] = (u8)(output->sums[column] / ((u32)output->columnCounts[column] * output->rowCounts[row]));
+            output->sums[column] = 0;
+        }
+    }
+}
+
 internal void RenderPixel(NES* nes)
 {
     PPU* ppu = &nes->ppu;
@@ -118,16 +168,28 @@ internal void RenderPixel(NES* nes)
         colorIndex &= 0x30;
     }
 
-    Color color = systemPalette[colorIndex % 64];
+    colorIndex &= 0x3F;
 
-    // check the bits 5, 6, 7 to color emphasis
-    u8 colorMask = (ppu->mask & 0xE0) >> 5;
-    if (colorMask != 0) {
-        ColorEmphasis(&color, colorMask);
+    if (!gui->skipPixels) {
+        Color color = systemPalette[colorIndex];
+
+        // check the bits 5, 6, 7 to color emphasis
+        u8 colorMask = (ppu->mask & 0xE0) >> 5;
+        if (colorMask != 0) {
+            ColorEmphasis(&color, colorMask);
+        }
+
+        // draw pixel at 'x', 'y' with color 'color'
+        SetGUIPixel(gui, x, y, color);
     }
 
-    // draw pixel at 'x', 'y' with color 'color'
-    SetGUIPixel(gui, x, y, color);
+    if (gui->indices) {
+        gui->indices[y * PPU_SCREEN_WIDTH + x] = colorIndex;
+    }
+
+    if (gui->luma) {
+        WriteLumaPixel(gui->luma, ppu->cycle, x, y, colorIndex);
+    }
 }
 
 // from: https://wiki.nesdev.com/w/index.php?title=PPU_scrolling
@@ -277,7 +339,9 @@ void StepPPU(NES* nes)
 
         if (ppu->scanline >= 0 && ppu->scanline <= 239) {
             if (ppu->cycle >= 1 && ppu->cycle <= 256) {
+                PROFILE_BEGIN(PROFILE_RENDER_PIXEL);
                 RenderPixel(nes);
+                PROFILE_END(PROFILE_RENDER_PIXEL);
 
                 ppu->tileData <<= 4;
                 switch (ppu->cycle % 8) {
@@ -619,18 +683,7 @@ void PowerPPU(NES* nes)
 
 void InitPPU(NES* nes)
 {
-    if (!nes->ppuMemory.created) {
-        CreateMemory(&nes->ppuMemory, PPU_RAM_SIZE);
-        ZeroMemoryBytes(&nes->ppuMemory);
-    }
-
-    if (!nes->oamMemory.created) {
-        CreateMemory(&nes->oamMemory, 256);
-        ZeroMemoryBytes(&nes->oamMemory);
-    }
-
-    if (!nes->oamMemory2.created) {
-        CreateMemory(&nes->oamMemory2, 32);
-        ZeroMemoryBytes(&nes->oamMemory2);
-    }
+    InitMemory(&nes->ppuMemory, nes->ppuRAM, PPU_RAM_SIZE);
+    InitMemory(&nes->oamMemory, nes->oamRAM, OAM_SIZE);
+    InitMemory(&nes->oamMemory2, nes->oamRAM2, OAM2_SIZE);
 }
@@ -3,6 +3,7 @@
 
 #include "types.h"
 #include "memory.h"
+#include "profile.h"
 
 /*
  * http://wiki.nesdev.com/w/index.php/PPU_power_up_state
@@ -87,8 +88,6 @@
 // The NES PPU operates at a speed of 21.477272 MHz / 4 = 5369318Hz.
 #define PPU_FREQ 5369318
 
-#define PPU_RAM_SIZE KILOBYTES(64)
-
 #define PPU_PATTERN_TABLE_0_OFFSET 0x0000
 #define PPU_PATTERN_TABLE_1_OFFSET 0x1000
 #define PPU_PATTERN_TABLE_SIZE 0x1000
@@ -204,12 +203,40 @@ $3F1D-$3F1F  Sprite palette 3
 #define GetPixelLowBits(row1, row2, x) (GetPixelBit(row2, x) << 0x1) | GetPixelBit(row1, x)
 #define GetPixelColorBits(row1, row2, x, h) (((h) << 2) | GetPixelLowBits(row1, row2, x))
 
+/*
+ * Reduced resolution grayscale output, written by RenderPixel as the frame renders. Every output pixel
+ * is the average paletteLuma of the screen pixels it covers, the running sums of a row are stored once
+ * its last screen row is rendered, so consumers that only want something like 84x84 luma don't have to
+ * resample the RGBA frame.
+ */
+typedef struct PPULumaOutput {
+    u8* pixels; // height x width
+    s32 width;
+    s32 height;
+
+    // output column/row of every screen column/row and how many screen columns/rows each output one covers
+    u8 columns[PPU_SCREEN_WIDTH];
+    u8 rows[PPU_SCREEN_HEIGHT];
+    u16 columnCounts[PPU_SCREEN_WIDTH];
+    u16 rowCounts[PPU_SCREEN_HEIGHT];
+
+    // screen rows that start or end an output row
+    bool firstRows[PPU_SCREEN_HEIGHT];
+    bool lastRows[PPU_SCREEN_HEIGHT];
+
+    u32 sums[PPU_SCREEN_WIDTH];
+} PPULumaOutput;
+
+// False when the size is larger than the screen. pixels can be changed afterwards, the size can't.
+bool InitPPULumaOutput(PPULumaOutput* output, u8* pixels, s32 width, s32 height);
+
 // this is a forward reference to a function in cpu.h, so WriteDMA could compile.
 u8 ReadCPUU8(NES* nes, u16 address);
 void CPUSetNMILine(NES* nes, bool asserted);
 
 // palette adapted from http://nesdev.parodius.com/NESTechFAQ.htm
 extern Color systemPalette[PPU_NUM_SYSTEM_COLOURS];
+extern u8 paletteLuma[PPU_NUM_SYSTEM_COLOURS];
 extern u8 attributeTableLookup[PPU_VERTICAL_TILES_PER_ATTRIBUTE_BYTE][PPU_HORIZONTAL_TILES_PER_ATTRIBUTE_BYTE];
 
 static inline u8 ReadPPUU8(NES* nes, u16 address)
@@ -272,8 +299,9 @@ static inline void WritePPUU8(NES* nes, u16 address, u8 value)
 
     if (ISBETWEEN(address, 0x2000, 0x3F00)) {
         address = 0x2000 + ((address - 0x2000) % 0x1000);
+        nes->ppu.nametableGeneration++;
 
-        if (nes->cartridge.mirrorType == MIRROR_HORIZONTAL) {
+        if (nes->mirrorType == MIRROR_HORIZONTAL) {
             if (address < 0x2400) {
                 WriteU8(&nes->ppuMemory, address, value);
                 WriteU8(&nes->ppuMemory, address + 0x400, value);
@@ -287,7 +315,7 @@ static inline void WritePPUU8(NES* nes, u16 address, u8 value)
                 WriteU8(&nes->ppuMemory, address - 0x400, value);
                 WriteU8(&nes->ppuMemory, address, value);
             }
-        } else if (nes->cartridge.mirrorType == MIRROR_VERTICAL) {
+        } else if (nes->mirrorType == MIRROR_VERTICAL) {
             if (address < 0x2400) {
                 WriteU8(&nes->ppuMemory, address, value);
                 WriteU8(&nes->ppuMemory, address + 0x800, value);
@@ -310,6 +338,7 @@ static inline void WritePPUU8(NES* nes, u16 address, u8 value)
 
     if (ISBETWEEN(address, 0x3F00, 0x4000)) {
         address = 0x3F00 + ((address - 0x3F00) % 0x20);
+        nes->ppu.paletteGeneration++;
 
         if (ISBETWEEN(address, 0x3F00, 0x3F10)) {
             WriteU8(&nes->ppuMemory, address, value);
@@ -665,9 +694,11 @@ void StepPPU(NES* nes);
 
 static inline void StepPPUCycles(NES* nes, s32 cycles)
 {
+    PROFILE_BEGIN(PROFILE_PPU);
     for (s32 i = 0; i < 3 * cycles; ++i) {
         StepPPU(nes);
     }
+    PROFILE_END(PROFILE_PPU);
 }
 
 #endif // PPU_H
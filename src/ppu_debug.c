@@ -67,6 +67,14 @@ Color systemPalette[PPU_NUM_SYSTEM_COLOURS] = {
     { 0x00, 0x00, 0x00, 0xFF }
 };
 
+// Rec. 601 luma of every system palette color, (299 r + 587 g + 114 b) / 1000.
+u8 paletteLuma[PPU_NUM_SYSTEM_COLOURS] = {
+    0x75, 0x2B, 0x13, 0x27, 0x38, 0x35, 0x31, 0x2C, 0x2F, 0x29, 0x2F, 0x27, 0x37, 0x00, 0x00, 0x00,
+    0xBC, 0x5E, 0x48, 0x42, 0x4E, 0x4F, 0x5A, 0x6C, 0x6D, 0x58, 0x64, 0x5D, 0x5C, 0x00, 0x00, 0x00,
+    0xFF, 0xA0, 0x92, 0xA0, 0xAF, 0xA6, 0x9D, 0xAD, 0xBF, 0xA5, 0xA3, 0xBD, 0xA2, 0x00, 0x00, 0x00,
+    0xFF, 0xD7, 0xD6, 0xD4, 0xDE, 0xDA, 0xD0, 0xE0, 0xE6, 0xEC, 0xD7, 0xE2, 0xE0, 0x00, 0x00, 0x00
+};
+
 u8 attributeTableLookup[PPU_VERTICAL_TILES_PER_ATTRIBUTE_BYTE][PPU_HORIZONTAL_TILES_PER_ATTRIBUTE_BYTE] = {
     { 0x0, 0x1, 0x4, 0x5 },
     { 0x2, 0x3, 0x6, 0x7 },
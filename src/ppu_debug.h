@@ -8,6 +8,7 @@
 #define PPU_VERTICAL_TILES_PER_ATTRIBUTE_BYTE 4
 
 extern Color systemPalette[PPU_NUM_SYSTEM_COLOURS];
+extern u8 paletteLuma[PPU_NUM_SYSTEM_COLOURS];
 extern u8 attributeTableLookup[PPU_VERTICAL_TILES_PER_ATTRIBUTE_BYTE][PPU_HORIZONTAL_TILES_PER_ATTRIBUTE_BYTE];
 
 #endif
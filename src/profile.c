@@ -0,0 +1,94 @@
+#include "profile.h"
+
+THREAD_LOCAL Profiler profiler;
+
+global const char* profileZoneNames[PROFILE_ZONE_COUNT] = {
+    "cpu", "ppu", "render_pixel", "apu", "apu_output", "mapper", "texture_upload", "ui",
+};
+
+global const ProfileZone profileZoneParents[PROFILE_ZONE_COUNT] = {
+    PROFILE_ZONE_COUNT, // cpu
+    PROFILE_CPU,        // ppu
+    PROFILE_PPU,        // render_pixel
+    PROFILE_CPU,        // apu
+    PROFILE_APU,        // apu_output
+    PROFILE_CPU,        // mapper
+    PROFILE_ZONE_COUNT, // texture_upload
+    PROFILE_ZONE_COUNT, // ui
+};
+
+const char* GetProfileZoneName(ProfileZone zone)
+{
+    return profileZoneNames[zone];
+}
+
+ProfileZone GetProfileZoneParent(ProfileZone zone)
+{
+    return profileZoneParents[zone];
+}
+
+void ResetProfiler(void)
+{
+    memset(&profiler, 0, sizeof(Profiler));
+    profiler.frameStartTicks = ReadProfileTicks();
+    profiler.frameStartTimer = GetTimerTicks();
+}
+
+ProfileFrame* EndProfileFrame(void)
+{
+    u64 ticks = ReadProfileTicks();
+    u64 timer = GetTimerTicks();
+
+    // the first frame after start up has nothing to calibrate against
+    if (profiler.frameStartTimer == 0) {
+        profiler.frameStartTicks = ticks;
+        profiler.frameStartTimer = timer;
+    }
+
+    f64 seconds = (f64)(timer - profiler.frameStartTimer) / (f64)GetTimerFrequency();
+    u64 elapsedTicks = ticks - profiler.frameStartTicks;
+    f64 secondsPerTick = elapsedTicks > 0 ? seconds / (f64)elapsedTicks : 0;
+
+    ProfileFrame* frame = &profiler.history[profiler.frameCount % PROFILE_HISTORY_LENGTH];
+    frame->frame = profiler.frameCount;
+    frame->seconds = seconds;
+
+    for (s32 i = 0; i < PROFILE_ZONE_COUNT; i++) {
+        frame->zoneSeconds[i] = (f64)profiler.zones[i].ticks * secondsPerTick;
+        frame->zoneCounts[i] = profiler.zones[i].count;
+    }
+
+    memset(profiler.zones, 0, sizeof(profiler.zones));
+    profiler.frameStartTicks = ticks;
+    profiler.frameStartTimer = timer;
+    profiler.frameCount++;
+
+    return frame;
+}
+
+ProfileFrame* GetProfileFrame(u32 index)
+{
+    if (index >= PROFILE_HISTORY_LENGTH || index >= profiler.frameCount) {
+        return NULL;
+    }
+
+    return &profiler.history[(profiler.frameCount - 1 - index) % PROFILE_HISTORY_LENGTH];
+}
+
+void WriteProfileCSVHeader(FILE* file)
+{
+    fputs("frame,frame_ms", file);
+    for (s32 i = 0; i < PROFILE_ZONE_COUNT; i++) {
+        fprintf(file, ",%s_ms,%s_count", profileZoneNames[i], profileZoneNames[i]);
+    }
+    fputc('\n', file);
+}
+
+void WriteProfileCSVFrame(FILE* file, ProfileFrame* frame)
+{
+    fprintf(file, "%llu,%.4f", (unsigned long long)frame->frame, frame->seconds * 1000.0);
+    for (s32 i = 0; i < PROFILE_ZONE_COUNT; i++) {
+        fprintf(file, ",%.4f,%llu", frame->zoneSeconds[i] * 1000.0, (unsigned long long)frame->zoneCounts[i]);
+    }
+    fputc('\n', file);
+}
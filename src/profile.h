@@ -0,0 +1,112 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "platform.h"
+
+/*
+ * Scoped timers and event counters around the hot paths of a frame. The PROFILE_* macros
+ * compile to nothing unless NES_PROFILE is defined, so regular builds pay nothing for them.
+ * Zones read the time stamp counter on x86 (the platform timer elsewhere) and accumulate into
+ * per-thread counters, EndProfileFrame closes the frame, converts the ticks to seconds and
+ * pushes it into a short history the UI draws and the headless runner writes as CSV.
+ *
+ * Zones nest, a zone's time includes the time of its children:
+ *
+ *   CPU (StepCPU)
+ *     PPU (StepPPUCycles)
+ *       RenderPixel
+ *     APU (StepAPUCycles)
+ *       SetOutput
+ *     Mapper (CPU bus reads/writes at $8000-$FFFF)
+ *   Texture upload (glTexSubImage2D of the screen and the pattern tables)
+ *   UI (DrawUI)
+ */
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+#define PROFILE_HISTORY_LENGTH 128
+
+typedef enum ProfileZone {
+    PROFILE_CPU,
+    PROFILE_PPU,
+    PROFILE_RENDER_PIXEL,
+    PROFILE_APU,
+    PROFILE_APU_OUTPUT,
+    PROFILE_MAPPER,
+    PROFILE_TEXTURE_UPLOAD,
+    PROFILE_UI,
+    PROFILE_ZONE_COUNT
+} ProfileZone;
+
+typedef struct ProfileCounter {
+    u64 ticks;
+    u64 count;
+} ProfileCounter;
+
+typedef struct ProfileFrame {
+    u64 frame;
+    f64 seconds; // wall time since the previous frame ended
+    f64 zoneSeconds[PROFILE_ZONE_COUNT];
+    u64 zoneCounts[PROFILE_ZONE_COUNT];
+} ProfileFrame;
+
+typedef struct Profiler {
+    ProfileCounter zones[PROFILE_ZONE_COUNT];
+
+    // the tick counter is calibrated against the platform timer at every frame end
+    u64 frameStartTicks;
+    u64 frameStartTimer;
+
+    ProfileFrame history[PROFILE_HISTORY_LENGTH];
+    u64 frameCount;
+} Profiler;
+
+extern THREAD_LOCAL Profiler profiler;
+
+static inline u64 ReadProfileTicks(void)
+{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return GetTimerTicks();
+#endif
+}
+
+#ifdef NES_PROFILE
+#define PROFILE_ENABLED 1
+#define PROFILE_BEGIN(zone) u64 profileStart_##zone = ReadProfileTicks()
+#define PROFILE_END(zone)                                                       \
+    do {                                                                        \
+        profiler.zones[zone].ticks += ReadProfileTicks() - profileStart_##zone; \
+        profiler.zones[zone].count++;                                           \
+    } while (0)
+#else
+#define PROFILE_ENABLED 0
+#define PROFILE_BEGIN(zone)
+#define PROFILE_END(zone)
+#endif
+
+const char* GetProfileZoneName(ProfileZone zone);
+// The zone this one is nested in, or PROFILE_ZONE_COUNT for top level zones.
+ProfileZone GetProfileZoneParent(ProfileZone zone);
+
+void ResetProfiler(void);
+// Closes the current frame, returns it (also stored in the history) and starts the next one.
+ProfileFrame* EndProfileFrame(void);
+// Most recent frame first, index 0 is the last frame closed. NULL when there is no such frame yet.
+ProfileFrame* GetProfileFrame(u32 index);
+
+void WriteProfileCSVHeader(FILE* file);
+void WriteProfileCSVFrame(FILE* file, ProfileFrame* frame);
+
+#endif // PROFILE_H
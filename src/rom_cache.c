@@ -0,0 +1,120 @@
+#include <string.h>
+
+#include "rom_cache.h"
+#include "hash.h"
+
+/*
+ * Process-wide cache of ROM images keyed by a hash of the PRG and CHR content.
+ * Instances of the same game share one read-only copy of the banks, so creating
+ * another instance doesn't read or copy the ROM again.
+ */
+
+global RomImage* romImages = NULL;
+
+// instances are created and destroyed from the batch runner threads
+global Mutex romImagesLock = MUTEX_INIT;
+
+internal u64 HashRomContent(u8* prg, u32 prgSizeInBytes, u8* chr, u32 chrSizeInBytes)
+{
+    u64 hash = HashBytes(prg, prgSizeInBytes, 0);
+    return HashBytes(chr, chrSizeInBytes, hash);
+}
+
+internal void FreeRomStorage(MappedFile* file, u8* bytes)
+{
+    if (file && file->data) {
+        UnmapFile(file);
+    }
+
+    if (bytes) {
+        Free(bytes);
+    }
+}
+
+RomImage* InternRomImage(MappedFile* file, u8* bytes, u8* prg, u32 prgSizeInBytes, u8* chr, u32 chrSizeInBytes)
+{
+    u64 hash = HashRomContent(prg, prgSizeInBytes, chr, chrSizeInBytes);
+
+    LockMutex(&romImagesLock);
+
+    for (RomImage* image = romImages; image; image = image->next) {
+        if (image->hash != hash || image->prgSizeInBytes != prgSizeInBytes || image->chrSizeInBytes != chrSizeInBytes) {
+            continue;
+        }
+
+        if (memcmp(image->prg, prg, prgSizeInBytes) != 0 ||
+            (chrSizeInBytes > 0 && memcmp(image->chr, chr, chrSizeInBytes) != 0)) {
+            continue;
+        }
+
+        image->refCount++;
+        UnlockMutex(&romImagesLock);
+
+        FreeRomStorage(file, bytes);
+        return image;
+    }
+
+    RomImage* image = (RomImage*)Allocate(sizeof(RomImage));
+    if (!image) {
+        UnlockMutex(&romImagesLock);
+
+        FreeRomStorage(file, bytes);
+        return NULL;
+    }
+
+    memset(image, 0, sizeof(RomImage));
+    image->hash = hash;
+    image->refCount = 1;
+    if (file) {
+        image->file = *file;
+    }
+    image->bytes = bytes;
+    image->prg = prg;
+    image->prgSizeInBytes = prgSizeInBytes;
+    image->chr = chr;
+    image->chrSizeInBytes = chrSizeInBytes;
+
+    image->next = romImages;
+    romImages = image;
+
+    UnlockMutex(&romImagesLock);
+    return image;
+}
+
+void RetainRomImage(RomImage* image)
+{
+    if (image) {
+        LockMutex(&romImagesLock);
+        image->refCount++;
+        UnlockMutex(&romImagesLock);
+    }
+}
+
+void ReleaseRomImage(RomImage* image)
+{
+    if (!image) {
+        return;
+    }
+
+    LockMutex(&romImagesLock);
+
+    ASSERT(image->refCount > 0);
+    if (--image->refCount > 0) {
+        UnlockMutex(&romImagesLock);
+        return;
+    }
+
+    RomImage** link = &romImages;
+    while (*link && *link != image) {
+        link = &(*link)->next;
+    }
+
+    if (*link) {
+        *link = image->next;
+    }
+
+    UnlockMutex(&romImagesLock);
+
+    FreeRomStorage(&image->file, image->bytes);
+    Free(image);
+}
@@ -0,0 +1,12 @@
+#ifndef ROM_CACHE_H
+#define ROM_CACHE_H
+
+#include "types.h"
+
+// Returns the cached image with the same PRG/CHR content, or a new one, with its reference count incremented.
+// Takes ownership of the backing storage (file mapping or heap bytes) and releases it on a cache hit.
+RomImage* InternRomImage(MappedFile* file, u8* bytes, u8* prg, u32 prgSizeInBytes, u8* chr, u32 chrSizeInBytes);
+void RetainRomImage(RomImage* image);
+void ReleaseRomImage(RomImage* image);
+
+#endif // ROM_CACHE_H
@@ -0,0 +1,252 @@
+#include <stdio.h>
+#include <string.h>
+#include "test_runner.h"
+#include "headless.h"
+#include "nes.h"
+#include "cpu.h"
+#include "platform.h"
+#include "thread_pool.h"
+
+#undef nes
+
+internal const char* testOutcomeNames[] = {"pass", "fail", "timeout", "error"};
+
+internal bool HasTestSignature(NES* nes)
+{
+    return ReadU8(&nes->sramMemory, 1) == 0xDE && ReadU8(&nes->sramMemory, 2) == 0xB0 &&
+           ReadU8(&nes->sramMemory, 3) == 0x61;
+}
+
+internal void ReadTestMessage(NES* nes, char* message)
+{
+    s32 length = 0;
+    while (length < TEST_MESSAGE_LENGTH - 1 && 4 + length < CPU_SRAM_SIZE) {
+        u8 c = ReadU8(&nes->sramMemory, 4 + length);
+        if (c == 0) {
+            break;
+        }
+        message[length++] = (char)c;
+    }
+    message[length] = 0;
+}
+
+void RunTestROM(const char* romPath, u64 maxCycles, TestResult* result)
+{
+    memset(result, 0, sizeof(TestResult));
+    result->romPath = romPath;
+    result->outcome = TEST_ERROR;
+
+    Cartridge cartridge = {0};
+    if (!LoadNesRom((char*)romPath, &cartridge)) {
+        snprintf(result->message, TEST_MESSAGE_LENGTH, "could not load the rom");
+        return;
+    }
+
+    NES* nes = CreateNES(cartridge);
+    if (!nes) {
+        snprintf(result->message, TEST_MESSAGE_LENGTH, "unsupported mapper");
+        return;
+    }
+
+    // SRAM stays volatile (no MapBatterySave), so no .sav is written next to the rom and a run never sees
+    // the status or message an earlier run, or another worker running the same rom, left in it
+    nes->watchTestStatus = true;
+
+    u64 startTicks = GetTimerTicks();
+    u64 resetCycle = 0;
+    result->outcome = TEST_TIMEOUT;
+
+    while (nes->cpu.cycles < maxCycles) {
+        StepCPU(nes);
+
+        if (resetCycle > 0 && nes->cpu.cycles >= resetCycle) {
+            resetCycle = 0;
+            ResetNES(nes);
+        }
+
+        if (!nes->testStatusWritten) {
+            continue;
+        }
+
+        nes->testStatusWritten = false;
+        if (!HasTestSignature(nes)) {
+            continue;
+        }
+
+        u8 status = ReadU8(&nes->sramMemory, 0);
+        if (status == TEST_STATUS_NEEDS_RESET) {
+            // the rom asks to wait at least 100 ms before pressing reset
+            resetCycle = nes->cpu.cycles + CPU_FREQ / 10;
+        } else if (status < TEST_STATUS_RUNNING) {
+            result->status = status;
+            result->outcome = status == 0 ? TEST_PASSED : TEST_FAILED;
+            break;
+        }
+    }
+
+    if (HasTestSignature(nes)) {
+        ReadTestMessage(nes, result->message);
+    }
+
+    result->cycles = nes->cpu.cycles;
+    result->wallSeconds = (f64)(GetTimerTicks() - startTicks) / (f64)GetTimerFrequency();
+
+    Destroy(nes);
+}
+
+typedef struct TestSuite {
+    char** romPaths;
+    TestResult* results;
+    u64 maxCycles;
+} TestSuite;
+
+internal void RunTestJob(void* data, s32 job, s32 worker)
+{
+    TestSuite* suite = (TestSuite*)data;
+    RunTestROM(suite->romPaths[job], suite->maxCycles, &suite->results[job]);
+}
+
+internal void WriteXMLString(FILE* file, const char* value)
+{
+    for (const char* c = value; *c; ++c) {
+        switch (*c) {
+            case '<': fputs("&lt;", file); break;
+            case '>': fputs("&gt;", file); break;
+            case '&': fputs("&amp;", file); break;
+            case '"': fputs("&quot;", file); break;
+            default: {
+                if ((u8)*c >= 0x20 || *c == '\n' || *c == '\t') {
+                    fputc(*c, file);
+                }
+                break;
+            }
+        }
+    }
+}
+
+internal void WriteJUnitReport(FILE* file, TestResult* results, s32 count, s32* outcomes, f64 wallSeconds)
+{
+    fprintf(file, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    fprintf(file, "<testsuite name=\"nes\" tests=\"%d\" failures=\"%d\" errors=\"%d\" time=\"%.3f\">\n", count,
+            outcomes[TEST_FAILED], outcomes[TEST_TIMEOUT] + outcomes[TEST_ERROR], wallSeconds);
+
+    for (s32 i = 0; i < count; ++i) {
+        TestResult* result = &results[i];
+
+        fprintf(file, "  <testcase classname=\"nes\" name=\"");
+        WriteXMLString(file, result->romPath);
+        fprintf(file, "\" time=\"%.3f\"", result->wallSeconds);
+
+        if (result->outcome == TEST_PASSED) {
+            fprintf(file, "/>\n");
+            continue;
+        }
+
+        const char* element = result->outcome == TEST_FAILED ? "failure" : "error";
+        fprintf(file, ">\n    <%s message=\"%s, status %d\">", element, testOutcomeNames[result->outcome],
+                result->status);
+        WriteXMLString(file, result->message);
+        fprintf(file, "</%s>\n  </testcase>\n", element);
+    }
+
+    fprintf(file, "</testsuite>\n");
+}
+
+internal void WriteJSONReport(FILE* file, TestResult* results, s32 count, s32* outcomes, f64 wallSeconds)
+{
+    fprintf(file, "{\"tests\":%d,\"passed\":%d,\"failed\":%d,\"timeouts\":%d,\"errors\":%d,\"wall_time_s\":%.3f,", count,
+            outcomes[TEST_PASSED], outcomes[TEST_FAILED], outcomes[TEST_TIMEOUT], outcomes[TEST_ERROR], wallSeconds);
+    fprintf(file, "\"results\":[");
+
+    for (s32 i = 0; i < count; ++i) {
+        TestResult* result = &results[i];
+
+        fprintf(file, "%s\n{\"rom\":", i > 0 ? "," : "");
+        WriteJSONString(file, result->romPath);
+        fprintf(file, ",\"result\":\"%s\",\"status\":%d,\"cycles\":%llu,\"wall_time_s\":%.3f,\"message\":",
+                testOutcomeNames[result->outcome], result->status, (unsigned long long)result->cycles,
+                result->wallSeconds);
+        WriteJSONString(file, result->message);
+        fprintf(file, "}");
+    }
+
+    fprintf(file, "]}\n");
+}
+
+internal bool IsNesFile(const char* path)
+{
+    size length = strlen(path);
+    return length > 4 && strcmp(path + length - 4, ".nes") == 0;
+}
+
+int RunTestSuite(TestRunConfig* config)
+{
+    TestSuite suite = {0};
+    suite.maxCycles = config->maxCycles > 0 ? config->maxCycles : TEST_DEFAULT_CYCLES;
+
+    s32 count;
+    char* singlePath = (char*)config->path;
+    if (IsNesFile(config->path)) {
+        suite.romPaths = &singlePath;
+        count = 1;
+    } else {
+        count = ReadPathList(config->path, &suite.romPaths);
+        if (count < 0) {
+            fprintf(stderr, "Error: Could not open test list: %s\n", config->path);
+            return 1;
+        }
+    }
+
+    suite.results = (TestResult*)Allocate(sizeof(TestResult) * MAX(count, 1));
+
+    ThreadPool* pool = CreateThreadPool(config->jobCount);
+    if (!pool) {
+        fprintf(stderr, "Error: Could not create the thread pool.\n");
+        Free(suite.results);
+        if (suite.romPaths != &singlePath) {
+            FreePathList(suite.romPaths, count);
+        }
+        return 1;
+    }
+
+    u64 startTicks = GetTimerTicks();
+    RunJobs(pool, RunTestJob, &suite, count);
+    f64 wallSeconds = (f64)(GetTimerTicks() - startTicks) / (f64)GetTimerFrequency();
+
+    DestroyThreadPool(pool);
+
+    s32 outcomes[4] = {0};
+    for (s32 i = 0; i < count; ++i) {
+        outcomes[suite.results[i].outcome]++;
+    }
+
+    FILE* report = stdout;
+    if (config->reportPath) {
+        report = fopen(config->reportPath, "w");
+        if (!report) {
+            fprintf(stderr, "Error: Could not open report file: %s\n", config->reportPath);
+            report = stdout;
+        }
+    }
+
+    size reportPathLength = config->reportPath ? strlen(config->reportPath) : 0;
+    if (reportPathLength > 4 && strcmp(config->reportPath + reportPathLength - 4, ".xml") == 0) {
+        WriteJUnitReport(report, suite.results, count, outcomes, wallSeconds);
+    } else {
+        WriteJSONReport(report, suite.results, count, outcomes, wallSeconds);
+    }
+
+    if (report != stdout) {
+        fclose(report);
+    }
+
+    fprintf(stderr, "Tests: %d passed, %d failed, %d timed out, %d errors in %.3f s\n", outcomes[TEST_PASSED],
+            outcomes[TEST_FAILED], outcomes[TEST_TIMEOUT], outcomes[TEST_ERROR], wallSeconds);
+
+    Free(suite.results);
+    if (suite.romPaths != &singlePath) {
+        FreePathList(suite.romPaths, count);
+    }
+
+    return outcomes[TEST_PASSED] == count ? 0 : 1;
+}
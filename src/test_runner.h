@@ -0,0 +1,50 @@
+#ifndef TEST_RUNNER_H
+#define TEST_RUNNER_H
+
+#include "types.h"
+#include "apu.h"
+
+/*
+ * Runs blargg-style test ROMs. They write $80 to $6000 while running, $81 when they
+ * need the reset button pressed and the result code (0 is a pass) when done, with
+ * DE B0 61 at $6001-$6003 marking the status as valid and a zero terminated message
+ * at $6004.
+ */
+
+#define TEST_STATUS_RUNNING 0x80
+#define TEST_STATUS_NEEDS_RESET 0x81
+#define TEST_MESSAGE_LENGTH 512
+
+typedef enum TestOutcome {
+    TEST_PASSED,
+    TEST_FAILED,
+    TEST_TIMEOUT,
+    TEST_ERROR,
+} TestOutcome;
+
+typedef struct TestResult {
+    const char* romPath;
+    TestOutcome outcome;
+    u8 status;
+    u64 cycles;
+    f64 wallSeconds;
+    char message[TEST_MESSAGE_LENGTH];
+} TestResult;
+
+typedef struct TestRunConfig {
+    // a .nes file or a list of them, one per line
+    const char* path;
+    // emulated cycle budget per ROM, 0 uses TEST_DEFAULT_CYCLES
+    u64 maxCycles;
+    s32 jobCount;
+    // JUnit XML when it ends in .xml, JSON otherwise, stdout when NULL
+    const char* reportPath;
+} TestRunConfig;
+
+// a minute of emulated time, longer than any of the blargg suites need
+#define TEST_DEFAULT_CYCLES ((u64)CPU_FREQ * 60)
+
+void RunTestROM(const char* romPath, u64 maxCycles, TestResult* result);
+int RunTestSuite(TestRunConfig* config);
+
+#endif // TEST_RUNNER_H
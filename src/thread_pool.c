@@ -0,0 +1,169 @@
+#include "thread_pool.h"
+
+typedef struct WorkerStart {
+    ThreadPool* pool;
+    s32 index;
+} WorkerStart;
+
+internal bool TakeJob(JobRange* range, bool steal, s32* job)
+{
+    bool taken = false;
+
+    LockMutex(&range->lock);
+    if (range->begin < range->end) {
+        *job = steal ? --range->end : range->begin++;
+        taken = true;
+    }
+    UnlockMutex(&range->lock);
+
+    return taken;
+}
+
+internal void RunWorker(ThreadPool* pool, s32 index)
+{
+    s32 job;
+    while (TakeJob(&pool->ranges[index], false, &job)) {
+        pool->proc(pool->data, job, index);
+    }
+
+    for (s32 i = 1; i < pool->workerCount; ++i) {
+        JobRange* victim = &pool->ranges[(index + i) % pool->workerCount];
+        while (TakeJob(victim, true, &job)) {
+            pool->proc(pool->data, job, index);
+        }
+    }
+}
+
+internal s32 WorkerThread(void* data)
+{
+    WorkerStart* start = (WorkerStart*)data;
+    ThreadPool* pool = start->pool;
+    s32 index = start->index;
+    Free(start);
+
+    u32 generation = 0;
+    while (true) {
+        LockMutex(&pool->lock);
+        while (pool->generation == generation && !pool->quit) {
+            WaitCondition(&pool->workReady, &pool->lock);
+        }
+        generation = pool->generation;
+        bool quit = pool->quit;
+        UnlockMutex(&pool->lock);
+
+        if (quit) {
+            break;
+        }
+
+        RunWorker(pool, index);
+
+        LockMutex(&pool->lock);
+        if (--pool->busyWorkers == 0) {
+            SignalCondition(&pool->workDone);
+        }
+        UnlockMutex(&pool->lock);
+    }
+
+    return 0;
+}
+
+ThreadPool* CreateThreadPool(s32 workerCount)
+{
+    if (workerCount <= 0) {
+        workerCount = GetProcessorCount();
+    }
+
+    ThreadPool* pool = (ThreadPool*)Allocate(sizeof(ThreadPool));
+    if (!pool) {
+        return NULL;
+    }
+
+    memset(pool, 0, sizeof(ThreadPool));
+    pool->ranges = (JobRange*)AllocateAligned(sizeof(JobRange) * workerCount, CACHE_LINE_SIZE);
+    pool->threads = (Thread*)Allocate(sizeof(Thread) * workerCount);
+    if (!pool->ranges || !pool->threads) {
+        if (pool->ranges) FreeAligned(pool->ranges);
+        if (pool->threads) Free(pool->threads);
+        Free(pool);
+        return NULL;
+    }
+
+    InitMutex(&pool->lock);
+    InitCondition(&pool->workReady);
+    InitCondition(&pool->workDone);
+
+    for (s32 i = 0; i < workerCount; ++i) {
+        memset(&pool->ranges[i], 0, sizeof(JobRange));
+        InitMutex(&pool->ranges[i].lock);
+    }
+
+    // worker 0 is the thread calling RunJobs
+    pool->workerCount = 1;
+    for (s32 i = 1; i < workerCount; ++i) {
+        WorkerStart* start = (WorkerStart*)Allocate(sizeof(WorkerStart));
+        if (!start) {
+            break;
+        }
+
+        start->pool = pool;
+        start->index = i;
+        if (!StartThread(&pool->threads[i], WorkerThread, start)) {
+            Free(start);
+            break;
+        }
+
+        pool->workerCount++;
+    }
+
+    return pool;
+}
+
+void RunJobs(ThreadPool* pool, JobProc proc, void* data, s32 jobCount)
+{
+    s32 workerCount = pool->workerCount;
+    for (s32 i = 0; i < workerCount; ++i) {
+        JobRange* range = &pool->ranges[i];
+        range->begin = (s32)((s64)jobCount * i / workerCount);
+        range->end = (s32)((s64)jobCount * (i + 1) / workerCount);
+    }
+
+    LockMutex(&pool->lock);
+    pool->proc = proc;
+    pool->data = data;
+    pool->busyWorkers = workerCount - 1;
+    pool->generation++;
+    BroadcastCondition(&pool->workReady);
+    UnlockMutex(&pool->lock);
+
+    RunWorker(pool, 0);
+
+    LockMutex(&pool->lock);
+    while (pool->busyWorkers > 0) {
+        WaitCondition(&pool->workDone, &pool->lock);
+    }
+    UnlockMutex(&pool->lock);
+}
+
+void DestroyThreadPool(ThreadPool* pool)
+{
+    LockMutex(&pool->lock);
+    pool->quit = true;
+    BroadcastCondition(&pool->workReady);
+    UnlockMutex(&pool->lock);
+
+    for (s32 i = 1; i < pool->workerCount; ++i) {
+        JoinThread(&pool->threads[i]);
+    }
+
+    for (s32 i = 0; i < pool->workerCount; ++i) {
+        DestroyMutex(&pool->ranges[i].lock);
+    }
+
+    Free(pool->threads);
+    FreeAligned(pool->ranges);
+
+    DestroyCondition(&pool->workDone);
+    DestroyCondition(&pool->workReady);
+    DestroyMutex(&pool->lock);
+    Free(pool);
+}
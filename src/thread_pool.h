@@ -0,0 +1,44 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "platform.h"
+
+/*
+ * Fixed set of worker threads that run batches of independent jobs. Every worker starts
+ * on its own contiguous slice of the job indices and, once that's done, steals jobs from
+ * the end of the other slices, so uneven jobs (ROMs that run much longer than others)
+ * don't leave cores idle. The thread calling RunJobs works as worker 0.
+ */
+
+// worker is in [0, workerCount) and can be used to index per-thread scratch.
+typedef void (*JobProc)(void* data, s32 job, s32 worker);
+
+typedef struct JobRange {
+    ALIGNED(CACHE_LINE_SIZE) Mutex lock;
+    s32 begin;
+    s32 end;
+} JobRange;
+
+typedef struct ThreadPool {
+    s32 workerCount;
+    Thread* threads;
+    JobRange* ranges;
+
+    Mutex lock;
+    Condition workReady;
+    Condition workDone;
+    u32 generation;
+    s32 busyWorkers;
+    bool quit;
+
+    JobProc proc;
+    void* data;
+} ThreadPool;
+
+// workerCount includes the calling thread, 0 uses one worker per processor.
+ThreadPool* CreateThreadPool(s32 workerCount);
+// Runs proc for every job in [0, jobCount) and returns when all of them are done.
+void RunJobs(ThreadPool* pool, JobProc proc, void* data, s32 jobCount);
+void DestroyThreadPool(ThreadPool* pool);
+
+#endif // THREAD_POOL_H
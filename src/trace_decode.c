@@ -0,0 +1,95 @@
+/*
+ * Trace decoder: turns a binary CPU trace written by --trace back into the nestest-style
+ * text that --log-cpu writes, for all the records or only the last N.
+ *
+ * usage: tracedecode [--last N] [--output log.txt] trace.ntrace
+ */
+
+#include "core.c"
+
+#define TRACE_OUTPUT_BUFFER_SIZE MEGABYTES(1)
+
+#define shift_args(argc, argv) (ASSERT(*(argc) > 0), (*(argc))--, *(*(argv))++)
+
+int main(int argc, char** argv)
+{
+    const char* tracePath = NULL;
+    const char* outputPath = NULL;
+    u64 last = 0;
+
+    const char* program = shift_args(&argc, &argv);
+    (void)program;
+
+    while (argc > 0) {
+        const char* flag = shift_args(&argc, &argv);
+        if (strcmp(flag, "--last") == 0 && argc > 0) {
+            last = strtoull(shift_args(&argc, &argv), NULL, 0);
+        } else if (strcmp(flag, "--output") == 0 && argc > 0) {
+            outputPath = shift_args(&argc, &argv);
+        } else if (flag[0] != '-' && !tracePath) {
+            tracePath = flag;
+        } else {
+            tracePath = NULL;
+            break;
+        }
+    }
+
+    if (!tracePath) {
+        fprintf(stderr, "usage: tracedecode [--last N] [--output log.txt] trace.ntrace\n");
+        return 1;
+    }
+
+    MappedFile file;
+    if (!MapFile(&file, tracePath, 0, false)) {
+        fprintf(stderr, "Error: Could not open trace: %s\n", tracePath);
+        return 1;
+    }
+
+    CPUTraceFileHeader* header = (CPUTraceFileHeader*)file.data;
+    if (file.size < sizeof(CPUTraceFileHeader) || header->magic != CPU_TRACE_MAGIC ||
+        header->version != CPU_TRACE_VERSION || header->recordSize != sizeof(CPUTraceRecord)) {
+        fprintf(stderr, "Error: Not a trace file or an unsupported version: %s\n", tracePath);
+        UnmapFile(&file);
+        return 1;
+    }
+
+    FILE* output = stdout;
+    if (outputPath) {
+        output = fopen(outputPath, "w");
+        if (!output) {
+            fprintf(stderr, "Error: Could not open output file: %s\n", outputPath);
+            UnmapFile(&file);
+            return 1;
+        }
+    }
+    setvbuf(output, NULL, _IOFBF, TRACE_OUTPUT_BUFFER_SIZE);
+
+    CPUTraceRecord* records = (CPUTraceRecord*)(file.data + sizeof(CPUTraceFileHeader));
+    u64 count = (file.size - sizeof(CPUTraceFileHeader)) / sizeof(CPUTraceRecord);
+
+    // a ring holds the last ringCapacity records of the run, the oldest one comes right after the newest
+    u64 ringCapacity = header->ringCapacity;
+    u64 start = 0;
+    if (ringCapacity > 0) {
+        count = MIN(MIN(header->ringCount, ringCapacity), count);
+        start = header->ringCount - count;
+    }
+
+    u64 first = (last > 0 && last < count) ? count - last : 0;
+
+    char line[CPU_TRACE_LINE_LENGTH];
+    for (u64 i = first; i < count; i++) {
+        u64 index = ringCapacity > 0 ? (start + i) % ringCapacity : i;
+        FormatCPUTraceRecord(&records[index], line, sizeof(line));
+        fputs(line, output);
+    }
+
+    if (output != stdout) {
+        fclose(output);
+    } else {
+        fflush(output);
+    }
+
+    UnmapFile(&file);
+    return 0;
+}
@@ -1,7 +1,10 @@
 #ifndef TYPES_H
 #define TYPES_H
 
+#include <stddef.h>
+
 #include "utils.h"
+#include "platform.h"
 
 #define MAX_TITLE_LENGTH 128
 #define MAX_PATH_LENGTH 1024
@@ -11,6 +14,14 @@
 #define PPU_SCREEN_HEIGHT 240
 
 #define APU_BUFFER_LENGTH 1024
+#define APU_CHANNEL_COUNT 5
+
+#define CPU_RAM_SIZE 0x0800
+#define CPU_SRAM_SIZE 0x2000
+#define PPU_RAM_SIZE KILOBYTES(16)
+#define OAM_SIZE 256
+#define OAM2_SIZE 32
+#define MAPPER_REGISTERS_SIZE 16
 
 typedef struct Memory {
     bool created;
@@ -63,6 +74,23 @@ typedef struct CartridgeHeader {
     u8 reserved[5];
 } CartridgeHeader;
 
+// Read-only PRG/CHR data shared by every instance running the same game.
+typedef struct RomImage {
+    u64 hash;
+    s32 refCount;
+
+    // backing storage: a read-only mapping of the .nes file, or a heap copy read from a save state
+    MappedFile file;
+    u8* bytes;
+
+    u8* prg;
+    u32 prgSizeInBytes;
+    u8* chr;
+    u32 chrSizeInBytes;
+
+    struct RomImage* next;
+} RomImage;
+
 typedef struct Cartridge {
     MirrorType mirrorType;
     bool hasBatteryPack;
@@ -82,6 +110,9 @@ typedef struct Cartridge {
     u32 chrBanks;
     u32 chrSizeInBytes;
     u8* chr;
+
+    // prg and chr point into this image, the cartridge owns one reference to it
+    RomImage* image;
 } Cartridge;
 
 typedef enum CPUAddressingMode {
@@ -315,6 +346,12 @@ typedef struct PPU {
 
     // sprite temporary variables
     u8 spriteCount;
+
+    // bumped whenever what the pattern tables, nametables or palettes hold changes (writes, CHR bank
+    // switches), so the debug viewers only redraw when they moved
+    u32 chrGeneration;
+    u32 nametableGeneration;
+    u32 paletteGeneration;
 } PPU;
 
 typedef struct APUPulse {
@@ -347,9 +384,6 @@ typedef struct APUPulse {
     u8 envelopeVolume;
 
     u8 constantVolume;
-
-    s32 bufferIndex;
-    s16 buffer[APU_BUFFER_LENGTH];
 } APUPulse;
 
 typedef struct {
@@ -369,9 +403,6 @@ typedef struct {
     u16 timerValue;
 
     u8 tableIndex;
-
-    s32 bufferIndex;
-    s16 buffer[APU_BUFFER_LENGTH];
 } APUTriangle;
 
 typedef struct APUNoise {
@@ -396,9 +427,6 @@ typedef struct APUNoise {
     u8 envelopeVolume;
 
     u8 constantVolume;
-
-    s32 bufferIndex;
-    s16 buffer[APU_BUFFER_LENGTH];
 } APUNoise;
 
 typedef struct APUDMC {
@@ -421,9 +449,6 @@ typedef struct APUDMC {
 
     bool loop;
     bool irq;
-
-    s32 bufferIndex;
-    s16 buffer[APU_BUFFER_LENGTH];
 } APUDMC;
 
 typedef struct AudioFilter {
@@ -454,10 +479,13 @@ typedef struct APU {
     bool inhibitIRQ;
     bool frameIRQ;
     bool dmcIRQ;
+} APU;
 
+// Mixed samples produced since the frontend last drained them.
+typedef struct APUOutput {
     s32 bufferIndex;
     s16 buffer[APU_BUFFER_LENGTH];
-} APU;
+} APUOutput;
 
 typedef struct Controller {
     u8 state;
@@ -468,36 +496,131 @@ typedef struct Controller {
 typedef struct GUI {
     u32 width;
     u32 height;
-    Color pixels[256 * 240];
+    Color* pixels;
+
+    // nothing reads pixels (batches, observation-only consumers), RenderPixel leaves them alone
+    bool skipPixels;
 
-    Color patterns[2][128 * 128];
-    Color patternHover[8 * 8];
-    Color nametable[256 * 240];
+    // system palette index of every pixel, without the emphasis bits, only written when set
+    u8* indices;
+
+    // reduced resolution grayscale, only written when set, see ppu.h
+    struct PPULumaOutput* luma;
 } GUI;
 
+typedef enum APUChannel {
+    APU_CHANNEL_PULSE1,
+    APU_CHANNEL_PULSE2,
+    APU_CHANNEL_TRIANGLE,
+    APU_CHANNEL_NOISE,
+    APU_CHANNEL_DMC,
+} APUChannel;
+
+// Scratch for the debugger viewers, only allocated when a debugger UI is attached.
+typedef struct NESDebug {
+    u32 patterns[2][128 * 128];
+    u32 patternHover[8 * 8];
+    u32 nametable[256 * 240];
+
+    // what the textures above were drawn from, only tiles whose data changed are drawn again
+    bool patternsValid;
+    u32 patternsGeneration;
+    u8 patternTiles[2][256][16];
+
+    bool nametableValid;
+    u16 nametableAddress;
+    u16 nametableBackground;
+    u32 nametableGenerations[3];        // chr, nametable and palette
+    u16 nametableKeys[32 * 30];         // pattern index, palette in the high byte
+    u8 nametableTiles[32 * 30][16 + 4]; // pattern bytes and the 4 palette entries
+
+    // instruction listing of the disassembly panel over one region of the address space, the PRG
+    // window or the RAM the CPU runs from
+    bool disassemblyValid;
+    u16 disassemblyStart;
+    u32 disassemblySize;
+    u32 disassemblyBanks[2]; // prgBankOffsets the PRG window was listed with
+    s32 disassemblyLineCount;
+    u16 disassemblyLines[0x8000]; // offset of every line into the region
+    u8 disassemblyBytes[0x8000];
+
+    s32 channelBufferIndex;
+    s16 channelBuffers[APU_CHANNEL_COUNT][APU_BUFFER_LENGTH];
+} NESDebug;
+
 typedef struct NES {
-    Memory cpuMemory;
+    // Hot emulation state: registers, RAM, OAM and mapper registers.
+    // It holds no pointers and ends at cpuMemory, so a snapshot is a memcpy of NES_STATE_SIZE bytes.
+    CPU cpu;
+    PPU ppu;
+    APU apu;
+    Controller controllers[2];
+
+    // current mirroring, mappers can change the one in the cartridge header
+    MirrorType mirrorType;
+
+    // byte offsets into cartridge.prg for the 16 KB windows at $8000/$C000
+    // and into cartridge.chr for the 4 KB windows at $0000/$1000
+    u32 prgBankOffsets[2];
+    u32 chrBankOffsets[2];
+    u8 mapperRegisters[MAPPER_REGISTERS_SIZE];
+
+    ALIGNED(CACHE_LINE_SIZE) u8 cpuRAM[CPU_RAM_SIZE];
+    u8 oamRAM[OAM_SIZE];
+    u8 oamRAM2[OAM2_SIZE];
+    u8 ppuRAM[PPU_RAM_SIZE];
+
+    // cartridge SRAM, for battery-backed carts this is only a staging copy of the mapped .sav file
+    u8 sramRAM[CPU_SRAM_SIZE];
+
+    // Cold state: views over the RAM above, cartridge, output buffers and debugger data.
+    ALIGNED(CACHE_LINE_SIZE) Memory cpuMemory;
     Memory ppuMemory;
     Memory oamMemory;
     Memory oamMemory2;
+    Memory sramMemory;
 
-    CPU cpu;
-    PPU ppu;
-    APU apu;
+    // battery-backed carts keep sramMemory mapped onto the .sav file
+    MappedFile batteryFile;
+    bool batteryDirty;
 
     Cartridge cartridge;
-    Controller controllers[2];
-
-    GUI gui;
 
     void (*mapperInit)(struct NES* nes);
     u8 (*mapperReadU8)(struct NES* nes, u16 address);
     void (*mapperWriteU8)(struct NES* nes, u16 address, u8 value);
-    void (*mapperSave)(struct NES* nes, FILE* file);
-    void (*mapperLoad)(struct NES* nes, FILE* file);
     void* mapperData;
+
+    APUOutput* apuOutput;
+    GUI gui;
+
+    NESDebug* debug;
+
+    // input movie being recorded or replayed, owned by the caller
+    struct Movie* movie;
+
+    // optional, host input the pads are latched from when the game strobes them (pad 0 in the low
+    // byte, pad 1 in the next one) instead of the states the caller sets before the frame
+    volatile u32* liveInput;
+
+    // per instruction address counters, only while profiling
+    struct CPUProfile* cpuProfile;
+
+#ifdef CPU_FLAT_BUS
+    // replaces the memory map when set, see cpu.h
+    struct CPUFlatBus* flatBus;
+#endif
+
+    // set by the test runner, test ROMs report their result by writing to $6000
+    bool watchTestStatus;
+    bool testStatusWritten;
+
+    // the block holding this NES, the framebuffer and the audio output
+    Arena arena;
 } NES;
 
+#define NES_STATE_SIZE offsetof(NES, cpuMemory)
+
 typedef struct CPUStep {
     u64 cycles;
     CPUInstruction* instruction;
@@ -1,5 +1,6 @@
 #include "ui.h"
 
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -14,11 +15,27 @@
 #include "apu.h"
 #include "gui.h"
 #include "controller.h"
+#include "profile.h"
+#include "emu_thread.h"
 
 #include "IconsFontAwesome5.h"
 
 #define nes (app.runtime.nes)
 
+internal void SendEmuCommand(EmuCommand* command)
+{
+    if (!PostEmuCommand(app.runtime.emu, command)) {
+        fprintf(stderr, "Warning: the emulator is busy, the command was dropped\n");
+    }
+}
+
+internal void SendEmuCommandType(EmuCommandType type)
+{
+    EmuCommand command = {0};
+    command.type = type;
+    SendEmuCommand(&command);
+}
+
 void SetupImGui(void)
 {
     ImGuiIO* io = igGetIO_Nil();
@@ -97,6 +114,26 @@ void SetupImGui(void)
 /* UI Sections                                                               */
 /* ------------------------------------------------------------------------- */
 
+EmuAudioSettings GetAudioSettings(void)
+{
+    EmuAudioSettings settings;
+    memset(&settings, 0, sizeof(EmuAudioSettings));
+
+    settings.channels[APU_CHANNEL_PULSE1] = app.ui.square1Enabled;
+    settings.channels[APU_CHANNEL_PULSE2] = app.ui.square2Enabled;
+    settings.channels[APU_CHANNEL_TRIANGLE] = app.ui.triangleEnabled;
+    settings.channels[APU_CHANNEL_NOISE] = app.ui.noiseEnabled;
+    settings.channels[APU_CHANNEL_DMC] = app.ui.dmcEnabled;
+    settings.hpFilter1Enabled = app.ui.hpFilter1Enabled;
+    settings.hpFilter1Freq = app.ui.hpFilter1Freq;
+    settings.hpFilter2Enabled = app.ui.hpFilter2Enabled;
+    settings.hpFilter2Freq = app.ui.hpFilter2Freq;
+    settings.lpFilterEnabled = app.ui.lpFilterEnabled;
+    settings.lpFilterFreq = app.ui.lpFilterFreq;
+
+    return settings;
+}
+
 internal void DrawTopBar(SDL_Window* win, f32 dt)
 {
     igPushStyleVar_Vec2(ImGuiStyleVar_FramePadding, (ImVec2){10, 10});
@@ -113,6 +150,7 @@ internal void DrawTopBar(SDL_Window* win, f32 dt)
         igSeparator();
 
         bool hitF5 = igIsKeyPressed_Bool(ImGuiKey_F5, false);
+        bool hitF6 = igIsKeyPressed_Bool(ImGuiKey_F6, false);
         bool hitF8 = igIsKeyPressed_Bool(ImGuiKey_F8, false);
         bool hitF9 = igIsKeyPressed_Bool(ImGuiKey_F9, false);
         bool hitF10 = igIsKeyPressed_Bool(ImGuiKey_F10, false);
@@ -121,7 +159,7 @@ internal void DrawTopBar(SDL_Window* win, f32 dt)
 
         f32 windowWidth = igGetWindowWidth();
 
-        f32 centerWidth = 570.0f;
+        f32 centerWidth = 700.0f;
         f32 startX = (windowWidth - centerWidth) * 0.5f;
         if (startX > igGetCursorPosX()) {
             igSetCursorPosX(startX);
@@ -134,17 +172,16 @@ internal void DrawTopBar(SDL_Window* win, f32 dt)
                 if (!nes) {
                     SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_INFORMATION, "Run", "Load a ROM first.", win);
                 } else {
-                    hitRun = true;
+                    SendEmuCommandType(EMU_COMMAND_RUN);
                     debugging = false;
-                    stepping = false;
 
                     igSetWindowFocus_Str(ICON_FA_DESKTOP " NES Screen");
                 }
             }
         } else {
             if (igButton(ICON_FA_PAUSE " Pause (F5)", (ImVec2){0, 0}) || hitF5) {
+                SendEmuCommandType(EMU_COMMAND_PAUSE);
                 debugging = true;
-                stepping = false;
             }
         }
 
@@ -152,7 +189,7 @@ internal void DrawTopBar(SDL_Window* win, f32 dt)
 
         if (igButton(ICON_FA_UNDO " Reset (F9)", (ImVec2){0, 0}) || hitF9) {
             if (nes) {
-                ResetNES(nes);
+                SendEmuCommandType(EMU_COMMAND_RESET);
                 debugging = true;
             }
         }
@@ -161,15 +198,40 @@ internal void DrawTopBar(SDL_Window* win, f32 dt)
 
         if (igButton(ICON_FA_SAVE " Save (F10)", (ImVec2){0, 0}) || hitF10) {
             if (nes) {
-                debugging = true;
-                stepping = false;
-                if (saveFilePath[0]) Save(nes, saveFilePath);
-                else SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_INFORMATION, "Save", "Load a ROM first.", win);
+                if (saveFilePath[0]) {
+                    EmuCommand command = {0};
+                    command.type = EMU_COMMAND_SAVE;
+                    CopyString(command.path, sizeof(command.path), saveFilePath);
+                    SendEmuCommand(&command);
+                    debugging = true;
+                } else {
+                    SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_INFORMATION, "Save", "Load a ROM first.", win);
+                }
             }
         }
 
         igSameLine(0, 5);
 
+        bool fastForward = app.ui.fastForwardToggle;
+        if (hitF6) fastForward = !fastForward;
+        if (fastForward) {
+            igPushStyleColor_Vec4(ImGuiCol_Button, (ImVec4){0.2f, 0.6f, 0.2f, 1.0f});
+            igPushStyleColor_Vec4(ImGuiCol_ButtonHovered, (ImVec4){0.3f, 0.8f, 0.3f, 1.0f});
+            igPushStyleColor_Vec4(ImGuiCol_ButtonActive, (ImVec4){0.4f, 1.0f, 0.4f, 1.0f});
+        }
+        bool clickedFastForward = igButton(ICON_FA_FAST_FORWARD " Turbo (F6)", (ImVec2){0, 0});
+        if (fastForward) igPopStyleColor(3);
+        if (clickedFastForward) fastForward = !fastForward;
+        if (fastForward != app.ui.fastForwardToggle) {
+            EmuCommand command = {0};
+            command.type = EMU_COMMAND_SET_FAST_FORWARD;
+            command.enabled = fastForward;
+            SendEmuCommand(&command);
+        }
+        app.ui.fastForwardToggle = fastForward;
+
+        igSameLine(0, 5);
+
         bool dbgToggle = (bool)app.ui.debugToggle;
         if (hitF12) dbgToggle = !dbgToggle;
 
@@ -188,7 +250,7 @@ internal void DrawTopBar(SDL_Window* win, f32 dt)
             igSameLine(0, 5);
 
             if (igButton(ICON_FA_STEP_FORWARD " Step (F11)", (ImVec2){0, 0}) || hitF11) {
-                if (nes) stepping = true;
+                if (nes) SendEmuCommandType(EMU_COMMAND_STEP);
             }
         }
 
@@ -197,7 +259,13 @@ internal void DrawTopBar(SDL_Window* win, f32 dt)
         snprintf(fpsText, sizeof(fpsText), "FPS: %d", (s32)(1.0f / dt));
         snprintf(dtText, sizeof(dtText), "dt: %.4f", dt);
 
-        f32 rightWidth = 320.0f;
+        // how fast the game runs compared to the NES, only shown while there's something to compare
+        char speedText[64];
+        EmuFrame* frame = app.runtime.frame;
+        bool showSpeed = app.ui.fastForwardToggle && frame && frame->gameId && !frame->paused;
+        snprintf(speedText, sizeof(speedText), "Speed: %.1fx", showSpeed ? frame->speed : 0.0f);
+
+        f32 rightWidth = showSpeed ? 440.0f : 320.0f;
         f32 rightX = windowWidth - rightWidth;
         if (rightX > igGetCursorPosX()) {
             igSetCursorPosX(rightX);
@@ -215,8 +283,18 @@ internal void DrawTopBar(SDL_Window* win, f32 dt)
         bool clickedOneCyc = igButton(ICON_FA_CLOCK " 1-cycle (F8)", (ImVec2){0, 0});
         if (oneCyc) igPopStyleColor(3);
         if (clickedOneCyc) oneCyc = !oneCyc;
+        if (oneCyc != app.ui.oneCycleToggle) {
+            EmuCommand command = {0};
+            command.type = EMU_COMMAND_SET_ONE_CYCLE;
+            command.enabled = oneCyc;
+            SendEmuCommand(&command);
+        }
         app.ui.oneCycleToggle = oneCyc;
-        oneCycleAtTime = app.ui.oneCycleToggle;
+
+        if (showSpeed) {
+            igSameLine(0, 5);
+            igButton(speedText, (ImVec2){0, 0});
+        }
 
         igSameLine(0, 5);
         igButton(fpsText, (ImVec2){0, 0});
@@ -228,6 +306,149 @@ internal void DrawTopBar(SDL_Window* win, f32 dt)
     igPopStyleVar(1);
 }
 
+#define PROFILE_AVERAGE_FRAMES 60
+
+internal s32 GetProfileZoneDepth(ProfileZone zone)
+{
+    s32 depth = 0;
+    while ((zone = GetProfileZoneParent(zone)) != PROFILE_ZONE_COUNT) {
+        depth++;
+    }
+    return depth;
+}
+
+// Same indexing as GetProfileFrame, over the profiles the emulation thread sent with its frames.
+internal ProfileFrame* GetEmuProfileFrame(u32 index)
+{
+    if (index >= PROFILE_HISTORY_LENGTH || index >= app.runtime.emuProfileCount) {
+        return NULL;
+    }
+
+    return &app.runtime.emuProfiles[(app.runtime.emuProfileCount - 1 - index) % PROFILE_HISTORY_LENGTH];
+}
+
+// Frame time history and one bar per zone, nested zones indented below their parent. The bars show
+// the share of the frame, averaged over the last PROFILE_AVERAGE_FRAMES frames. Zones that never ran
+// on the thread are left out.
+internal void DrawProfileHistory(const char* id, ProfileFrame* (*getFrame)(u32 index))
+{
+    s32 available = 0;
+    while (available < PROFILE_HISTORY_LENGTH && getFrame(available)) {
+        available++;
+    }
+
+    if (available == 0) {
+        igTextDisabled("No frames yet");
+        return;
+    }
+
+    f32 frameTimes[PROFILE_HISTORY_LENGTH];
+    for (s32 i = 0; i < available; i++) {
+        frameTimes[i] = (f32)(getFrame(available - 1 - i)->seconds * 1000.0);
+    }
+
+    s32 averaged = MIN(available, PROFILE_AVERAGE_FRAMES);
+    f64 frameSeconds = 0;
+    f64 zoneSeconds[PROFILE_ZONE_COUNT] = {0};
+    u64 zoneCounts[PROFILE_ZONE_COUNT] = {0};
+    for (s32 i = 0; i < averaged; i++) {
+        ProfileFrame* frame = getFrame(i);
+        frameSeconds += frame->seconds;
+        for (s32 j = 0; j < PROFILE_ZONE_COUNT; j++) {
+            zoneSeconds[j] += frame->zoneSeconds[j];
+            zoneCounts[j] += frame->zoneCounts[j];
+        }
+    }
+
+    igText("Frame: %.2f ms", frameSeconds * 1000.0 / averaged);
+    igPlotLines_FloatPtr(id, frameTimes, available, 0, NULL, 0.0f, 33.3f, (ImVec2){-1, 40}, sizeof(f32));
+
+    for (s32 i = 0; i < PROFILE_ZONE_COUNT; i++) {
+        if (zoneCounts[i] == 0) {
+            continue;
+        }
+
+        f32 indent = 10.0f * GetProfileZoneDepth((ProfileZone)i);
+        f32 fraction = frameSeconds > 0 ? (f32)(zoneSeconds[i] / frameSeconds) : 0.0f;
+
+        char overlay[64];
+        snprintf(overlay, sizeof(overlay), "%s %.2f ms x%llu", GetProfileZoneName((ProfileZone)i),
+                 zoneSeconds[i] * 1000.0 / averaged, (unsigned long long)(zoneCounts[i] / averaged));
+
+        if (indent > 0) igIndent(indent);
+        igProgressBar(fraction, (ImVec2){-1, 0}, overlay);
+        if (indent > 0) igUnindent(indent);
+    }
+}
+
+// Standard deviation and largest deviation of the emulation frame times from their average, how
+// evenly the pacing spaces the frames whatever rate it follows.
+internal void DrawPacingJitter(void)
+{
+    s32 available = 0;
+    f64 total = 0;
+    while (available < PROFILE_HISTORY_LENGTH && GetEmuProfileFrame(available)) {
+        total += GetEmuProfileFrame(available)->seconds;
+        available++;
+    }
+
+    if (available < 2) {
+        return;
+    }
+
+    f64 average = total / available;
+    f64 variance = 0;
+    f64 largest = 0;
+    for (s32 i = 0; i < available; i++) {
+        f64 deviation = GetEmuProfileFrame(i)->seconds - average;
+        variance += deviation * deviation;
+        largest = MAX(largest, deviation < 0 ? -deviation : deviation);
+    }
+
+    igText("Jitter: %.3f ms (max %.3f ms)", sqrt(variance / available) * 1000.0, largest * 1000.0);
+}
+
+internal void DrawPacingOptions(void)
+{
+    s32 pacing = app.ui.pacing;
+
+    igText("Pacing:");
+    igSameLine(0, 5);
+    igRadioButton_IntPtr("Timer", &pacing, EMU_PACING_TIMER);
+    igSameLine(0, 5);
+    igRadioButton_IntPtr("Audio", &pacing, EMU_PACING_AUDIO);
+    if (app.runtime.vsync) {
+        igSameLine(0, 5);
+        igRadioButton_IntPtr("V-sync", &pacing, EMU_PACING_VSYNC);
+    }
+
+    if (pacing != app.ui.pacing) {
+        EmuCommand command = {0};
+        command.type = EMU_COMMAND_SET_PACING;
+        command.pacing = (EmuPacing)pacing;
+        SendEmuCommand(&command);
+        app.ui.pacing = pacing;
+    }
+}
+
+internal void DrawProfiler(void)
+{
+    DrawPacingOptions();
+
+    igTextColored((ImVec4){0.5f, 0.5f, 0.5f, 1.0f}, "Emulation thread");
+    DrawPacingJitter();
+    DrawProfileHistory("##emuFrameTimes", GetEmuProfileFrame);
+
+    if (!PROFILE_ENABLED) {
+        igTextDisabled("Build with NES_PROFILE to enable the zones and the UI thread");
+        return;
+    }
+
+    igSpacing();
+    igTextColored((ImVec4){0.5f, 0.5f, 0.5f, 1.0f}, "UI thread");
+    DrawProfileHistory("##uiFrameTimes", GetProfileFrame);
+}
+
 internal void DrawLeftSidebar(f32 dt)
 {
     igTextColored((ImVec4){0.2f, 1.0f, 0.4f, 1.0f}, "SYSTEM");
@@ -277,90 +498,135 @@ internal void DrawLeftSidebar(f32 dt)
     } else {
         igTextDisabled("No ROM loaded");
     }
+
+    if (igCollapsingHeader_TreeNodeFlags("Profiler", ImGuiTreeNodeFlags_None)) {
+        DrawProfiler();
+    }
+}
+
+// Decodes the 16 bytes of an 8x8 tile into pixels, a row every pitch pixels, with the RGBA of its 4 colors.
+internal void DecodePatternTile(u8* tile, u32* colors, u32* pixels, s32 pitch)
+{
+    for (s32 y = 0; y < 8; ++y) {
+        u8 plane0 = tile[y];
+        u8 plane1 = tile[y + 8];
+
+        for (s32 x = 0; x < 8; ++x) {
+            u8 bit0 = (plane0 >> (7 - x)) & 1;
+            u8 bit1 = (plane1 >> (7 - x)) & 1;
+            u8 colorIndex = (bit1 << 1) | bit0;
+
+            pixels[y * pitch + x] = colors[colorIndex];
+        }
+    }
+}
+
+// Uploads the rows of tiles from firstRow to lastRow, nothing when lastRow is before firstRow.
+internal void UploadTileRows(GLuint texture, u32* pixels, s32 width, s32 firstRow, s32 lastRow)
+{
+    if (lastRow < firstRow) return;
+
+    PROFILE_BEGIN(PROFILE_TEXTURE_UPLOAD);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, firstRow * 8, width, (lastRow - firstRow + 1) * 8, GL_RGBA, GL_UNSIGNED_BYTE,
+                    pixels + firstRow * 8 * width);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    PROFILE_END(PROFILE_TEXTURE_UPLOAD);
 }
 
+internal u32 patternColors[4] = {
+    0xFF000000, // Black
+    0xFF555555, // Dark gray
+    0xFFAAAAAA, // Light gray
+    0xFFFFFFFF  // White
+};
+
+// Nothing is done until the pattern tables change, then only the tiles whose bytes changed are decoded again.
 internal void UpdatePatternTableTextures(Device* device, NES* nesPtr)
 {
-    if (!nesPtr) return;
+    if (!nesPtr || !nesPtr->debug) return;
 
-    u32 pixels[2][128 * 128]; // 2 tables, 128x128 pixels, 4 bytes/pixel (RGBA)
+    NESDebug* debug = nesPtr->debug;
+    if (debug->patternsValid && debug->patternsGeneration == nesPtr->ppu.chrGeneration) return;
 
-    u32 palette[4] = {
-        0xFF000000, // Black
-        0xFF555555, // Dark gray
-        0xFFAAAAAA, // Light gray
-        0xFFFFFFFF  // White
-    };
+    u32 (*pixels)[128 * 128] = debug->patterns; // 2 tables, 128x128 pixels, 4 bytes/pixel (RGBA)
 
     for (s32 t = 0; t < 2; ++t) {
-        u16 baseAddr = t * 0x1000;
-        for (s32 tileY = 0; tileY < 16; ++tileY) {
-            for (s32 tileX = 0; tileX < 16; ++tileX) {
-                s32 tileIndex = tileY * 16 + tileX;
-                u16 tileAddr = baseAddr + tileIndex * 16;
-
-                for (s32 y = 0; y < 8; ++y) {
-                    u8 plane0 = ReadPPUU8(nesPtr, tileAddr + y);
-                    u8 plane1 = ReadPPUU8(nesPtr, tileAddr + y + 8);
-
-                    for (s32 x = 0; x < 8; ++x) {
-                        u8 bit0 = (plane0 >> (7 - x)) & 1;
-                        u8 bit1 = (plane1 >> (7 - x)) & 1;
-                        u8 colorIndex = (bit1 << 1) | bit0;
-
-                        s32 px = tileX * 8 + x;
-                        s32 py = tileY * 8 + y;
-                        pixels[t][py * 128 + px] = palette[colorIndex];
-                    }
-                }
+        s32 firstRow = 16;
+        s32 lastRow = -1;
+
+        for (s32 tileIndex = 0; tileIndex < 256; ++tileIndex) {
+            u16 tileAddr = t * 0x1000 + tileIndex * 16;
+
+            u8 tile[16];
+            for (s32 i = 0; i < 16; ++i) {
+                tile[i] = ReadPPUU8(nesPtr, tileAddr + i);
             }
+
+            u8* drawn = debug->patternTiles[t][tileIndex];
+            if (debug->patternsValid && memcmp(tile, drawn, sizeof(tile)) == 0) continue;
+            memcpy(drawn, tile, sizeof(tile));
+
+            s32 tileX = tileIndex % 16;
+            s32 tileY = tileIndex / 16;
+            DecodePatternTile(tile, patternColors, pixels[t] + tileY * 8 * 128 + tileX * 8, 128);
+
+            firstRow = MIN(firstRow, tileY);
+            lastRow = MAX(lastRow, tileY);
         }
 
-        glBindTexture(GL_TEXTURE_2D, device->patterns[t]);
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 128, 128, GL_RGBA, GL_UNSIGNED_BYTE, pixels[t]);
+        UploadTileRows(device->patterns[t], pixels[t], 128, firstRow, lastRow);
     }
-    glBindTexture(GL_TEXTURE_2D, 0);
+
+    debug->patternsValid = true;
+    debug->patternsGeneration = nesPtr->ppu.chrGeneration;
 }
 
 internal void UpdatePatternHoverTexture(Device* device, NES* nesPtr, s32 tableIndex, s32 tileIndex)
 {
-    if (!nesPtr) return;
+    if (!nesPtr || !nesPtr->debug) return;
 
-    u32 pixels[8 * 8]; // 8x8 pixels, 4 bytes/pixel (RGBA)
-
-    u32 palette[4] = {
-        0xFF000000, // Black
-        0xFF555555, // Dark gray
-        0xFFAAAAAA, // Light gray
-        0xFFFFFFFF  // White
-    };
+    u32* pixels = nesPtr->debug->patternHover; // 8x8 pixels, 4 bytes/pixel (RGBA)
 
     u16 baseAddr = tableIndex * 0x1000;
     u16 tileAddr = baseAddr + tileIndex * 16;
 
-    for (s32 y = 0; y < 8; ++y) {
-        u8 plane0 = ReadPPUU8(nesPtr, tileAddr + y);
-        u8 plane1 = ReadPPUU8(nesPtr, tileAddr + y + 8);
-
-        for (s32 x = 0; x < 8; ++x) {
-            u8 bit0 = (plane0 >> (7 - x)) & 1;
-            u8 bit1 = (plane1 >> (7 - x)) & 1;
-            u8 colorIndex = (bit1 << 1) | bit0;
-
-            pixels[y * 8 + x] = palette[colorIndex];
-        }
+    u8 tile[16];
+    for (s32 i = 0; i < 16; ++i) {
+        tile[i] = ReadPPUU8(nesPtr, tileAddr + i);
     }
+    DecodePatternTile(tile, patternColors, pixels, 8);
 
     glBindTexture(GL_TEXTURE_2D, device->patternHover);
     glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 8, 8, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+// Nothing is done until the nametable, the pattern tables or the palettes change. When only the nametable
+// changed, the tiles whose pattern index and palette are the same are skipped without reading their patterns,
+// the others are drawn again when their pattern bytes or colors changed.
 internal void DrawNametable(Device* device, NES* nesPtr, u16 address)
 {
-    if (!nesPtr) return;
+    if (!nesPtr || !nesPtr->debug) return;
 
-    u32 pixels[256 * 240];
+    NESDebug* debug = nesPtr->debug;
+    PPU* ppu = &nesPtr->ppu;
+    u16 baseAddress = 0x1000 * GetBitFlag(ppu->control, BACKGROUND_ADDR_FLAG);
+
+    bool sameTiles = debug->nametableValid && debug->nametableAddress == address &&
+                     debug->nametableBackground == baseAddress &&
+                     debug->nametableGenerations[0] == ppu->chrGeneration &&
+                     debug->nametableGenerations[2] == ppu->paletteGeneration;
+    if (sameTiles && debug->nametableGenerations[1] == ppu->nametableGeneration) return;
+
+    u8 palette[16];
+    for (s32 i = 0; i < 16; ++i) {
+        palette[i] = ReadPPUU8(nesPtr, 0x3F00 + i);
+    }
+
+    u32* pixels = debug->nametable;
+    s32 firstRow = 30;
+    s32 lastRow = -1;
 
     for (s32 tileY = 0; tileY < 30; ++tileY) {
         for (s32 tileX = 0; tileX < 32; ++tileX) {
@@ -380,35 +646,44 @@ internal void DrawNametable(Device* device, NES* nesPtr, u16 address)
             u8 shiftValue = (lookupValue / 4) * 2;
             u8 highColorBits = (attributeByte >> shiftValue) & 0x03;
 
-            u16 baseAddress = 0x1000 * GetBitFlag(nesPtr->ppu.control, BACKGROUND_ADDR_FLAG);
-            u16 patternAddress = baseAddress + patternIndex * 16;
-
-            for (s32 y = 0; y < 8; ++y) {
-                u8 plane0 = ReadPPUU8(nesPtr, patternAddress + y);
-                u8 plane1 = ReadPPUU8(nesPtr, patternAddress + y + 8);
+            u16 key = (highColorBits << 8) | patternIndex;
+            if (sameTiles && debug->nametableKeys[tileIndex] == key) continue;
+            debug->nametableKeys[tileIndex] = key;
 
-                for (s32 x = 0; x < 8; ++x) {
-                    u8 bit0 = (plane0 >> (7 - x)) & 1;
-                    u8 bit1 = (plane1 >> (7 - x)) & 1;
-                    u8 colorIndex = (bit1 << 1) | bit0;
-
-                    u8 paletteIndex = ReadPPUU8(nesPtr, 0x3F00 + highColorBits * 4 + colorIndex);
-                    if (colorIndex == 0) paletteIndex = ReadPPUU8(nesPtr, 0x3F00);
+            u8 tile[16 + 4];
+            u16 patternAddress = baseAddress + patternIndex * 16;
+            for (s32 i = 0; i < 16; ++i) {
+                tile[i] = ReadPPUU8(nesPtr, patternAddress + i);
+            }
+            tile[16] = palette[0];
+            for (s32 i = 1; i < 4; ++i) {
+                tile[16 + i] = palette[highColorBits * 4 + i];
+            }
 
-                    Color c = systemPalette[paletteIndex % 64];
-                    u32 color = (0xFF << 24) | (c.b << 16) | (c.g << 8) | c.r;
+            u8* drawn = debug->nametableTiles[tileIndex];
+            if (debug->nametableValid && memcmp(tile, drawn, sizeof(tile)) == 0) continue;
+            memcpy(drawn, tile, sizeof(tile));
 
-                    s32 px = tileX * 8 + x;
-                    s32 py = tileY * 8 + y;
-                    pixels[py * 256 + px] = color;
-                }
+            u32 colors[4];
+            for (s32 i = 0; i < 4; ++i) {
+                Color c = systemPalette[tile[16 + i] % 64];
+                colors[i] = (0xFF << 24) | (c.b << 16) | (c.g << 8) | c.r;
             }
+            DecodePatternTile(tile, colors, pixels + tileY * 8 * 256 + tileX * 8, 256);
+
+            firstRow = MIN(firstRow, tileY);
+            lastRow = MAX(lastRow, tileY);
         }
     }
 
-    glBindTexture(GL_TEXTURE_2D, device->nametable);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 256, 240, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    UploadTileRows(device->nametable, pixels, 256, firstRow, lastRow);
+
+    debug->nametableValid = true;
+    debug->nametableAddress = address;
+    debug->nametableBackground = baseAddress;
+    debug->nametableGenerations[0] = ppu->chrGeneration;
+    debug->nametableGenerations[1] = ppu->nametableGeneration;
+    debug->nametableGenerations[2] = ppu->paletteGeneration;
 }
 
 internal void DrawAudioWaveform(s16* buffer, s32 pointCount)
@@ -558,7 +833,7 @@ internal void DrawAudioPanel()
         igText("SAMPLE COUNTER: %02X", apu->sampleCounter);
         igText("DMC IRQ: %02X", apu->dmcIRQ);
         igText("FRAME COUNTER: %02X", apu->frameCounter);
-        igText("BUFFER INDEX: %04X", apu->bufferIndex);
+        igText("BUFFER INDEX: %04X", nes->apuOutput->bufferIndex);
 
         igSpacing();
         igSeparator();
@@ -617,7 +892,7 @@ internal void DrawAudioPanel()
         igSeparator();
         igSpacing();
 
-        DrawAudioWaveform(apu->buffer, apu->bufferIndex);
+        DrawAudioWaveform(nes->apuOutput->buffer, nes->apuOutput->bufferIndex);
 
         app.ui.square1Enabled = sq1;
         app.ui.square2Enabled = sq2;
@@ -625,23 +900,155 @@ internal void DrawAudioPanel()
         app.ui.noiseEnabled = noi;
         app.ui.dmcEnabled = dmc;
 
-        apu->hpFilter1.enabled = hp1;
-        apu->hpFilter1.freq = app.ui.hpFilter1Freq;
-        apu->hpFilter2.enabled = hp2;
-        apu->hpFilter2.freq = app.ui.hpFilter2Freq;
-        apu->lpFilter.enabled = lp;
-        apu->lpFilter.freq = app.ui.lpFilterFreq;
-
-        apu->pulse1.globalEnabled = sq1;
-        apu->pulse2.globalEnabled = sq2;
-        apu->triangle.globalEnabled = tri;
-        apu->noise.globalEnabled = noi;
-        apu->dmc.globalEnabled = dmc;
+        EmuAudioSettings settings = GetAudioSettings();
+        if (memcmp(&settings, &app.ui.audioSettings, sizeof(EmuAudioSettings)) != 0) {
+            EmuCommand command = {0};
+            command.type = EMU_COMMAND_SET_AUDIO;
+            command.audio = settings;
+            SendEmuCommand(&command);
+            memcpy(&app.ui.audioSettings, &settings, sizeof(EmuAudioSettings));
+        }
     } else {
         igTextDisabled("No ROM loaded");
     }
 }
 
+// The part of the address space listed around address: the PRG window, the cartridge SRAM or the internal RAM.
+internal void GetDisassemblyRegion(u16 address, u16* start, u32* regionSize)
+{
+    if (ISBETWEEN(address, 0x0000, 0x2000)) {
+        *start = 0x0000;
+        *regionSize = CPU_RAM_SIZE;
+    } else if (ISBETWEEN(address, 0x6000, 0x8000)) {
+        *start = 0x6000;
+        *regionSize = CPU_SRAM_SIZE;
+    } else {
+        *start = 0x8000;
+        *regionSize = 0x8000;
+    }
+}
+
+// Index of the last line starting at or before offset.
+internal s32 FindDisassemblyLine(NESDebug* debug, u32 offset)
+{
+    s32 lo = 0;
+    s32 hi = debug->disassemblyLineCount - 1;
+    while (lo < hi) {
+        s32 mid = (lo + hi + 1) / 2;
+        if (debug->disassemblyLines[mid] <= offset) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return lo;
+}
+
+// The listing is made once per region and PRG banks. It's made again when the banks are switched, when the
+// RAM it lists changes or when target isn't the start of a line (code jumped in the middle of what was listed
+// as an instruction). Bytes are read with PeekCPUU8, so listing has no side effects. Returns true when it was
+// made again.
+internal bool UpdateDisassembly(NES* nesPtr, u16 target)
+{
+    NESDebug* debug = nesPtr->debug;
+
+    u16 start;
+    u32 regionSize;
+    GetDisassemblyRegion(target, &start, &regionSize);
+    u32 targetOffset = (u32)(target - start) % regionSize;
+
+    bool valid = debug->disassemblyValid && debug->disassemblyStart == start;
+    if (start == 0x8000) {
+        valid = valid && memcmp(debug->disassemblyBanks, nesPtr->prgBankOffsets, sizeof(debug->disassemblyBanks)) == 0;
+        if (!valid) {
+            for (u32 i = 0; i < regionSize; ++i) {
+                debug->disassemblyBytes[i] = PeekCPUU8(nesPtr, (u16)(start + i));
+            }
+        }
+    } else {
+        // the game can rewrite RAM any time, the listing is kept while the bytes are the same
+        for (u32 i = 0; i < regionSize; ++i) {
+            u8 value = PeekCPUU8(nesPtr, (u16)(start + i));
+            if (value != debug->disassemblyBytes[i]) {
+                debug->disassemblyBytes[i] = value;
+                valid = false;
+            }
+        }
+    }
+
+    if (valid && debug->disassemblyLines[FindDisassemblyLine(debug, targetOffset)] == targetOffset) {
+        return false;
+    }
+
+    // a line always starts at target, what came before it and overlaps it is listed a byte at a time
+    s32 count = 0;
+    u32 offset = 0;
+    while (offset < regionSize) {
+        u32 length = MAX(cpuInstructions[debug->disassemblyBytes[offset]].bytesCount, 1);
+        if (offset < targetOffset && offset + length > targetOffset) length = 1;
+
+        debug->disassemblyLines[count++] = (u16)offset;
+        offset += length;
+    }
+
+    debug->disassemblyValid = true;
+    debug->disassemblyStart = start;
+    debug->disassemblySize = regionSize;
+    memcpy(debug->disassemblyBanks, nesPtr->prgBankOffsets, sizeof(debug->disassemblyBanks));
+    debug->disassemblyLineCount = count;
+    return true;
+}
+
+internal void DrawDisassemblyLine(NES* nesPtr, s32 line)
+{
+    NESDebug* debug = nesPtr->debug;
+
+    u32 offset = debug->disassemblyLines[line];
+    u32 next = line + 1 < debug->disassemblyLineCount ? debug->disassemblyLines[line + 1] : debug->disassemblySize;
+    u16 address = debug->disassemblyStart + offset;
+
+    u8 bytes[3] = {0};
+    for (u32 i = 0; i < 3 && offset + i < debug->disassemblySize; ++i) {
+        bytes[i] = debug->disassemblyBytes[offset + i];
+    }
+
+    CPUInstruction* instruction = &cpuInstructions[bytes[0]];
+    bool currentInstr = (address == nesPtr->cpu.pc);
+    bool breakpointHit = (address == app.ui.breakpoint);
+
+    const char* marker = currentInstr ? (breakpointHit ? "O>" : "> ") : (breakpointHit ? "O " : "  ");
+
+    char text[64];
+    s32 col = snprintf(text, sizeof(text), "%s%04X", marker, address);
+    for (u32 i = 0; i < next - offset; ++i) {
+        col += snprintf(text + col, sizeof(text) - col, " %02X", bytes[i]);
+    }
+
+    memset(text + col, ' ', 18 - col);
+    col = 18;
+    if (next - offset == MAX(instruction->bytesCount, 1)) {
+        col += DisassembleInstruction(bytes, address, text + col, sizeof(text) - col);
+        if (instruction->mnemonic == CPU_RTS) {
+            snprintf(text + col, sizeof(text) - col, " -------------");
+        }
+    } else {
+        // cut short by the start of the line after it
+        snprintf(text + col, sizeof(text) - col, ".db $%02X", bytes[0]);
+    }
+
+    if (currentInstr) {
+        igPushStyleColor_Vec4(ImGuiCol_Text, (ImVec4){0.2f, 1.0f, 0.4f, 1.0f});
+    } else if (breakpointHit) {
+        igPushStyleColor_Vec4(ImGuiCol_Text, (ImVec4){1.0f, 0.2f, 0.2f, 1.0f});
+    }
+
+    igTextUnformatted(text, NULL);
+
+    if (currentInstr || breakpointHit) {
+        igPopStyleColor(1);
+    }
+}
+
 internal void DrawInstructionsPanel()
 {
     igInputText("Address", app.ui.instructionAddressText, sizeof(app.ui.instructionAddressText),
@@ -649,7 +1056,7 @@ internal void DrawInstructionsPanel()
     igInputText("Breakpoint", app.ui.instructionBreakpointText, sizeof(app.ui.instructionBreakpointText),
                 ImGuiInputTextFlags_CharsHexadecimal, NULL, NULL);
 
-    if (nes) {
+    if (nes && nes->debug) {
         CPU* cpu = &nes->cpu;
         u16 pc = cpu->pc;
         if (app.ui.instructionAddressText[0] != '\0') {
@@ -660,111 +1067,44 @@ internal void DrawInstructionsPanel()
         }
 
         if (app.ui.instructionBreakpointText[0] != '\0') {
-            breakpoint = (u16)strtol(app.ui.instructionBreakpointText, NULL, 16);
+            u16 address = (u16)strtol(app.ui.instructionBreakpointText, NULL, 16);
+            if (address != app.ui.breakpoint) {
+                EmuCommand command = {0};
+                command.type = EMU_COMMAND_SET_BREAKPOINT;
+                command.address = address;
+                SendEmuCommand(&command);
+                app.ui.breakpoint = address;
+            }
         }
 
+        bool rebuilt = UpdateDisassembly(nes, pc);
+
         bool child_visible = igBeginChild_Str("DisassemblyList", (ImVec2){0, 0}, false, ImGuiWindowFlags_None);
         if (child_visible) {
-            for (s32 i = 0; i < 100; ++i) {
-                memset(debugBuffer, 0, sizeof(debugBuffer));
-
-                u8 opcode = ReadCPUU8(nes, pc);
-                CPUInstruction* instruction = &cpuInstructions[opcode];
-                s32 col = 0;
-                bool currentInstr = (pc == cpu->pc);
-                bool breakpointHit = (pc == breakpoint);
-
-                if (currentInstr) {
-                    igPushStyleColor_Vec4(ImGuiCol_Text, (ImVec4){0.2f, 1.0f, 0.4f, 1.0f});
-                } else if (breakpointHit) {
-                    igPushStyleColor_Vec4(ImGuiCol_Text, (ImVec4){1.0f, 0.2f, 0.2f, 1.0f});
+            NESDebug* debug = nes->debug;
+            f32 lineHeight = igGetTextLineHeightWithSpacing();
+            s32 pcLine = FindDisassemblyLine(debug, (u32)(pc - debug->disassemblyStart) % debug->disassemblySize);
+
+            // the listing follows the pc (or the address typed) when it moves out of sight, it scrolls freely
+            // otherwise
+            if (rebuilt || pc != app.ui.disassemblyTarget) {
+                f32 y = pcLine * lineHeight;
+                f32 scrollY = igGetScrollY();
+                f32 height = igGetWindowHeight();
+                if (rebuilt || y < scrollY || y + lineHeight > scrollY + height) {
+                    igSetScrollY_Float(y - height / 3);
                 }
+                app.ui.disassemblyTarget = pc;
+            }
 
-                col += currentInstr ? (breakpointHit ? sprintf(debugBuffer, "O>%04X %02X", pc, instruction->opcode)
-                                                     : sprintf(debugBuffer, "> %04X %02X", pc, instruction->opcode))
-                                    : (breakpointHit ? sprintf(debugBuffer, "O %04X %02X", pc, instruction->opcode)
-                                                     : sprintf(debugBuffer, "  %04X %02X", pc, instruction->opcode));
-
-                switch (instruction->bytesCount) {
-                    case 2:
-                        col += sprintf(debugBuffer + col, " %02X", ReadCPUU8(nes, pc + 1));
-                        break;
-                    case 3:
-                        col += sprintf(debugBuffer + col, " %02X %02X", ReadCPUU8(nes, pc + 1), ReadCPUU8(nes, pc + 2));
-                        break;
-                    default:
-                        break;
-                }
-
-                memset(debugBuffer + col, ' ', 18 - col);
-                col = 18;
-                col += sprintf(debugBuffer + col, "%s", GetInstructionStr(instruction->mnemonic));
-
-                switch (instruction->addressingMode) {
-                    case AM_IMM:
-                        col += sprintf(debugBuffer + col, " #$%02X", ReadCPUU8(nes, pc + 1));
-                        break;
-                    case AM_ABS: {
-                        u8 lo = ReadCPUU8(nes, pc + 1);
-                        u8 hi = ReadCPUU8(nes, pc + 2);
-                        col += sprintf(debugBuffer + col, " $%04X", (hi << 8) | lo);
-                        break;
-                    }
-                    case AM_ABX: {
-                        u8 lo = ReadCPUU8(nes, pc + 1);
-                        u8 hi = ReadCPUU8(nes, pc + 2);
-                        col += sprintf(debugBuffer + col, " $%04X, X", (hi << 8) | lo);
-                        break;
-                    }
-                    case AM_ABY: {
-                        u8 lo = ReadCPUU8(nes, pc + 1);
-                        u8 hi = ReadCPUU8(nes, pc + 2);
-                        col += sprintf(debugBuffer + col, " $%04X, Y", (hi << 8) | lo);
-                        break;
-                    }
-                    case AM_ZPA:
-                        col += sprintf(debugBuffer + col, " $%02X", ReadCPUU8(nes, pc + 1));
-                        break;
-                    case AM_ZPX:
-                        col += sprintf(debugBuffer + col, " $%02X, X", ReadCPUU8(nes, pc + 1));
-                        break;
-                    case AM_ZPY:
-                        col += sprintf(debugBuffer + col, " $%02X, Y", ReadCPUU8(nes, pc + 1));
-                        break;
-                    case AM_IND: {
-                        u8 lo = ReadCPUU8(nes, pc + 1);
-                        u8 hi = ReadCPUU8(nes, pc + 2);
-                        col += sprintf(debugBuffer + col, " ($%04X)", (hi << 8) | lo);
-                        break;
-                    }
-                    case AM_IZX:
-                        col += sprintf(debugBuffer + col, " ($%02X, X)", ReadCPUU8(nes, pc + 1));
-                        break;
-                    case AM_IZY:
-                        col += sprintf(debugBuffer + col, " ($%02X), Y", ReadCPUU8(nes, pc + 1));
-                        break;
-                    case AM_REL: {
-                        s8 address = (s8)ReadCPUU8(nes, pc + 1);
-                        u16 jumpAddress = pc + instruction->bytesCount + address;
-                        col += sprintf(debugBuffer + col, " $%04X", jumpAddress);
-                        break;
-                    }
-                    default:
-                        break;
-                }
-
-                if (instruction->mnemonic == CPU_RTS) {
-                    col += sprintf(debugBuffer + col, " -------------");
-                }
-
-                igText("%s", debugBuffer);
-
-                if (currentInstr || breakpointHit) {
-                    igPopStyleColor(1);
+            ImGuiListClipper* clipper = ImGuiListClipper_ImGuiListClipper();
+            ImGuiListClipper_Begin(clipper, debug->disassemblyLineCount, lineHeight);
+            while (ImGuiListClipper_Step(clipper)) {
+                for (s32 line = clipper->DisplayStart; line < clipper->DisplayEnd; ++line) {
+                    DrawDisassemblyLine(nes, line);
                 }
-
-                pc += instruction->bytesCount;
             }
+            ImGuiListClipper_destroy(clipper);
         }
         igEndChild();
     } else {
@@ -863,12 +1203,13 @@ internal void DrawMemoryPanel()
 
 internal void DrawGameScreen(Device* device)
 {
-    if (nes) {
-        GUI* gui = &nes->gui;
-
+    EmuFrame* frame = app.runtime.frame;
+    if (nes && frame && frame->gameId) {
+        PROFILE_BEGIN(PROFILE_TEXTURE_UPLOAD);
         glBindTexture(GL_TEXTURE_2D, device->screen);
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 256, 240, GL_RGBA, GL_UNSIGNED_BYTE, gui->pixels);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 256, 240, GL_RGBA, GL_UNSIGNED_BYTE, frame->pixels);
         glBindTexture(GL_TEXTURE_2D, 0);
+        PROFILE_END(PROFILE_TEXTURE_UPLOAD);
 
         ImVec2 avail = igGetContentRegionAvail();
         f32 aspect = 256.0f / 240.0f;
@@ -996,6 +1337,8 @@ internal void DrawControllerPanel()
 
 void DrawUI(SDL_Window* win, Device* device, f32 dt)
 {
+    PROFILE_BEGIN(PROFILE_UI);
+
     DrawTopBar(win, dt);
 
     ImGuiViewport* viewport = igGetMainViewport();
@@ -1045,4 +1388,6 @@ void DrawUI(SDL_Window* win, Device* device, f32 dt)
     igEnd();
 
     igRender();
+
+    PROFILE_END(PROFILE_UI);
 }
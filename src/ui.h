@@ -2,6 +2,8 @@
 #define UI_H
 
 #include "types.h"
+#include "profile.h"
+#include "emu_thread.h"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_opengl.h>
 
@@ -12,23 +14,30 @@
 /* App State */
 typedef struct RuntimeState {
     s64 perfCountFrequency;
+    EmuThread* emu;
+
+    // the debugger's clone of the game the emulation thread runs, restored from every frame of it
     struct NES* nes;
+    u32 gameId; // generation of the game the clone belongs to
+
+    // newest frame the emulation thread published, NULL until the first one
+    EmuFrame* frame;
+    bool debugging;
+    bool vsync;
+
+    // profiles of the emulation thread that came with the frames
+    ProfileFrame emuProfiles[PROFILE_HISTORY_LENGTH];
+    u64 emuProfileCount;
+
     char loadedFilePath[1024];
     char saveFilePath[1024];
+    char recordMoviePath[1024];
 } RuntimeState;
 
-typedef struct EmuControlState {
-    bool hitRun;
-    bool debugging;
-    bool stepping;
-    u16 breakpoint;
-} EmuControlState;
-
 typedef struct UiState {
     char debugBuffer[256];
 
     bool coarseButtons[8];
-    bool oneCycleAtTime;
     bool debugMode;
 
     bool leftSidebarCollapsed;
@@ -38,9 +47,12 @@ typedef struct UiState {
 
     bool oneCycleToggle;
     bool debugToggle;
+    bool fastForwardToggle;
 
     char instructionAddressText[12];
     char instructionBreakpointText[5];
+    u16 breakpoint;
+    u16 disassemblyTarget; // address the disassembly was last scrolled to
 
     s32 debugToolTab;
     s32 memoryOption;
@@ -63,11 +75,14 @@ typedef struct UiState {
     s32 hpFilter2Freq;
     bool lpFilterEnabled;
     s32 lpFilterFreq;
+
+    // last settings sent to the emulation thread
+    EmuAudioSettings audioSettings;
+    s32 pacing;
 } UiState;
 
 typedef struct AppState {
     RuntimeState runtime;
-    EmuControlState control;
     UiState ui;
 } AppState;
 
@@ -75,15 +90,12 @@ extern AppState app;
 
 #define globalPerfCountFrequency (app.runtime.perfCountFrequency)
 #define debugBuffer (app.ui.debugBuffer)
-#define hitRun (app.control.hitRun)
-#define debugging (app.control.debugging)
-#define stepping (app.control.stepping)
-#define breakpoint (app.control.breakpoint)
+#define debugging (app.runtime.debugging)
 #define coarseButtons (app.ui.coarseButtons)
-#define oneCycleAtTime (app.ui.oneCycleAtTime)
 #define debugMode (app.ui.debugMode)
 #define loadedFilePath (app.runtime.loadedFilePath)
 #define saveFilePath (app.runtime.saveFilePath)
+#define recordMoviePath (app.runtime.recordMoviePath)
 
 /* Textures */
 #define NUM_TEXTURES 1 + 2 + 1 + 64 + 8 + 1 + 960
@@ -96,6 +108,8 @@ typedef struct Device {
 } Device;
 
 void SetupImGui(void);
+// Channels and filters as the audio panel has them.
+EmuAudioSettings GetAudioSettings(void);
 void DrawUI(SDL_Window* win, Device* device, f32 dt);
 
 #endif
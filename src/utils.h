@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <stdbool.h>
+#include <string.h>
 
 #define ASSERT(expression) assert(expression)
 
@@ -38,6 +39,15 @@
 #define global static
 #define local static
 
+#define CACHE_LINE_SIZE 64
+#define ALIGN_UP(x, a) (((x) + ((a) - 1)) & ~((size)(a) - 1))
+
+#ifdef _MSC_VER
+#define ALIGNED(n) __declspec(align(n))
+#else
+#define ALIGNED(n) __attribute__((aligned(n)))
+#endif
+
 typedef int8_t s8;
 typedef int16_t s16;
 typedef int32_t s32;
@@ -71,4 +81,68 @@ static inline void Free(void* address)
     free(address);
 }
 
+// Over-allocates and stores the original pointer right before the aligned block.
+static inline void* AllocateAligned(size length, size alignment)
+{
+    u8* block = (u8*)malloc(length + alignment + sizeof(void*));
+    if (!block) {
+        return NULL;
+    }
+
+    uintptr_t address = ((uintptr_t)(block + sizeof(void*)) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    ((void**)address)[-1] = block;
+    return (void*)address;
+}
+
+static inline void FreeAligned(void* address)
+{
+    if (address) {
+        free(((void**)address)[-1]);
+    }
+}
+
+// Linear allocator over a single cache-line aligned block. CreateArena zeroes the block, PushSize
+// doesn't clear anything, so a reused block keeps its old contents. It is all released at once with DestroyArena.
+typedef struct Arena {
+    u8* base;
+    size capacity;
+    size used;
+} Arena;
+
+static inline bool CreateArena(Arena* arena, size capacity)
+{
+    arena->base = (u8*)AllocateAligned(capacity, CACHE_LINE_SIZE);
+    arena->capacity = arena->base ? capacity : 0;
+    arena->used = 0;
+
+    if (arena->base) {
+        memset(arena->base, 0, capacity);
+    }
+
+    return arena->base != NULL;
+}
+
+static inline void* PushSize(Arena* arena, size length, size alignment)
+{
+    size offset = ALIGN_UP(arena->used, alignment);
+    ASSERT(offset + length <= arena->capacity);
+
+    arena->used = offset + length;
+    return arena->base + offset;
+}
+
+#define PushStruct(arena, type) ((type*)PushSize((arena), sizeof(type), CACHE_LINE_SIZE))
+#define PushArray(arena, type, count) ((type*)PushSize((arena), sizeof(type) * (count), CACHE_LINE_SIZE))
+
+// Arena capacity needed for a block pushed with cache-line alignment.
+#define ArenaSizeOf(length) ALIGN_UP((length), CACHE_LINE_SIZE)
+
+static inline void DestroyArena(Arena* arena)
+{
+    FreeAligned(arena->base);
+    arena->base = NULL;
+    arena->capacity = 0;
+    arena->used = 0;
+}
+
 #endif // UTILS_H